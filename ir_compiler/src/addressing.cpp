@@ -0,0 +1,305 @@
+#include "addressing.h"
+
+namespace IR::addressing {
+	using namespace std_alias;
+	using namespace IR::program;
+
+	// an array access whose whole address is kept in a variable
+	struct HoistedAddress {
+		Variable *array;
+		Vec<Expr *> indices; // all but the last are loop-invariant
+		Variable *address;
+		Vec<Pair<Instruction *, int64_t>> increments; // the instructions that add a constant to the last index, and the constants
+	};
+
+	struct LoopPlan {
+		BasicBlock *header;
+		Vec<BasicBlock *> outside_preds;
+		Vec<Variable *> arrays; // the arrays whose strides or addresses the preheader computes, in order of first access
+		Map<Variable *, Vec<Variable *>> strides;
+		Vec<HoistedAddress> addresses;
+		Map<std::string, int> address_index_map; // the text of an access -> its index in addresses
+	};
+
+	Uptr<Instruction> make_assignment(Variable *dest, Uptr<Expr> &&lhs, Operator op, Uptr<Expr> &&rhs) {
+		return mkuptr<InstructionAssignment>(make_bound_ref(dest), mkuptr<BinaryOperation>(mv(lhs), mv(rhs), op));
+	}
+
+	// copies an operand that is a number or a variable
+	Uptr<Expr> copy_operand(Expr &expr) {
+		if (NumberLiteral *num = dynamic_cast<NumberLiteral *>(&expr)) {
+			return mkuptr<NumberLiteral>(num->get_value());
+		}
+		return make_bound_ref(dynamic_cast<ItemRef<Variable> &>(expr).get_referent().value());
+	}
+
+	Opt<MemoryLocation *> get_memory_location(Instruction &inst) {
+		if (InstructionLoad *load = dynamic_cast<InstructionLoad *>(&inst)) {
+			return &load->get_memory_location();
+		}
+		if (InstructionStore *store = dynamic_cast<InstructionStore *>(&inst)) {
+			return &store->get_memory_location();
+		}
+		return {};
+	}
+
+	Opt<Variable *> get_variable(Expr &expr) {
+		ItemRef<Variable> *ref = dynamic_cast<ItemRef<Variable> *>(&expr);
+		if (!ref) {
+			return {};
+		}
+		return ref->get_referent();
+	}
+
+	// if the instruction is var <- var + c, var <- c + var, or var <- var - c,
+	// returns c
+	Opt<int64_t> get_constant_increment(Instruction &inst, Variable *var) {
+		InstructionAssignment *assignment = dynamic_cast<InstructionAssignment *>(&inst);
+		if (!assignment) return {};
+		BinaryOperation *operation = dynamic_cast<BinaryOperation *>(&assignment->get_source());
+		if (!operation) return {};
+		NumberLiteral *lhs_num = dynamic_cast<NumberLiteral *>(&operation->get_lhs());
+		NumberLiteral *rhs_num = dynamic_cast<NumberLiteral *>(&operation->get_rhs());
+		if (operation->get_op() == Operator::plus) {
+			if (rhs_num && get_variable(operation->get_lhs()) == var) return rhs_num->get_value();
+			if (lhs_num && get_variable(operation->get_rhs()) == var) return lhs_num->get_value();
+		} else if (operation->get_op() == Operator::minus) {
+			if (rhs_num && get_variable(operation->get_lhs()) == var) return -rhs_num->get_value();
+		}
+		return {};
+	}
+
+	bool is_array(Variable *var) {
+		Type &type = var->get_type();
+		return type.get_a_type() == A_type::int64 && type.get_num_dimensions() > 0;
+	}
+
+	void plan_access(
+		IRFunction &ir_function,
+		LoopPlan &plan,
+		MemoryLocation &location,
+		const Map<Variable *, Vec<Instruction *>> &writes_in_loop
+	) {
+		Opt<Variable *> maybe_array = location.get_base().get_referent();
+		if (!maybe_array || !is_array(*maybe_array) || writes_in_loop.count(*maybe_array)) return;
+		Variable *array = *maybe_array;
+		Vec<Uptr<Expr>> &dimensions = location.get_dimensions();
+		int n = dimensions.size();
+		if (n == 0) return;
+
+		auto is_invariant = [&](Expr &expr) {
+			if (dynamic_cast<NumberLiteral *>(&expr)) return true;
+			Opt<Variable *> var = get_variable(expr);
+			return var && !writes_in_loop.count(*var);
+		};
+		bool outer_indices_invariant = std::all_of(
+			dimensions.begin(),
+			dimensions.end() - 1,
+			[&](const Uptr<Expr> &index) { return is_invariant(*index); }
+		);
+
+		// the only way the loop may change the last index is by adding
+		// constants to it (more than once if the loop was unrolled)
+		bool can_hoist_address = false;
+		Vec<Pair<Instruction *, int64_t>> increments;
+		if (outer_indices_invariant) {
+			Expr &last_index = *dimensions[n - 1];
+			if (is_invariant(last_index)) {
+				can_hoist_address = true;
+			} else if (Opt<Variable *> var = get_variable(last_index)) {
+				can_hoist_address = true;
+				for (Instruction *write : writes_in_loop.at(*var)) {
+					Opt<int64_t> step = get_constant_increment(*write, *var);
+					if (!step) {
+						can_hoist_address = false;
+						break;
+					}
+					increments.emplace_back(write, *step);
+				}
+			}
+		}
+		if (!can_hoist_address && n < 2) return;
+
+		if (std::find(plan.arrays.begin(), plan.arrays.end(), array) == plan.arrays.end()) {
+			plan.arrays.push_back(array);
+		}
+		auto [strides_it, strides_are_new] = plan.strides.insert({ array, {} });
+		Vec<Variable *> &strides = strides_it->second;
+		if (strides_are_new) {
+			for (int i = 0; i < n - 1; ++i) {
+				strides.push_back(ir_function.add_generated_variable(array->get_name() + "stride", Type(A_type::int64, 0)));
+			}
+		}
+		if (strides.size() != n - 1) return; // accessed with a different number of indices
+
+		if (can_hoist_address) {
+			std::string key = location.to_string();
+			auto [index_it, is_new] = plan.address_index_map.insert({ key, plan.addresses.size() });
+			if (is_new) {
+				HoistedAddress address;
+				address.array = array;
+				for (Uptr<Expr> &index : dimensions) {
+					address.indices.push_back(index.get());
+				}
+				address.address = ir_function.add_generated_variable(array->get_name() + "addr", Type(A_type::int64, 0));
+				address.increments = increments;
+				plan.addresses.push_back(mv(address));
+			}
+			location.set_hoisted_address(plan.addresses[index_it->second].address);
+		} else {
+			location.set_hoisted_strides(strides);
+		}
+	}
+
+	// the instructions that compute an array's strides and hoisted addresses
+	Vec<Uptr<Instruction>> generate_preheader_code(const LoopPlan &plan, Variable *array, Variable *temp) {
+		Vec<Uptr<Instruction>> result;
+
+		// stride i is the product of the lengths of dimensions i + 1 onward
+		const Vec<Variable *> &strides = plan.strides.at(array);
+		for (int i = strides.size() - 1; i >= 0; --i) {
+			result.push_back(mkuptr<InstructionLength>(make_bound_ref(strides[i]), mkuptr<Length>(make_bound_ref(array), i + 1)));
+			result.push_back(make_assignment(strides[i], make_bound_ref(strides[i]), Operator::rshift, mkuptr<NumberLiteral>(1)));
+			if (i + 1 < strides.size()) {
+				result.push_back(make_assignment(strides[i], make_bound_ref(strides[i]), Operator::times, make_bound_ref(strides[i + 1])));
+			}
+		}
+
+		for (const HoistedAddress &address : plan.addresses) {
+			if (address.array != array) continue;
+			int n = address.indices.size();
+			Variable *dest = address.address;
+			result.push_back(mkuptr<InstructionAssignment>(make_bound_ref(dest), copy_operand(*address.indices[n - 1])));
+			for (int i = 0; i < n - 1; ++i) {
+				result.push_back(make_assignment(temp, copy_operand(*address.indices[i]), Operator::times, make_bound_ref(strides[i])));
+				result.push_back(make_assignment(dest, make_bound_ref(dest), Operator::plus, make_bound_ref(temp)));
+			}
+			result.push_back(make_assignment(dest, make_bound_ref(dest), Operator::plus, mkuptr<NumberLiteral>(n + 1)));
+			result.push_back(make_assignment(dest, make_bound_ref(dest), Operator::times, mkuptr<NumberLiteral>(8)));
+			result.push_back(make_assignment(dest, make_bound_ref(dest), Operator::plus, make_bound_ref(array)));
+		}
+		return result;
+	}
+
+	// Puts the preheader in front of the loop's header: for each array, one
+	// block that checks for null and one that computes the strides and
+	// addresses.
+	void build_preheader(IRFunction &ir_function, const LoopPlan &plan, Variable *condition, Variable *temp) {
+		const Vec<Uptr<BasicBlock>> &blocks = ir_function.get_blocks();
+		int header_index = 0;
+		while (blocks[header_index].get() != plan.header) {
+			header_index += 1;
+		}
+
+		BasicBlock *next = plan.header;
+		for (auto it = plan.arrays.rbegin(); it != plan.arrays.rend(); ++it) {
+			Variable *array = *it;
+			BasicBlock *compute = ir_function.insert_block(
+				header_index,
+				"addrcompute",
+				generate_preheader_code(plan, array, temp),
+				mkuptr<TerminatorBranchOne>(make_bound_ref(next))
+			);
+			Vec<Uptr<Instruction>> check_inst;
+			check_inst.push_back(make_assignment(condition, make_bound_ref(array), Operator::eq, mkuptr<NumberLiteral>(0)));
+			next = ir_function.insert_block(
+				header_index,
+				"addrcheck",
+				mv(check_inst),
+				mkuptr<TerminatorBranchTwo>(make_bound_ref(condition), make_bound_ref(next), make_bound_ref(compute))
+			);
+			if (const Opt<int64_t> &count = plan.header->get_execution_count()) {
+				compute->set_execution_count(*count);
+				next->set_execution_count(*count);
+			}
+		}
+
+		for (BasicBlock *pred : plan.outside_preds) {
+			cfg::redirect_edge(*pred, plan.header, next);
+		}
+	}
+
+	void hoist_array_addressing(IRFunction &ir_function) {
+		const Vec<Uptr<BasicBlock>> &blocks = ir_function.get_blocks();
+		if (blocks.empty()) return;
+		cfg::FlowGraph graph = cfg::make_flow_graph(blocks);
+		Vec<int> idoms = cfg::find_immediate_dominators(graph.successors);
+		Vec<cfg::NaturalLoop> loops = cfg::find_natural_loops(graph, idoms);
+		if (loops.empty()) return;
+
+		// each access is handled by the innermost loop containing it
+		Vec<int> innermost_loop(blocks.size(), -1);
+		for (int l = 0; l < loops.size(); ++l) {
+			for (int block : loops[l].body) {
+				int &innermost = innermost_loop[block];
+				if (innermost == -1 || loops[l].body.size() < loops[innermost].body.size()) {
+					innermost = l;
+				}
+			}
+		}
+
+		Vec<LoopPlan> plans;
+		Map<Instruction *, BasicBlock *> increment_blocks;
+		for (int l = 0; l < loops.size(); ++l) {
+			const cfg::NaturalLoop &loop = loops[l];
+			LoopPlan plan;
+			plan.header = blocks[loop.header].get();
+			for (int pred : graph.predecessors[loop.header]) {
+				if (!loop.body.count(pred)) {
+					plan.outside_preds.push_back(blocks[pred].get());
+				}
+			}
+
+			Map<Variable *, Vec<Instruction *>> writes_in_loop;
+			for (int block : loop.body) {
+				for (const Uptr<Instruction> &inst : blocks[block]->get_inst()) {
+					if (Opt<Variable *> var = inst->get_variable_written()) {
+						writes_in_loop[*var].push_back(inst.get());
+						increment_blocks.insert({ inst.get(), blocks[block].get() });
+					}
+				}
+			}
+
+			for (int block : loop.body) {
+				if (innermost_loop[block] != l) continue;
+				for (const Uptr<Instruction> &inst : blocks[block]->get_inst()) {
+					if (Opt<MemoryLocation *> location = get_memory_location(*inst)) {
+						plan_access(ir_function, plan, **location, writes_in_loop);
+					}
+				}
+			}
+			if (!plan.arrays.empty()) {
+				plans.push_back(mv(plan));
+			}
+		}
+		if (plans.empty()) return;
+
+		Variable *condition = ir_function.add_generated_variable("addrnull", Type(A_type::int64, 0));
+		Variable *temp = ir_function.add_generated_variable("addroffset", Type(A_type::int64, 0));
+		for (const LoopPlan &plan : plans) {
+			build_preheader(ir_function, plan, condition, temp);
+
+			// keep each address in step with its last index
+			for (const HoistedAddress &address : plan.addresses) {
+				for (auto [inst, step] : address.increments) {
+					Vec<Uptr<Instruction>> &insts = increment_blocks.at(inst)->get_inst();
+					auto inst_it = std::find_if(
+						insts.begin(),
+						insts.end(),
+						[&](const Uptr<Instruction> &other) { return other.get() == inst; }
+					);
+					insts.insert(
+						inst_it + 1,
+						make_assignment(address.address, make_bound_ref(address.address), Operator::plus, mkuptr<NumberLiteral>(step * 8))
+					);
+				}
+			}
+		}
+	}
+
+	void hoist_array_addressing(Program &program) {
+		for (Uptr<IRFunction> &ir_function : program.get_ir_functions()) {
+			hoist_array_addressing(*ir_function);
+		}
+	}
+}
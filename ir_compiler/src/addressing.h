@@ -0,0 +1,27 @@
+#pragma once
+#include "std_alias.h"
+#include "program.h"
+#include "cfg.h"
+
+// Strength reduction of array addressing in loops.
+//
+// Without this pass, every array access loads the lengths of the array's
+// dimensions from its header and multiplies them into the flat offset. For
+// each access in a loop whose array variable the loop never writes to, the
+// pass computes the array's strides once in a new preheader block, so the
+// access only does one multiply-add per dimension. If the outer indices are
+// also loop-invariant, the whole address is kept in a variable instead:
+// - if the last index doesn't change in the loop, the address is computed
+//   once in the preheader
+// - if the last index is only changed by adding constants, the address is
+//   bumped by 8 * c right after each addition of c
+// The preheader skips the header loads if the array is null, so the pass
+// never introduces a crash into a loop that doesn't run.
+namespace IR::addressing {
+	using namespace std_alias;
+	using namespace IR::program;
+
+	void hoist_array_addressing(IRFunction &ir_function);
+
+	void hoist_array_addressing(Program &program);
+}
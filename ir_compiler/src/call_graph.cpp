@@ -0,0 +1,125 @@
+#include "call_graph.h"
+#include <cmath>
+
+namespace IR::call_graph {
+	using namespace std_alias;
+	using namespace IR::program;
+
+	// how often each block runs, measured or estimated from the loops around it
+	Vec<double> estimate_block_frequencies(IRFunction &ir_function, bool has_profile) {
+		const Vec<Uptr<BasicBlock>> &blocks = ir_function.get_blocks();
+		Vec<double> frequencies(blocks.size(), 1.0);
+		if (has_profile) {
+			for (int i = 0; i < blocks.size(); ++i) {
+				frequencies[i] = blocks[i]->get_execution_count().value_or(0);
+			}
+			return frequencies;
+		}
+		if (blocks.empty()) return frequencies;
+		cfg::FlowGraph graph = cfg::make_flow_graph(blocks);
+		Vec<int> idoms = cfg::find_immediate_dominators(graph.successors);
+		for (const cfg::NaturalLoop &loop : cfg::find_natural_loops(graph, idoms)) {
+			for (int block : loop.body) {
+				frequencies[block] *= 10;
+			}
+		}
+		return frequencies;
+	}
+
+	void order_functions(Program &program) {
+		Vec<Uptr<IRFunction>> &functions = program.get_ir_functions();
+		int num_functions = functions.size();
+		Map<IRFunction *, int> function_index_map;
+		bool has_profile = false;
+		for (int i = 0; i < num_functions; ++i) {
+			function_index_map.insert({ functions[i].get(), i });
+			for (const Uptr<BasicBlock> &block : functions[i]->get_blocks()) {
+				has_profile = has_profile || block->get_execution_count().has_value();
+			}
+		}
+
+		// weights of the edges between distinct functions, keyed by (lower index, higher index)
+		Map<Pair<int, int>, double> edge_weights;
+		Vec<double> heat(num_functions, 0.0); // how often each function gets called
+		for (int caller = 0; caller < num_functions; ++caller) {
+			const Vec<Uptr<BasicBlock>> &blocks = functions[caller]->get_blocks();
+			Vec<double> frequencies = estimate_block_frequencies(*functions[caller], has_profile);
+			for (int i = 0; i < blocks.size(); ++i) {
+				Vec<Uptr<Expr> *> operands;
+				for (Uptr<Instruction> &inst : blocks[i]->get_inst()) {
+					inst->collect_operands(operands);
+				}
+				blocks[i]->get_terminator()->collect_operands(operands);
+				for (Uptr<Expr> *operand : operands) {
+					ItemRef<IRFunction> *ref = dynamic_cast<ItemRef<IRFunction> *>(operand->get());
+					if (!ref || !ref->get_referent()) continue;
+					int callee = function_index_map.at(*ref->get_referent());
+					if (callee == caller) continue;
+					heat[callee] += frequencies[i];
+					edge_weights[{ std::min(caller, callee), std::max(caller, callee) }] += frequencies[i];
+				}
+			}
+		}
+
+		Vec<Pair<Pair<int, int>, double>> edges(edge_weights.begin(), edge_weights.end());
+		std::sort(edges.begin(), edges.end(), [](const auto &a, const auto &b) {
+			return a.second != b.second ? a.second > b.second : a.first < b.first;
+		});
+		Vec<Vec<int>> chains(num_functions);
+		Vec<int> chain_of(num_functions);
+		for (int i = 0; i < num_functions; ++i) {
+			chains[i] = { i };
+			chain_of[i] = i;
+		}
+		for (const auto &[edge, weight] : edges) {
+			if (weight <= 0) break;
+			auto [a, b] = edge;
+			if (chain_of[a] == chain_of[b]) continue;
+			Vec<int> &chain_a = chains[chain_of[a]];
+			Vec<int> &chain_b = chains[chain_of[b]];
+
+			// put a at the back of its chain and b at the front of its own
+			int a_position = std::find(chain_a.begin(), chain_a.end(), a) - chain_a.begin();
+			if (a_position < chain_a.size() - 1 - a_position) {
+				std::reverse(chain_a.begin(), chain_a.end());
+			}
+			int b_position = std::find(chain_b.begin(), chain_b.end(), b) - chain_b.begin();
+			if (b_position > chain_b.size() - 1 - b_position) {
+				std::reverse(chain_b.begin(), chain_b.end());
+			}
+			for (int function : chain_b) {
+				chain_of[function] = chain_of[a];
+				chain_a.push_back(function);
+			}
+			chain_b.clear();
+		}
+
+		int main_index = -1;
+		for (int i = 0; i < num_functions; ++i) {
+			if (functions[i]->get_name() == "main") {
+				main_index = i;
+			}
+		}
+		Vec<int> chain_order;
+		Vec<double> chain_heat(num_functions, 0.0);
+		for (int i = 0; i < num_functions; ++i) {
+			chain_heat[chain_of[i]] += heat[i];
+			if (chains[i].empty()) continue;
+			chain_order.push_back(i);
+		}
+		std::stable_sort(chain_order.begin(), chain_order.end(), [&](int a, int b) {
+			bool a_has_main = main_index != -1 && chain_of[main_index] == a;
+			bool b_has_main = main_index != -1 && chain_of[main_index] == b;
+			if (a_has_main != b_has_main) return a_has_main;
+			return chain_heat[a] > chain_heat[b];
+		});
+
+		Vec<Uptr<IRFunction>> ordered_functions;
+		for (int chain : chain_order) {
+			for (int function : chains[chain]) {
+				ordered_functions.push_back(mv(functions[function]));
+			}
+		}
+		functions = mv(ordered_functions);
+	}
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include "std_alias.h"
+#include "program.h"
+#include "cfg.h"
+
+// Function layout by call-graph heat (Pettis & Hansen).
+//
+// The weight of the edge between two functions is how often one calls (or
+// takes the address of) the other, in either direction. With a profile,
+// that's the measured count of the blocks holding the calls; without one,
+// each call counts once, times 10 for every loop around it. Starting with
+// every function on its own, the heaviest edges join their two functions'
+// chains, each chain turned around if needed so the two functions end up
+// next to each other. The chain with @main comes first, then the rest from
+// hottest to coldest, so the functions that are never called end up last.
+namespace IR::call_graph {
+	using namespace std_alias;
+	using namespace IR::program;
+
+	void order_functions(Program &program);
+}
@@ -0,0 +1,186 @@
+#include "cfg.h"
+
+namespace IR::cfg {
+	using namespace std_alias;
+	using namespace IR::program;
+
+	FlowGraph make_flow_graph(const Vec<Uptr<BasicBlock>> &blocks) {
+		FlowGraph graph;
+		for (int i = 0; i < blocks.size(); ++i) {
+			graph.block_index_map.insert_or_assign(blocks[i].get(), i);
+		}
+		graph.successors.resize(blocks.size());
+		graph.predecessors.resize(blocks.size());
+		for (int i = 0; i < blocks.size(); ++i) {
+			for (auto [succ, priority] : blocks[i]->get_successors()) {
+				int succ_index = graph.block_index_map.at(succ);
+				graph.successors[i].push_back(succ_index);
+				graph.predecessors[succ_index].push_back(i);
+			}
+		}
+		return graph;
+	}
+
+	Vec<int> find_immediate_dominators(const Vec<Vec<int>> &successors) {
+		int num_blocks = successors.size();
+
+		// number the blocks in postorder
+		Vec<int> postorder;
+		Vec<int> postorder_number(num_blocks, -1);
+		Vec<bool> visited(num_blocks, false);
+		Vec<Pair<int, int>> stack; // (block, index of the next successor to visit)
+		stack.emplace_back(0, 0);
+		visited[0] = true;
+		while (!stack.empty()) {
+			auto &[block, next_succ] = stack.back();
+			if (next_succ < successors[block].size()) {
+				int succ = successors[block][next_succ];
+				next_succ += 1;
+				if (!visited[succ]) {
+					visited[succ] = true;
+					stack.emplace_back(succ, 0);
+				}
+			} else {
+				postorder_number[block] = postorder.size();
+				postorder.push_back(block);
+				stack.pop_back();
+			}
+		}
+
+		Vec<Vec<int>> predecessors(num_blocks);
+		for (int block = 0; block < num_blocks; ++block) {
+			for (int succ : successors[block]) {
+				predecessors[succ].push_back(block);
+			}
+		}
+
+		Vec<int> idoms(num_blocks, -1);
+		idoms[0] = 0;
+		auto intersect = [&](int a, int b) {
+			while (a != b) {
+				while (postorder_number[a] < postorder_number[b]) a = idoms[a];
+				while (postorder_number[b] < postorder_number[a]) b = idoms[b];
+			}
+			return a;
+		};
+		bool changed = true;
+		while (changed) {
+			changed = false;
+			for (auto it = postorder.rbegin(); it != postorder.rend(); ++it) {
+				int block = *it;
+				if (block == 0) continue;
+				int new_idom = -1;
+				for (int pred : predecessors[block]) {
+					if (idoms[pred] == -1) continue;
+					new_idom = new_idom == -1 ? pred : intersect(pred, new_idom);
+				}
+				if (idoms[block] != new_idom) {
+					idoms[block] = new_idom;
+					changed = true;
+				}
+			}
+		}
+		return idoms;
+	}
+
+	bool dominates(const Vec<int> &idoms, int dominator, int block) {
+		if (idoms[block] == -1) {
+			return false;
+		}
+		while (block != dominator) {
+			if (block == 0) {
+				return false;
+			}
+			block = idoms[block];
+		}
+		return true;
+	}
+
+	Vec<NaturalLoop> find_natural_loops(const FlowGraph &graph, const Vec<int> &idoms) {
+		Vec<NaturalLoop> loops;
+		Map<int, int> loop_index_by_header;
+		for (int block = 0; block < graph.successors.size(); ++block) {
+			for (int header : graph.successors[block]) {
+				if (!dominates(idoms, header, block)) continue;
+				auto [loop_it, is_new] = loop_index_by_header.insert({ header, loops.size() });
+				if (is_new) {
+					loops.push_back(NaturalLoop { header, { header } });
+				}
+				Set<int> &body = loops[loop_it->second].body;
+				Vec<int> worklist { block };
+				while (!worklist.empty()) {
+					int body_block = worklist.back();
+					worklist.pop_back();
+					if (body.count(body_block) && body_block != block) continue;
+					body.insert(body_block);
+					if (body_block == header) continue;
+					for (int pred : graph.predecessors[body_block]) {
+						if (!body.count(pred)) {
+							worklist.push_back(pred);
+						}
+					}
+				}
+			}
+		}
+		return loops;
+	}
+
+	void remove_phi_incoming(BasicBlock &block, BasicBlock *pred) {
+		for (Uptr<Instruction> &inst : block.get_inst()) {
+			InstructionPhi *phi = dynamic_cast<InstructionPhi *>(inst.get());
+			if (!phi) continue;
+			Vec<Pair<BasicBlock *, Uptr<Expr>>> &incoming = phi->get_incoming();
+			auto remove_begin = std::remove_if(
+				incoming.begin(),
+				incoming.end(),
+				[&](const Pair<BasicBlock *, Uptr<Expr>> &entry) { return entry.first == pred; }
+			);
+			incoming.erase(remove_begin, incoming.end());
+		}
+	}
+
+	void redirect_edge(BasicBlock &pred, BasicBlock *old_succ, BasicBlock *new_succ) {
+		pred.get_terminator()->replace_successor(old_succ, new_succ);
+		for (auto &[succ, probability] : pred.get_successors()) {
+			if (succ == old_succ) {
+				succ = new_succ;
+			}
+		}
+	}
+
+	void set_terminator(BasicBlock &block, Uptr<Terminator> &&te) {
+		block.get_terminator() = mv(te);
+		block.set_successors(block.get_terminator()->get_successor());
+	}
+
+	void remove_unreachable_blocks(IRFunction &ir_function) {
+		const Vec<Uptr<BasicBlock>> &blocks = ir_function.get_blocks();
+		if (blocks.empty()) return;
+		Set<BasicBlock *> reachable { blocks[0].get() };
+		Vec<BasicBlock *> worklist { blocks[0].get() };
+		while (!worklist.empty()) {
+			BasicBlock *block = worklist.back();
+			worklist.pop_back();
+			for (auto [succ, probability] : block->get_successors()) {
+				if (reachable.insert(succ).second) {
+					worklist.push_back(succ);
+				}
+			}
+		}
+		if (reachable.size() == blocks.size()) return;
+
+		Set<BasicBlock *> dead_blocks;
+		for (const Uptr<BasicBlock> &block : blocks) {
+			if (!reachable.count(block.get())) {
+				dead_blocks.insert(block.get());
+			}
+		}
+		for (const Uptr<BasicBlock> &block : blocks) {
+			if (!reachable.count(block.get())) continue;
+			for (BasicBlock *dead_block : dead_blocks) {
+				remove_phi_incoming(*block, dead_block);
+			}
+		}
+		ir_function.remove_blocks(dead_blocks);
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include "std_alias.h"
+#include "program.h"
+
+// Control-flow graph analyses shared by the IR passes. Blocks are referred to
+// by their index in the function's block list, and block 0 is the entry.
+namespace IR::cfg {
+	using namespace std_alias;
+	using namespace IR::program;
+
+	struct FlowGraph {
+		Map<BasicBlock *, int> block_index_map;
+		Vec<Vec<int>> successors;
+		Vec<Vec<int>> predecessors;
+	};
+
+	FlowGraph make_flow_graph(const Vec<Uptr<BasicBlock>> &blocks);
+
+	// Cooper, Harvey & Kennedy's iterative algorithm. Returns the index of
+	// each block's immediate dominator, with -1 for unreachable blocks and
+	// the entry block's own index for the entry block.
+	Vec<int> find_immediate_dominators(const Vec<Vec<int>> &successors);
+
+	bool dominates(const Vec<int> &idoms, int dominator, int block);
+
+	// A back edge goes to a block that dominates its source; the body of its
+	// natural loop is everything that reaches the source without going
+	// through the header. Loops that share a header are merged.
+	struct NaturalLoop {
+		int header;
+		Set<int> body; // includes the header
+	};
+
+	Vec<NaturalLoop> find_natural_loops(const FlowGraph &graph, const Vec<int> &idoms);
+
+	// drops the values that the block's phis take when coming from `pred`
+	void remove_phi_incoming(BasicBlock &block, BasicBlock *pred);
+
+	// makes `pred` jump to new_succ wherever it jumped to old_succ
+	void redirect_edge(BasicBlock &pred, BasicBlock *old_succ, BasicBlock *new_succ);
+
+	// replaces the block's terminator and recomputes its successors
+	void set_terminator(BasicBlock &block, Uptr<Terminator> &&te);
+
+	// deletes the blocks that can't be reached from the entry block
+	void remove_unreachable_blocks(IRFunction &ir_function);
+}
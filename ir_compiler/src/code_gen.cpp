@@ -5,7 +5,62 @@ namespace IR::code_gen {
     using namespace IR::program;
     using namespace IR::tracer;
 
-    void generate_ir_function_code(IRFunction &ir_function, std::ostream &o) {
+    // whether the block's true successor comes right after it in the trace
+    bool true_successor_falls_through(const Trace &trace, int index_in_trace, BasicBlock *true_succ) {
+        return index_in_trace + 1 < trace.block_sequence.size()
+            && trace.block_sequence[index_in_trace + 1] == true_succ;
+    }
+
+    // When a two-way branch's true successor falls through, the branch has to
+    // jump on the negated condition. If the condition is computed by a
+    // comparison right before the branch and nothing else reads it, we can
+    // invert the comparison operator and swap the successors instead, so that
+    // L3 can merge the comparison into a single conditional jump.
+    void fuse_negated_branches(IRFunction &ir_function, const Vec<Trace> &traces) {
+        Map<Variable *, int> num_reads;
+        Vec<Variable *> vars_read;
+        for (const Uptr<BasicBlock> &bb : ir_function.get_blocks()) {
+            for (const Uptr<Instruction> &inst : bb->get_inst()) {
+                inst->collect_variables_read(vars_read);
+            }
+            bb->get_terminator()->collect_variables_read(vars_read);
+        }
+        for (Variable *var : vars_read) {
+            num_reads[var] += 1;
+        }
+
+        for (const Trace &trace : traces) {
+            for (int i = 0; i < trace.block_sequence.size(); ++i) {
+                BasicBlock *bb = trace.block_sequence[i];
+                TerminatorBranchTwo *branch = dynamic_cast<TerminatorBranchTwo *>(bb->get_terminator().get());
+                Vec<Pair<BasicBlock *, double>> &successors = bb->get_successors();
+                if (!branch || bb->get_inst().empty() || successors.size() != 2) continue;
+                if (!true_successor_falls_through(trace, i, successors[0].first)
+                    || true_successor_falls_through(trace, i, successors[1].first)) continue;
+
+                ItemRef<Variable> *condition = dynamic_cast<ItemRef<Variable> *>(&branch->get_condition());
+                InstructionAssignment *assignment = dynamic_cast<InstructionAssignment *>(bb->get_inst().back().get());
+                if (!condition || !assignment || !assignment->get_dest()) continue;
+                Opt<Variable *> condition_var = condition->get_referent();
+                if (!condition_var || assignment->get_dest().value()->get_referent() != condition_var) continue;
+                if (num_reads[*condition_var] != 1) continue;
+                BinaryOperation *comparison = dynamic_cast<BinaryOperation *>(&assignment->get_source());
+                if (!comparison) continue;
+                Opt<Operator> inverse = invert_comparison(comparison->get_op());
+                if (!inverse) continue;
+
+                comparison->set_op(*inverse);
+                branch->swap_successors();
+                std::swap(successors[0], successors[1]);
+            }
+        }
+    }
+
+    // the most room a function's frame gives to objects, in bytes; the
+    // objects that don't fit come from the heap as usual
+    const int64_t MAX_FRAME_SIZE = 8192;
+
+    void generate_ir_function_code(IRFunction &ir_function, std::ostream &o, const profile::CounterTable *counters) {
         // function header
         o << "define @" << ir_function.get_name() << "(";
         bool first = true;
@@ -21,18 +76,60 @@ namespace IR::code_gen {
 
         // print br :first_block
         const Uptr<BasicBlock> &first_block = ir_function.get_blocks()[0];
+        if (counters) {
+            std::string prologue_prefix = target_arch::new_variable_names(ir_function, *first_block) + "prologue";
+            if (ir_function.get_name() == "main") {
+                o << counters->get_count_store(prologue_prefix);
+            }
+            o << counters->get_increment(ir_function, prologue_prefix);
+        }
+
+        // give each object that can live in the frame its own slot, and
+        // claim the frame
+        std::string frame_prefix = target_arch::new_variable_names(ir_function, *first_block) + "frame";
+        std::string frame_base = "%" + frame_prefix + "base";
+        std::string saved_frame_pointer = "%" + frame_prefix + "saved";
+        int64_t frame_size = 0;
+        for (const Uptr<BasicBlock> &bb : ir_function.get_blocks()) {
+            for (Uptr<Instruction> &inst : bb->get_inst()) {
+                InstructionInitializeArray *allocation = dynamic_cast<InstructionInitializeArray *>(inst.get());
+                if (!allocation || !allocation->is_in_frame()) continue;
+                Opt<int64_t> num_words = allocation->get_constant_num_words();
+                if (!num_words || frame_size + *num_words * 8 > MAX_FRAME_SIZE) continue;
+                allocation->set_frame_slot(frame_base, frame_size);
+                frame_size += *num_words * 8;
+            }
+        }
+        if (frame_size > 0) {
+            o << generate_frame_entry(frame_base, saved_frame_pointer, frame_size, frame_prefix);
+        }
         o << "\tbr :" << first_block->get_name() << "\n";
 
         // print each block
+        estimate_branch_probabilities(ir_function.get_blocks());
         Vec<Trace> traces = trace_cfg(ir_function.get_blocks());
+        fuse_negated_branches(ir_function, traces);
+        bool in_cold_region = false;
         for (Trace trace: traces) {
+            if (trace.is_cold && !in_cold_region) {
+                // the cold traces come last; mark where they start so the
+                // backend can move them out of the hot code
+                o << "\t:" << target_arch::COLD_REGION_LABEL << "\n";
+                in_cold_region = true;
+            }
             std::string last_prefix = "";
             for (BasicBlock *bb: trace.block_sequence) {
                 o << "\t" << ":" << bb->get_name() << "\n";
                 last_prefix = target_arch::new_variable_names(ir_function, *bb);
+                if (counters) {
+                    o << counters->get_increment(*bb, last_prefix);
+                }
                 for (Uptr<Instruction> &inst : bb->get_inst()) {
                     o << inst->to_l3_inst(last_prefix);
                 }
+                if (frame_size > 0 && bb->get_terminator()->get_successor().empty()) {
+                    o << generate_frame_exit(saved_frame_pointer, frame_prefix);
+                }
                 o << bb->get_terminator()->to_l3_terminator(last_prefix, trace, bb);
             }
         }
@@ -76,11 +173,11 @@ namespace IR::code_gen {
     //     o << "\t)\n";
     // }
 
-    void generate_program_code(Program &program, std::ostream &o) {
+    void generate_program_code(Program &program, std::ostream &o, const profile::CounterTable *counters) {
 		target_arch::mangle_label_names(program);
 
 		for (const Uptr<IRFunction> &function : program.get_ir_functions()) {
-			generate_ir_function_code(*function, o);
+			generate_ir_function_code(*function, o, counters);
 		}
 		o << "\n";
 	}
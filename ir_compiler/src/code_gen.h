@@ -4,11 +4,13 @@
 #include "tracer.h"
 #include "std_alias.h"
 #include "target_arch.h"
+#include "profile.h"
 #include <iostream>
 
 namespace IR::code_gen {
 
-	void generate_ir_function_code(IR::program::IRFunction &ir_function, std::ostream &o);
+	// if `counters` is given, every function and block bumps its counter
+	void generate_ir_function_code(IR::program::IRFunction &ir_function, std::ostream &o, const IR::profile::CounterTable *counters);
 
-	void generate_program_code(IR::program::Program &program, std::ostream &o);
+	void generate_program_code(IR::program::Program &program, std::ostream &o, const IR::profile::CounterTable *counters);
 }
\ No newline at end of file
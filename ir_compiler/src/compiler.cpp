@@ -1,6 +1,11 @@
 #include "std_alias.h"
 #include "tracer.h"
 #include "code_gen.h"
+#include "profile.h"
+#include "addressing.h"
+#include "optimize.h"
+#include "loops.h"
+#include "call_graph.h"
 #include "parser.h"
 #include <string>
 #include <vector>
@@ -21,7 +26,7 @@
 using namespace std_alias;
 
 void print_help(char *progName) {
-	std::cerr << "Usage: " << progName << " [-v] [-g 0|1] [-O 0|1|2] [-p] SOURCE" << std::endl;
+	std::cerr << "Usage: " << progName << " [-v] [-g 0|1] [-O 0|1|2] [-p] [-finstrument] [-fprofile-use=PROFILE] [-funroll-factor=N] [-floop-size-budget=N] SOURCE" << std::endl;
 	return;
 }
 
@@ -32,7 +37,10 @@ int main(
 	bool enable_code_generator = true;
 	bool output_parse_tree = false;
 	bool verbose = false;
+	bool instrument = false;
+	Opt<std::string> profile_file_name;
 	int32_t optimizationLevel = 3;
+	IR::loops::LoopOptions loop_options { 4, 160 };
 
 	// Check the compiler arguments.
 	if (argc < 2) {
@@ -42,7 +50,7 @@ int main(
 
 	int32_t option;
 	int64_t functionNumber = -1;
-	while ((option = getopt(argc, argv, "vg:O:p")) != -1) {
+	while ((option = getopt(argc, argv, "vg:O:pf:")) != -1) {
 		switch (option) {
 			case 'O':
 				optimizationLevel = strtoul(optarg, NULL, 0);
@@ -56,6 +64,20 @@ int main(
 			case 'p':
 				output_parse_tree = true;
 				break;
+			case 'f':
+				if (std::strcmp(optarg, "instrument") == 0) {
+					instrument = true;
+				} else if (std::strncmp(optarg, "profile-use=", 12) == 0) {
+					profile_file_name = std::string(optarg + 12);
+				} else if (std::strncmp(optarg, "unroll-factor=", 14) == 0) {
+					loop_options.unroll_factor = strtoul(optarg + 14, NULL, 0);
+				} else if (std::strncmp(optarg, "loop-size-budget=", 17) == 0) {
+					loop_options.size_budget = strtoul(optarg + 17, NULL, 0);
+				} else {
+					print_help(argv[0]);
+					return 1;
+				}
+				break;
 			default:
 				print_help(argv[0]);
 				return 1;
@@ -65,10 +87,38 @@ int main(
 		argv[optind],
 		output_parse_tree ? std::make_optional("parse_tree.dot") : Opt<std::string>()
 	);
+	if (optimizationLevel > 0) {
+		IR::optimize::optimize_program(*p, verbose);
+		if (optimizationLevel > 1) {
+			// the loop copies are worth optimizing again, which is also what
+			// folds away the tests of loops with small constant trip counts
+			IR::loops::transform_loops(*p, loop_options);
+			IR::optimize::optimize_program(*p, verbose);
+		}
+		IR::addressing::hoist_array_addressing(*p);
+		for (Uptr<IR::program::IRFunction> &ir_function : p->get_ir_functions()) {
+			IR::optimize::simplify_cfg(*ir_function);
+		}
+	}
+
+	// the profile names blocks the way they are after optimization, since
+	// the instrumented build ran the same passes
+	if (profile_file_name) {
+		IR::profile::apply_profile(*p, IR::profile::Profile::read(*profile_file_name));
+	}
+	if (optimizationLevel > 0) {
+		IR::call_graph::order_functions(*p);
+	}
 	if (enable_code_generator) {
+		Opt<IR::profile::CounterTable> counters;
+		if (instrument) {
+			counters.emplace(*p);
+			counters->write_counter_names(IR::profile::COUNTER_NAMES_FILE);
+		}
+
 		std::ofstream o;
 		o.open("prog.L3");
-		IR::code_gen::generate_program_code(*p, o);
+		IR::code_gen::generate_program_code(*p, o, counters ? &*counters : nullptr);
 		o.close();
 	}
 
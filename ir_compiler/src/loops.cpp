@@ -0,0 +1,222 @@
+#include "loops.h"
+
+namespace IR::loops {
+	using namespace std_alias;
+	using namespace IR::program;
+
+	struct Loop {
+		BasicBlock *header;
+		Vec<BasicBlock *> body; // in the order of the function's block list
+		bool is_innermost;
+	};
+
+	Vec<Loop> find_loops(IRFunction &ir_function) {
+		const Vec<Uptr<BasicBlock>> &blocks = ir_function.get_blocks();
+		cfg::FlowGraph graph = cfg::make_flow_graph(blocks);
+		Vec<int> idoms = cfg::find_immediate_dominators(graph.successors);
+		Vec<cfg::NaturalLoop> natural_loops = cfg::find_natural_loops(graph, idoms);
+		Vec<Loop> loops;
+		for (const cfg::NaturalLoop &natural_loop : natural_loops) {
+			Loop loop { blocks[natural_loop.header].get(), {}, true };
+			for (int i = 0; i < blocks.size(); ++i) {
+				if (natural_loop.body.count(i)) {
+					loop.body.push_back(blocks[i].get());
+				}
+			}
+			for (const cfg::NaturalLoop &other : natural_loops) {
+				if (other.header != natural_loop.header && natural_loop.body.count(other.header)) {
+					loop.is_innermost = false;
+				}
+			}
+			loops.push_back(mv(loop));
+		}
+		return loops;
+	}
+
+	// the number of instructions the blocks turn into, counting terminators
+	int64_t get_code_size(const Vec<BasicBlock *> &blocks) {
+		int64_t size = 0;
+		for (BasicBlock *block : blocks) {
+			for (const Uptr<Instruction> &inst : block->get_inst()) {
+				if (!dynamic_cast<InstructionDeclaration *>(inst.get())) {
+					size += 1;
+				}
+			}
+			size += 1;
+		}
+		return size;
+	}
+
+	int get_index_after(const Vec<Uptr<BasicBlock>> &blocks, const Set<BasicBlock *> &group) {
+		int index = 0;
+		for (int i = 0; i < blocks.size(); ++i) {
+			if (group.count(blocks[i].get())) {
+				index = i + 1;
+			}
+		}
+		return index;
+	}
+
+	// Copies the blocks into the block list at the index. Jumps between the
+	// blocks go to the copies, and jumps anywhere else stay as they are.
+	// The copies share the originals' variables, so declarations aren't
+	// copied.
+	Map<BasicBlock *, BasicBlock *> copy_blocks(IRFunction &ir_function, const Vec<BasicBlock *> &originals, const std::string &name_suffix, int index) {
+		Map<BasicBlock *, BasicBlock *> copies;
+		for (BasicBlock *original : originals) {
+			Vec<Uptr<Instruction>> insts;
+			for (const Uptr<Instruction> &inst : original->get_inst()) {
+				if (!dynamic_cast<InstructionDeclaration *>(inst.get())) {
+					insts.push_back(inst->clone());
+				}
+			}
+			BasicBlock *copy = ir_function.insert_block(index, original->get_name() + name_suffix, mv(insts), original->get_terminator()->clone());
+			index += 1;
+			copy->set_successors(original->get_successors());
+			copies.insert({ original, copy });
+		}
+		for (auto [original, copy] : copies) {
+			for (auto [succ, probability] : Vec<Pair<BasicBlock *, double>>(copy->get_successors())) {
+				if (auto copies_it = copies.find(succ); copies_it != copies.end()) {
+					cfg::redirect_edge(*copy, succ, copies_it->second);
+				}
+			}
+		}
+		return copies;
+	}
+
+	// a block in the loop that branches on a variable the loop never writes
+	Opt<BasicBlock *> find_invariant_branch(const Loop &loop) {
+		Set<Variable *> vars_written;
+		for (BasicBlock *block : loop.body) {
+			for (const Uptr<Instruction> &inst : block->get_inst()) {
+				if (Opt<Variable *> var = inst->get_variable_written()) {
+					vars_written.insert(*var);
+				}
+			}
+		}
+		for (BasicBlock *block : loop.body) {
+			TerminatorBranchTwo *branch = dynamic_cast<TerminatorBranchTwo *>(block->get_terminator().get());
+			if (!branch || block->get_successors()[0].first == block->get_successors()[1].first) continue;
+			ItemRef<Variable> *ref = dynamic_cast<ItemRef<Variable> *>(&branch->get_condition());
+			if (ref && ref->get_referent() && !vars_written.count(*ref->get_referent())) {
+				return block;
+			}
+		}
+		return {};
+	}
+
+	// returns the copy of the loop's header
+	BasicBlock *unswitch_loop(IRFunction &ir_function, const Loop &loop, BasicBlock *branch_block) {
+		const Vec<Uptr<BasicBlock>> &blocks = ir_function.get_blocks();
+		Set<BasicBlock *> body(loop.body.begin(), loop.body.end());
+		Vec<BasicBlock *> outside_preds;
+		for (const Uptr<BasicBlock> &block : blocks) {
+			if (body.count(block.get())) continue;
+			for (auto [succ, probability] : block->get_successors()) {
+				if (succ == loop.header) {
+					outside_preds.push_back(block.get());
+					break;
+				}
+			}
+		}
+		Variable *condition = dynamic_cast<ItemRef<Variable> &>(
+			dynamic_cast<TerminatorBranchTwo &>(*branch_block->get_terminator()).get_condition()
+		).get_referent().value();
+
+		// the original loop always goes the true way, and the copy the false way
+		Map<BasicBlock *, BasicBlock *> copies = copy_blocks(ir_function, loop.body, "unswitched", get_index_after(blocks, body));
+		BasicBlock *branch_copy = copies.at(branch_block);
+		cfg::set_terminator(*branch_block, mkuptr<TerminatorBranchOne>(make_bound_ref(branch_block->get_successors()[0].first)));
+		cfg::set_terminator(*branch_copy, mkuptr<TerminatorBranchOne>(make_bound_ref(branch_copy->get_successors()[1].first)));
+
+		int header_index = 0;
+		while (blocks[header_index].get() != loop.header) {
+			header_index += 1;
+		}
+		BasicBlock *preheader = ir_function.insert_block(
+			header_index,
+			"unswitch",
+			{},
+			mkuptr<TerminatorBranchTwo>(make_bound_ref(condition), make_bound_ref(loop.header), make_bound_ref(copies.at(loop.header)))
+		);
+		for (BasicBlock *pred : outside_preds) {
+			cfg::redirect_edge(*pred, loop.header, preheader);
+		}
+		return copies.at(loop.header);
+	}
+
+	void unswitch_loops(IRFunction &ir_function, int64_t size_budget) {
+		if (ir_function.get_blocks().empty()) return;
+		Set<BasicBlock *> unswitched_headers;
+		bool changed = true;
+		while (changed) {
+			changed = false;
+			for (const Loop &loop : find_loops(ir_function)) {
+				if (unswitched_headers.count(loop.header) || get_code_size(loop.body) * 2 > size_budget) continue;
+				Opt<BasicBlock *> branch_block = find_invariant_branch(loop);
+				if (!branch_block) continue;
+				unswitched_headers.insert(loop.header);
+				unswitched_headers.insert(unswitch_loop(ir_function, loop, *branch_block));
+				changed = true;
+				break; // the loops have changed
+			}
+		}
+	}
+
+	void unroll_loop(IRFunction &ir_function, const Loop &loop, int64_t factor) {
+		const Vec<Uptr<BasicBlock>> &blocks = ir_function.get_blocks();
+		Set<BasicBlock *> placed(loop.body.begin(), loop.body.end());
+		Vec<Vec<BasicBlock *>> copies { loop.body };
+		for (int64_t c = 1; c < factor; ++c) {
+			Map<BasicBlock *, BasicBlock *> copy_map = copy_blocks(ir_function, loop.body, "unrolled", get_index_after(blocks, placed));
+			Vec<BasicBlock *> copy;
+			for (BasicBlock *block : loop.body) {
+				copy.push_back(copy_map.at(block));
+				placed.insert(copy_map.at(block));
+			}
+			copies.push_back(mv(copy));
+		}
+
+		// each copy's back edges go to the next copy's header, and the last
+		// copy's go back to the original header
+		int header_position = std::find(loop.body.begin(), loop.body.end(), loop.header) - loop.body.begin();
+		for (int64_t c = 0; c < factor; ++c) {
+			BasicBlock *header = copies[c][header_position];
+			BasicBlock *next_header = copies[(c + 1) % factor][header_position];
+			for (BasicBlock *block : copies[c]) {
+				for (auto [succ, probability] : block->get_successors()) {
+					if (succ == header) {
+						cfg::redirect_edge(*block, header, next_header);
+						break;
+					}
+				}
+			}
+		}
+	}
+
+	void unroll_loops(IRFunction &ir_function, const LoopOptions &options) {
+		if (ir_function.get_blocks().empty() || options.unroll_factor < 2) return;
+		Set<BasicBlock *> visited_headers;
+		bool changed = true;
+		while (changed) {
+			changed = false;
+			for (const Loop &loop : find_loops(ir_function)) {
+				if (!loop.is_innermost || visited_headers.count(loop.header)) continue;
+				visited_headers.insert(loop.header);
+				int64_t factor = std::min(options.unroll_factor, options.size_budget / get_code_size(loop.body));
+				if (factor < 2) continue;
+				unroll_loop(ir_function, loop, factor);
+				changed = true;
+				break; // the loops have changed
+			}
+		}
+	}
+
+	void transform_loops(Program &program, const LoopOptions &options) {
+		for (Uptr<IRFunction> &ir_function : program.get_ir_functions()) {
+			unswitch_loops(*ir_function, options.size_budget);
+			unroll_loops(*ir_function, options);
+		}
+	}
+}
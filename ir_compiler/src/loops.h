@@ -0,0 +1,35 @@
+#pragma once
+#include "std_alias.h"
+#include "program.h"
+#include "cfg.h"
+
+// Loop transformations that trade code size for less loop control. They
+// run outside of SSA form, on natural loops (see cfg.h).
+//
+// Unswitching: if a loop branches on a variable the loop never writes, the
+// branch goes the same way on every iteration. The loop is copied, each
+// copy goes one of the two ways unconditionally, and a new block in front
+// of the loop picks the copy once.
+//
+// Unrolling: an innermost loop's body is copied so that one trip around
+// the loop runs several iterations. Every copy keeps its exit tests, so any
+// trip count works. When the trip count is a small constant, constant
+// propagation afterwards removes the tests and the back edge altogether.
+//
+// Neither transformation makes a loop bigger than the size budget, counted
+// in IR instructions.
+namespace IR::loops {
+	using namespace std_alias;
+	using namespace IR::program;
+
+	struct LoopOptions {
+		int64_t unroll_factor; // iterations per trip around an unrolled loop
+		int64_t size_budget;
+	};
+
+	void unswitch_loops(IRFunction &ir_function, int64_t size_budget);
+
+	void unroll_loops(IRFunction &ir_function, const LoopOptions &options);
+
+	void transform_loops(Program &program, const LoopOptions &options);
+}
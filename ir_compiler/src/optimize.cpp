@@ -0,0 +1,667 @@
+#include "optimize.h"
+
+namespace IR::optimize {
+	using namespace std_alias;
+	using namespace IR::program;
+
+	enum struct LatticeLevel {
+		undefined, // no executable path has written the variable yet
+		constant,
+		overdefined
+	};
+
+	struct LatticeValue {
+		LatticeLevel level;
+		int64_t value;
+
+		bool operator!=(const LatticeValue &other) const {
+			return this->level != other.level
+				|| (this->level == LatticeLevel::constant && this->value != other.value);
+		}
+	};
+
+	const LatticeValue UNDEFINED = { LatticeLevel::undefined, 0 };
+	const LatticeValue OVERDEFINED = { LatticeLevel::overdefined, 0 };
+
+	LatticeValue meet(LatticeValue a, LatticeValue b) {
+		if (a.level == LatticeLevel::undefined) return b;
+		if (b.level == LatticeLevel::undefined) return a;
+		if (a.level == LatticeLevel::constant && b.level == LatticeLevel::constant && a.value == b.value) return a;
+		return OVERDEFINED;
+	}
+
+	// evaluates the operator the way the generated x86 code does
+	int64_t fold_operation(Operator op, int64_t lhs, int64_t rhs) {
+		uint64_t ulhs = lhs;
+		uint64_t urhs = rhs;
+		switch (op) {
+			case Operator::lt: return lhs < rhs;
+			case Operator::le: return lhs <= rhs;
+			case Operator::eq: return lhs == rhs;
+			case Operator::ge: return lhs >= rhs;
+			case Operator::gt: return lhs > rhs;
+			case Operator::plus: return ulhs + urhs;
+			case Operator::minus: return ulhs - urhs;
+			case Operator::times: return ulhs * urhs;
+			case Operator::bitwise_and: return lhs & rhs;
+			case Operator::lshift: return ulhs << (rhs & 63);
+			case Operator::rshift: return lhs >> (rhs & 63);
+		}
+		std::cerr << "unknown operator\n";
+		exit(1);
+	}
+
+	class ConstantPropagator {
+		const Vec<Uptr<BasicBlock>> &blocks;
+		cfg::FlowGraph graph;
+		Map<Variable *, LatticeValue> values; // only has the variables the function writes
+		Map<Variable *, Vec<Pair<int, Instruction *>>> uses; // (block, instruction) where nullptr is the block's terminator
+		Set<Pair<int, int>> executable_edges;
+		Vec<bool> is_executable;
+		Vec<Pair<int, int>> flow_worklist;
+		Vec<Pair<int, Instruction *>> ssa_worklist;
+
+		public:
+
+		ConstantPropagator(const Vec<Uptr<BasicBlock>> &blocks) :
+			blocks { blocks },
+			graph { cfg::make_flow_graph(blocks) },
+			is_executable(blocks.size(), false)
+		{
+			for (int i = 0; i < blocks.size(); ++i) {
+				for (const Uptr<Instruction> &inst : blocks[i]->get_inst()) {
+					if (Opt<Variable *> var = inst->get_variable_written()) {
+						this->values.insert({ *var, UNDEFINED });
+					}
+					Vec<Variable *> vars_read;
+					inst->collect_variables_read(vars_read);
+					for (Variable *var : vars_read) {
+						this->uses[var].emplace_back(i, inst.get());
+					}
+				}
+				Vec<Variable *> vars_read;
+				blocks[i]->get_terminator()->collect_variables_read(vars_read);
+				for (Variable *var : vars_read) {
+					this->uses[var].emplace_back(i, nullptr);
+				}
+			}
+		}
+
+		LatticeValue get_value(Variable *var) const {
+			auto value_it = this->values.find(var);
+			return value_it == this->values.end() ? OVERDEFINED : value_it->second;
+		}
+
+		LatticeValue evaluate(Expr &expr) const {
+			if (NumberLiteral *num = dynamic_cast<NumberLiteral *>(&expr)) {
+				return { LatticeLevel::constant, num->get_value() };
+			}
+			if (ItemRef<Variable> *ref = dynamic_cast<ItemRef<Variable> *>(&expr)) {
+				return ref->get_referent() ? this->get_value(*ref->get_referent()) : OVERDEFINED;
+			}
+			if (BinaryOperation *operation = dynamic_cast<BinaryOperation *>(&expr)) {
+				LatticeValue lhs = this->evaluate(operation->get_lhs());
+				LatticeValue rhs = this->evaluate(operation->get_rhs());
+				if (lhs.level == LatticeLevel::overdefined || rhs.level == LatticeLevel::overdefined) return OVERDEFINED;
+				if (lhs.level == LatticeLevel::undefined || rhs.level == LatticeLevel::undefined) return UNDEFINED;
+				return { LatticeLevel::constant, fold_operation(operation->get_op(), lhs.value, rhs.value) };
+			}
+			return OVERDEFINED;
+		}
+
+		void mark_edge(int from, int to) {
+			if (this->executable_edges.insert({ from, to }).second) {
+				this->flow_worklist.emplace_back(from, to);
+			}
+		}
+
+		void visit_instruction(int block, Instruction &inst) {
+			Opt<Variable *> var = inst.get_variable_written();
+			if (!var) return;
+			LatticeValue new_value = OVERDEFINED;
+			if (InstructionPhi *phi = dynamic_cast<InstructionPhi *>(&inst)) {
+				new_value = UNDEFINED;
+				for (auto &[pred, value] : phi->get_incoming()) {
+					if (this->executable_edges.count({ this->graph.block_index_map.at(pred), block })) {
+						new_value = meet(new_value, this->evaluate(*value));
+					}
+				}
+			} else if (InstructionAssignment *assignment = dynamic_cast<InstructionAssignment *>(&inst)) {
+				new_value = this->evaluate(assignment->get_source());
+			}
+			if (this->values.at(*var) != new_value) {
+				this->values.insert_or_assign(*var, new_value);
+				for (const Pair<int, Instruction *> &use : this->uses[*var]) {
+					this->ssa_worklist.push_back(use);
+				}
+			}
+		}
+
+		void visit_terminator(int block) {
+			const Vec<int> &successors = this->graph.successors[block];
+			if (TerminatorBranchTwo *branch = dynamic_cast<TerminatorBranchTwo *>(this->blocks[block]->get_terminator().get())) {
+				LatticeValue condition = this->evaluate(branch->get_condition());
+				if (condition.level == LatticeLevel::constant) {
+					// branches are taken when the condition is 1
+					this->mark_edge(block, successors[condition.value == 1 ? 0 : 1]);
+					return;
+				}
+				if (condition.level == LatticeLevel::undefined) {
+					return;
+				}
+			}
+			for (int succ : successors) {
+				this->mark_edge(block, succ);
+			}
+		}
+
+		void run() {
+			this->is_executable[0] = true;
+			for (const Uptr<Instruction> &inst : this->blocks[0]->get_inst()) {
+				this->visit_instruction(0, *inst);
+			}
+			this->visit_terminator(0);
+
+			while (!this->flow_worklist.empty() || !this->ssa_worklist.empty()) {
+				while (!this->flow_worklist.empty()) {
+					auto [from, to] = this->flow_worklist.back();
+					this->flow_worklist.pop_back();
+					bool first_visit = !this->is_executable[to];
+					this->is_executable[to] = true;
+					for (const Uptr<Instruction> &inst : this->blocks[to]->get_inst()) {
+						if (first_visit || dynamic_cast<InstructionPhi *>(inst.get())) {
+							this->visit_instruction(to, *inst);
+						}
+					}
+					if (first_visit) {
+						this->visit_terminator(to);
+					}
+				}
+				while (!this->ssa_worklist.empty()) {
+					auto [block, inst] = this->ssa_worklist.back();
+					this->ssa_worklist.pop_back();
+					if (!this->is_executable[block]) continue;
+					if (inst) {
+						this->visit_instruction(block, *inst);
+					} else {
+						this->visit_terminator(block);
+					}
+				}
+			}
+		}
+
+		// replaces the reads of constants and folds the branches on them
+		void rewrite() {
+			for (int i = 0; i < this->blocks.size(); ++i) {
+				if (!this->is_executable[i]) continue;
+				BasicBlock &block = *this->blocks[i];
+
+				if (TerminatorBranchTwo *branch = dynamic_cast<TerminatorBranchTwo *>(block.get_terminator().get())) {
+					LatticeValue condition = this->evaluate(branch->get_condition());
+					if (condition.level == LatticeLevel::constant) {
+						BasicBlock *taken = block.get_successors()[condition.value == 1 ? 0 : 1].first;
+						BasicBlock *not_taken = block.get_successors()[condition.value == 1 ? 1 : 0].first;
+						if (not_taken != taken) {
+							cfg::remove_phi_incoming(*not_taken, &block);
+						}
+						cfg::set_terminator(block, mkuptr<TerminatorBranchOne>(make_bound_ref(taken)));
+					}
+				}
+
+				Vec<Uptr<Expr> *> operands;
+				for (Uptr<Instruction> &inst : block.get_inst()) {
+					inst->collect_operands(operands);
+				}
+				block.get_terminator()->collect_operands(operands);
+				for (Uptr<Expr> *operand : operands) {
+					ItemRef<Variable> *ref = dynamic_cast<ItemRef<Variable> *>(operand->get());
+					if (!ref || !ref->get_referent()) continue;
+					LatticeValue value = this->get_value(*ref->get_referent());
+					if (value.level == LatticeLevel::constant) {
+						*operand = mkuptr<NumberLiteral>(value.value);
+					}
+				}
+			}
+		}
+	};
+
+	void propagate_constants(IRFunction &ir_function) {
+		if (ir_function.get_blocks().empty()) return;
+		ConstantPropagator propagator(ir_function.get_blocks());
+		propagator.run();
+		propagator.rewrite();
+		cfg::remove_unreachable_blocks(ir_function);
+	}
+
+	class ValueNumberer {
+		const Vec<Uptr<BasicBlock>> &blocks;
+		cfg::FlowGraph graph;
+		Vec<Vec<int>> dominator_tree_children;
+		Map<Variable *, Variable *> leaders; // variable -> the variable that first computed its value
+		Map<std::string, Variable *> available; // expression -> the variable holding it in the current dominator subtree
+
+		public:
+
+		int64_t num_removed;
+
+		ValueNumberer(const Vec<Uptr<BasicBlock>> &blocks) :
+			blocks { blocks },
+			graph { cfg::make_flow_graph(blocks) },
+			dominator_tree_children(blocks.size()),
+			num_removed { 0 }
+		{
+			Vec<int> idoms = cfg::find_immediate_dominators(this->graph.successors);
+			for (int block = 1; block < blocks.size(); ++block) {
+				if (idoms[block] != -1) {
+					this->dominator_tree_children[idoms[block]].push_back(block);
+				}
+			}
+		}
+
+		void replace_with_leaders(Vec<ItemRef<Variable> *> &refs) {
+			for (ItemRef<Variable> *ref : refs) {
+				if (!ref->get_referent()) continue;
+				auto leader_it = this->leaders.find(*ref->get_referent());
+				if (leader_it != this->leaders.end()) {
+					ref->bind(leader_it->second);
+				}
+			}
+		}
+
+		// A string that's the same for two expressions exactly when they
+		// compute the same value, or nothing if the expression isn't one
+		// we number. Operands must already have been replaced with leaders.
+		Opt<std::string> get_key(Instruction &inst) {
+			if (InstructionLength *length = dynamic_cast<InstructionLength *>(&inst)) {
+				Length &source = length->get_source();
+				std::string key = "length " + source.get_var().to_string();
+				if (Opt<int64_t> dim = source.get_dim()) {
+					key += " " + std::to_string(*dim);
+				}
+				return key;
+			}
+			InstructionAssignment *assignment = dynamic_cast<InstructionAssignment *>(&inst);
+			if (!assignment || !assignment->get_dest()) return {};
+			BinaryOperation *operation = dynamic_cast<BinaryOperation *>(&assignment->get_source());
+			if (!operation) return {};
+			Operator op = operation->get_op();
+			std::string lhs = operation->get_lhs().to_string();
+			std::string rhs = operation->get_rhs().to_string();
+			// write a > b as b < a, and put the operands of commutative operators in order
+			if (op == Operator::gt || op == Operator::ge) {
+				op = flip_operator(op).value();
+				std::swap(lhs, rhs);
+			} else if (flip_operator(op) == op && rhs < lhs) {
+				std::swap(lhs, rhs);
+			}
+			return lhs + " " + op_to_string(op) + " " + rhs;
+		}
+
+		void number(int block_index) {
+			BasicBlock &block = *this->blocks[block_index];
+			Vec<std::string> keys_added;
+			Vec<Uptr<Instruction>> &insts = block.get_inst();
+			Vec<Uptr<Instruction>> kept;
+			for (Uptr<Instruction> &inst : insts) {
+				// our predecessors already replaced what the phis read,
+				// except on back edges
+				if (!dynamic_cast<InstructionPhi *>(inst.get())) {
+					Vec<ItemRef<Variable> *> refs;
+					inst->collect_variable_refs(refs);
+					this->replace_with_leaders(refs);
+					if (Opt<std::string> key = this->get_key(*inst)) {
+						Variable *var = inst->get_variable_written().value();
+						auto [available_it, is_new] = this->available.insert({ *key, var });
+						if (is_new) {
+							keys_added.push_back(*key);
+						} else {
+							this->leaders.insert({ var, available_it->second });
+							this->num_removed += 1;
+							continue;
+						}
+					}
+				}
+				kept.push_back(mv(inst));
+			}
+			insts = mv(kept);
+			Vec<ItemRef<Variable> *> terminator_refs;
+			block.get_terminator()->collect_variable_refs(terminator_refs);
+			this->replace_with_leaders(terminator_refs);
+
+			for (int succ : this->graph.successors[block_index]) {
+				for (Uptr<Instruction> &inst : this->blocks[succ]->get_inst()) {
+					InstructionPhi *phi = dynamic_cast<InstructionPhi *>(inst.get());
+					if (!phi) break;
+					for (auto &[pred, value] : phi->get_incoming()) {
+						if (pred != &block) continue;
+						Vec<ItemRef<Variable> *> refs;
+						value->collect_variable_refs(refs);
+						this->replace_with_leaders(refs);
+					}
+				}
+			}
+
+			for (int child : this->dominator_tree_children[block_index]) {
+				this->number(child);
+			}
+			for (const std::string &key : keys_added) {
+				this->available.erase(key);
+			}
+		}
+	};
+
+	int64_t number_values(IRFunction &ir_function) {
+		if (ir_function.get_blocks().empty()) return 0;
+		ValueNumberer numberer(ir_function.get_blocks());
+		numberer.number(0);
+		return numberer.num_removed;
+	}
+
+	bool is_critical(Instruction &inst) {
+		if (dynamic_cast<InstructionStore *>(&inst)) {
+			return true;
+		}
+		if (InstructionAssignment *assignment = dynamic_cast<InstructionAssignment *>(&inst)) {
+			return !assignment->get_dest() || dynamic_cast<FunctionCall *>(&assignment->get_source());
+		}
+		if (InstructionInitializeArray *allocation = dynamic_cast<InstructionInitializeArray *>(&inst)) {
+			// unless its size is known to be fine, an allocation can stop the
+			// program with the runtime's error even if nothing reads it
+			return !allocation->get_constant_num_words();
+		}
+		return false;
+	}
+
+	void eliminate_dead_code(IRFunction &ir_function) {
+		const Vec<Uptr<BasicBlock>> &blocks = ir_function.get_blocks();
+		int num_blocks = blocks.size();
+		if (num_blocks == 0) return;
+		cfg::FlowGraph graph = cfg::make_flow_graph(blocks);
+
+		// Postdominators are dominators of the reverse CFG. Node 0 is a
+		// virtual exit that comes after every block without successors, and
+		// block i is node i + 1.
+		Vec<Vec<int>> reverse_successors(num_blocks + 1);
+		for (int i = 0; i < num_blocks; ++i) {
+			if (graph.successors[i].empty()) {
+				reverse_successors[0].push_back(i + 1);
+			}
+			for (int pred : graph.predecessors[i]) {
+				reverse_successors[i + 1].push_back(pred + 1);
+			}
+		}
+		Vec<int> ipdoms = cfg::find_immediate_dominators(reverse_successors);
+		bool all_reach_exit = std::all_of(ipdoms.begin(), ipdoms.end(), [](int ipdom) { return ipdom != -1; });
+
+		// a block is control dependent on the branches in its postdominance frontier
+		Vec<Set<int>> control_dependences(num_blocks);
+		if (all_reach_exit) {
+			for (int branch = 0; branch < num_blocks; ++branch) {
+				Set<int> succs(graph.successors[branch].begin(), graph.successors[branch].end());
+				if (succs.size() < 2) continue;
+				for (int succ : succs) {
+					int runner = succ + 1;
+					while (runner != ipdoms[branch + 1]) {
+						control_dependences[runner - 1].insert(branch);
+						runner = ipdoms[runner];
+					}
+				}
+			}
+		}
+
+		Map<Variable *, Pair<int, Instruction *>> definitions;
+		for (int i = 0; i < num_blocks; ++i) {
+			for (const Uptr<Instruction> &inst : blocks[i]->get_inst()) {
+				if (Opt<Variable *> var = inst->get_variable_written()) {
+					definitions.insert({ *var, { i, inst.get() } });
+				}
+			}
+		}
+
+		Set<Instruction *> live_insts;
+		Set<int> live_branches;
+		Vec<bool> is_useful(num_blocks, false);
+		Vec<Pair<int, Instruction *>> worklist; // (block, instruction) where nullptr is the block's terminator
+		auto mark_inst = [&](int block, Instruction *inst) {
+			if (live_insts.insert(inst).second) {
+				worklist.emplace_back(block, inst);
+			}
+		};
+		auto mark_branch = [&](int block) {
+			if (live_branches.insert(block).second) {
+				worklist.emplace_back(block, nullptr);
+			}
+		};
+		auto propagate = [&]() {
+			while (!worklist.empty()) {
+				auto [block, inst] = worklist.back();
+				worklist.pop_back();
+				if (!is_useful[block]) {
+					is_useful[block] = true;
+					for (int branch : control_dependences[block]) {
+						mark_branch(branch);
+					}
+				}
+				Vec<Variable *> vars_read;
+				if (inst) {
+					inst->collect_variables_read(vars_read);
+				} else {
+					blocks[block]->get_terminator()->collect_variables_read(vars_read);
+				}
+				for (Variable *var : vars_read) {
+					if (auto definition_it = definitions.find(var); definition_it != definitions.end()) {
+						mark_inst(definition_it->second.first, definition_it->second.second);
+					}
+				}
+				// the value of a phi depends on which edge we came from
+				if (InstructionPhi *phi = dynamic_cast<InstructionPhi *>(inst)) {
+					for (auto &[pred, value] : phi->get_incoming()) {
+						int pred_index = graph.block_index_map.at(pred);
+						if (graph.successors[pred_index].size() > 1) {
+							mark_branch(pred_index);
+						} else {
+							worklist.emplace_back(pred_index, nullptr);
+						}
+					}
+				}
+			}
+		};
+
+		for (int i = 0; i < num_blocks; ++i) {
+			for (const Uptr<Instruction> &inst : blocks[i]->get_inst()) {
+				if (is_critical(*inst)) {
+					mark_inst(i, inst.get());
+				}
+			}
+			Terminator *terminator = blocks[i]->get_terminator().get();
+			bool is_branch = dynamic_cast<TerminatorBranchTwo *>(terminator) != nullptr;
+			bool is_return = graph.successors[i].empty();
+			if (is_return || (is_branch && !all_reach_exit)) {
+				mark_branch(i);
+			}
+		}
+		propagate();
+
+		// A dead branch becomes a jump to its nearest useful postdominator.
+		// That block gets a new predecessor, so if it has a live phi, keep
+		// the branch instead.
+		auto has_live_phi = [&](int block) {
+			for (const Uptr<Instruction> &inst : blocks[block]->get_inst()) {
+				if (dynamic_cast<InstructionPhi *>(inst.get()) && live_insts.count(inst.get())) return true;
+			}
+			return false;
+		};
+		auto find_jump_target = [&](int block) {
+			int node = ipdoms[block + 1];
+			while (node != 0 && !is_useful[node - 1]) {
+				node = ipdoms[node];
+			}
+			return node - 1;
+		};
+		Map<int, int> jump_targets;
+		bool changed = true;
+		while (changed) {
+			changed = false;
+			jump_targets.clear();
+			for (int i = 0; i < num_blocks; ++i) {
+				if (live_branches.count(i) || !dynamic_cast<TerminatorBranchTwo *>(blocks[i]->get_terminator().get())) continue;
+				int target = find_jump_target(i);
+				if (target == -1 || has_live_phi(target)) {
+					mark_branch(i);
+					propagate();
+					changed = true;
+					break;
+				}
+				jump_targets.insert({ i, target });
+			}
+		}
+
+		for (int i = 0; i < num_blocks; ++i) {
+			BasicBlock &block = *blocks[i];
+			Vec<Uptr<Instruction>> &insts = block.get_inst();
+			insts.erase(
+				std::remove_if(
+					insts.begin(),
+					insts.end(),
+					[&](const Uptr<Instruction> &inst) {
+						return !live_insts.count(inst.get()) && !dynamic_cast<InstructionDeclaration *>(inst.get());
+					}
+				),
+				insts.end()
+			);
+		}
+		for (auto [i, target_index] : jump_targets) {
+			BasicBlock &block = *blocks[i];
+			BasicBlock *target = blocks[target_index].get();
+			for (auto [succ, probability] : block.get_successors()) {
+				if (succ != target) {
+					cfg::remove_phi_incoming(*succ, &block);
+				}
+			}
+			cfg::set_terminator(block, mkuptr<TerminatorBranchOne>(make_bound_ref(target)));
+		}
+		cfg::remove_unreachable_blocks(ir_function);
+	}
+
+	// declarations don't generate any code
+	bool is_empty_block(BasicBlock &block) {
+		const Vec<Uptr<Instruction>> &insts = block.get_inst();
+		return std::all_of(
+			insts.begin(),
+			insts.end(),
+			[](const Uptr<Instruction> &inst) { return dynamic_cast<InstructionDeclaration *>(inst.get()) != nullptr; }
+		);
+	}
+
+	// Where a jump to the block ends up once it goes past the empty blocks
+	// that just jump somewhere else. Stops at a loop of empty blocks, such
+	// as the self-jump the LA compiler puts at the end of blocks that
+	// don't return.
+	BasicBlock *skip_empty_jumps(BasicBlock *block) {
+		Set<BasicBlock *> seen;
+		while (is_empty_block(*block)
+			&& dynamic_cast<TerminatorBranchOne *>(block->get_terminator().get())
+			&& seen.insert(block).second)
+		{
+			block = block->get_successors()[0].first;
+		}
+		return block;
+	}
+
+	bool has_phi(BasicBlock &block) {
+		const Vec<Uptr<Instruction>> &insts = block.get_inst();
+		return !insts.empty() && dynamic_cast<InstructionPhi *>(insts.front().get());
+	}
+
+	Opt<Variable *> get_condition_var(TerminatorBranchTwo &branch) {
+		ItemRef<Variable> *ref = dynamic_cast<ItemRef<Variable> *>(&branch.get_condition());
+		if (!ref) return {};
+		return ref->get_referent();
+	}
+
+	// If the block only branches on the same variable as the branch that
+	// led to it, which way it goes is already known. Returns where it goes
+	// if so.
+	Opt<BasicBlock *> get_decided_target(TerminatorBranchTwo &branch, int succ_index, BasicBlock *succ) {
+		TerminatorBranchTwo *succ_branch = dynamic_cast<TerminatorBranchTwo *>(succ->get_terminator().get());
+		if (!succ_branch || !is_empty_block(*succ)) return {};
+		Opt<Variable *> var = get_condition_var(branch);
+		if (!var || get_condition_var(*succ_branch) != var) return {};
+		BasicBlock *target = succ->get_successors()[succ_index].first;
+		if (target == succ || has_phi(*target)) return {};
+		return target;
+	}
+
+	void simplify_cfg(IRFunction &ir_function) {
+		const Vec<Uptr<BasicBlock>> &blocks = ir_function.get_blocks();
+		bool changed = true;
+		while (changed && !blocks.empty()) {
+			changed = false;
+
+			for (const Uptr<BasicBlock> &block : blocks) {
+				if (TerminatorBranchTwo *branch = dynamic_cast<TerminatorBranchTwo *>(block->get_terminator().get())) {
+					BasicBlock *true_succ = block->get_successors()[0].first;
+					BasicBlock *false_succ = block->get_successors()[1].first;
+					NumberLiteral *num = dynamic_cast<NumberLiteral *>(&branch->get_condition());
+					if (num || true_succ == false_succ) {
+						// branches are taken when the condition is 1
+						BasicBlock *taken = !num || num->get_value() == 1 ? true_succ : false_succ;
+						cfg::set_terminator(*block, mkuptr<TerminatorBranchOne>(make_bound_ref(taken)));
+						changed = true;
+					} else {
+						for (int i = 0; i < 2; ++i) {
+							BasicBlock *succ = block->get_successors()[i].first;
+							if (Opt<BasicBlock *> target = get_decided_target(*branch, i, succ)) {
+								cfg::redirect_edge(*block, succ, *target);
+								changed = true;
+							}
+						}
+					}
+				}
+				for (auto [succ, probability] : Vec<Pair<BasicBlock *, double>>(block->get_successors())) {
+					BasicBlock *target = skip_empty_jumps(succ);
+					if (target != succ && !has_phi(*target)) {
+						cfg::redirect_edge(*block, succ, target);
+						changed = true;
+					}
+				}
+			}
+			cfg::remove_unreachable_blocks(ir_function);
+
+			// merge straight-line chains of blocks
+			cfg::FlowGraph graph = cfg::make_flow_graph(blocks);
+			Set<BasicBlock *> merged_blocks;
+			for (const Uptr<BasicBlock> &block : blocks) {
+				if (merged_blocks.count(block.get())) continue;
+				while (dynamic_cast<TerminatorBranchOne *>(block->get_terminator().get())) {
+					BasicBlock *succ = block->get_successors()[0].first;
+					int succ_index = graph.block_index_map.at(succ);
+					if (succ == block.get() || succ_index == 0 || graph.predecessors[succ_index].size() != 1 || has_phi(*succ)) break;
+					Vec<Uptr<Instruction>> &insts = block->get_inst();
+					for (Uptr<Instruction> &inst : succ->get_inst()) {
+						insts.push_back(mv(inst));
+					}
+					block->get_terminator() = mv(succ->get_terminator());
+					block->set_successors(succ->get_successors());
+					merged_blocks.insert(succ);
+					changed = true;
+				}
+			}
+			ir_function.remove_blocks(merged_blocks);
+		}
+	}
+
+	void optimize_program(Program &program, bool verbose) {
+		int64_t num_values_removed = 0;
+		for (Uptr<IRFunction> &ir_function : program.get_ir_functions()) {
+			ssa::SsaForm ssa_form = ssa::construct_ssa(*ir_function);
+			propagate_constants(*ir_function);
+			num_values_removed += number_values(*ir_function);
+			eliminate_dead_code(*ir_function);
+			ssa::destruct_ssa(*ir_function, ssa_form);
+		}
+		if (verbose) {
+			std::cerr << "value numbering removed " << num_values_removed << " redundant instructions\n";
+		}
+	}
+}
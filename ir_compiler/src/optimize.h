@@ -0,0 +1,43 @@
+#pragma once
+#include "std_alias.h"
+#include "program.h"
+#include "cfg.h"
+#include "ssa.h"
+
+// The IR compiler's optimizing middle end. The passes here run on functions
+// in SSA form (see ssa.h).
+namespace IR::optimize {
+	using namespace std_alias;
+	using namespace IR::program;
+
+	// Wegman & Zadeck's sparse conditional constant propagation. Replaces
+	// reads of variables that are constant on every executable path with
+	// the constant, turns branches on constants into jumps, and deletes the
+	// blocks that can never run.
+	void propagate_constants(IRFunction &ir_function);
+
+	// Dominator-based value numbering (Briggs, Cooper & Simpson). An
+	// operation or array length that a dominating instruction has already
+	// computed is deleted, and its reads use the earlier result instead.
+	// Array lengths never change, so a length is redundant wherever the
+	// same array's length was taken before. Returns the number of
+	// instructions deleted.
+	int64_t number_values(IRFunction &ir_function);
+
+	// Aggressive dead code elimination (Cytron et al.). Only stores, calls,
+	// and returns are assumed to be useful at first; everything they don't
+	// depend on through data or control dependences is deleted, including
+	// branches, which become jumps to their nearest useful postdominator.
+	void eliminate_dead_code(IRFunction &ir_function);
+
+	// Cleans up the control flow graph outside of SSA form: folds branches
+	// on constants, points jumps past blocks that do nothing but jump, and
+	// past blocks that branch on a condition the jump already decided,
+	// deletes the blocks that become unreachable, and merges a block into
+	// its predecessor when that predecessor is the only way in.
+	void simplify_cfg(IRFunction &ir_function);
+
+	// puts every function in SSA form, runs the passes, and takes the
+	// functions back out of SSA form. Prints what the passes did if verbose.
+	void optimize_program(Program &program, bool verbose);
+}
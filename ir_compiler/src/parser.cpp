@@ -317,6 +317,36 @@ namespace IR::parser {
 			>
 		{};
 
+		// `new frame Array(...)` and `new frame Tuple(...)`: see
+		// InstructionInitializeArray
+		struct InstructionFrameArrayDeclarationRule :
+			interleaved<
+				SpacesRule,
+				VariableRule,
+				ArrowRule,
+				TAO_PEGTL_STRING("new"),
+				TAO_PEGTL_STRING("frame"),
+				TAO_PEGTL_STRING("Array"),
+				one<'('>,
+				ArgsRule,
+				one<')'>
+			>
+		{};
+
+		struct InstructionFrameTupleDeclarationRule :
+			interleaved<
+				SpacesRule,
+				VariableRule,
+				ArrowRule,
+				TAO_PEGTL_STRING("new"),
+				TAO_PEGTL_STRING("frame"),
+				TAO_PEGTL_STRING("Tuple"),
+				one<'('>,
+				InexplicableTRule,
+				one<')'>
+			>
+		{};
+
 		struct InstructionRule : 
 			sor<
 				InstructionTypeDeclaratioRule,
@@ -329,6 +359,8 @@ namespace IR::parser {
 				InstructionLengthTupleRule,
 				InstructionArrayDeclarationRule,
 				InstructionTupleDeclarationRule,
+				InstructionFrameArrayDeclarationRule,
+				InstructionFrameTupleDeclarationRule,
 				InstructionPureAssignmentRule
 			>
 		{};
@@ -469,6 +501,8 @@ namespace IR::parser {
 				InstructionLengthTupleRule,
 				InstructionArrayDeclarationRule,
 				InstructionTupleDeclarationRule,
+				InstructionFrameArrayDeclarationRule,
+				InstructionFrameTupleDeclarationRule,
 				InstructionPureAssignmentRule,
 				InstructionsRule,
 				TerminatorRule,
@@ -699,28 +733,33 @@ namespace IR::parser {
 			);
 		}
 		Uptr<Instruction> convert_instruction_array_declaration(const ParseNode &n) {
-			assert(*n.rule == typeid(rules::InstructionArrayDeclarationRule));
+			assert(*n.rule == typeid(rules::InstructionArrayDeclarationRule)
+				|| *n.rule == typeid(rules::InstructionFrameArrayDeclarationRule));
 			return mkuptr<InstructionInitializeArray>(
 				convert_variable_ref(n[0]),
 				mkuptr<ArrayDeclaration>(
 					convert_args(n[1])
-				)
+				),
+				*n.rule == typeid(rules::InstructionFrameArrayDeclarationRule)
 			);
 		}
 		Uptr<Instruction> convert_instruction_tuple_declaration(const ParseNode &n) {
-			assert(*n.rule == typeid(rules::InstructionTupleDeclarationRule));
+			assert(*n.rule == typeid(rules::InstructionTupleDeclarationRule)
+				|| *n.rule == typeid(rules::InstructionFrameTupleDeclarationRule));
 			Vec<Uptr<Expr>> sol;
 			sol.push_back(mv(convert_expr(n[1])));
 			return mkuptr<InstructionInitializeArray>(
 				convert_variable_ref(n[0]),
 				mkuptr<ArrayDeclaration>(
 					mv(sol)
-				)
+				),
+				*n.rule == typeid(rules::InstructionFrameTupleDeclarationRule)
 			);
 		}
 		Uptr<Instruction> convert_instruction(const ParseNode &n){
 			const std::type_info &rule = *n.rule;
-			if (rule == typeid(rules::InstructionArrayDeclarationRule)) {
+			if (rule == typeid(rules::InstructionArrayDeclarationRule)
+				|| rule == typeid(rules::InstructionFrameArrayDeclarationRule)) {
 				return convert_instruction_array_declaration(n);
 			} else if (rule == typeid(rules::InstructionArrayLoadRule)) {
 				return convert_instruction_array_load(n);
@@ -740,7 +779,8 @@ namespace IR::parser {
 				return convert_instruction_pure_assignment(n);
 			} else if (rule == typeid(rules::InstructionTypeDeclaratioRule)) {
 				return convert_instruction_var_declaration(n);
-			} else if (rule == typeid(rules::InstructionTupleDeclarationRule)) {
+			} else if (rule == typeid(rules::InstructionTupleDeclarationRule)
+				|| rule == typeid(rules::InstructionFrameTupleDeclarationRule)) {
 				return convert_instruction_tuple_declaration(n);
 			} else{
 				std::cerr << "unknown instruction: " << std::string(n.string_view()) << std::endl;
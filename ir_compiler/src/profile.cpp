@@ -0,0 +1,190 @@
+#include "profile.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+namespace IR::profile {
+	using namespace std_alias;
+	using namespace IR::program;
+
+	Profile Profile::read(const std::string &file_name) {
+		std::ifstream in(file_name);
+		if (!in) {
+			std::cerr << "Error: can't open profile " << file_name << "\n";
+			exit(1);
+		}
+
+		Profile profile;
+		std::string line;
+		while (std::getline(in, line)) {
+			Vec<std::string> tokens;
+			std::istringstream line_stream(line);
+			for (std::string token; line_stream >> token;) {
+				tokens.push_back(mv(token));
+			}
+
+			// only "@function :block count" lines say anything about branches;
+			// skip function lines and lines the runtime couldn't name
+			if (tokens.size() != 3 || tokens[0][0] != '@' || tokens[1][0] != ':') {
+				continue;
+			}
+			profile.block_counts[tokens[0].substr(1)][tokens[1].substr(1)] = std::stoll(tokens[2]);
+		}
+		return profile;
+	}
+
+	Opt<int64_t> Profile::get_block_count(const std::string &function_name, const std::string &block_name) const {
+		auto function_it = this->block_counts.find(function_name);
+		if (function_it == this->block_counts.end()) {
+			return {};
+		}
+		auto block_it = function_it->second.find(block_name);
+		if (block_it == function_it->second.end()) {
+			return {};
+		}
+		return block_it->second;
+	}
+
+	// The profile only counts blocks, so the number of times an edge was taken
+	// is derived from the counts: if the edge is the only way into its target,
+	// it was taken exactly as often as the target ran, and the other edge out
+	// of the branch got the rest. Otherwise we split the source's count in
+	// proportion to how often the targets ran.
+	Vec<double> estimate_edge_counts(
+		BasicBlock *block,
+		const Map<BasicBlock *, int> &num_predecessors
+	) {
+		Vec<Pair<BasicBlock *, double>> &successors = block->get_successors();
+		double block_count = block->get_execution_count().value();
+		Vec<double> edge_counts;
+		if (successors.size() != 2 || successors[0].first == successors[1].first) {
+			for (auto &[succ, probability] : successors) {
+				edge_counts.push_back(block_count * probability);
+			}
+			return edge_counts;
+		}
+
+		BasicBlock *a = successors[0].first;
+		BasicBlock *b = successors[1].first;
+		double a_count = a->get_execution_count().value();
+		double b_count = b->get_execution_count().value();
+		if (num_predecessors.at(a) == 1) {
+			a_count = std::min(a_count, block_count);
+			return { a_count, block_count - a_count };
+		} else if (num_predecessors.at(b) == 1) {
+			b_count = std::min(b_count, block_count);
+			return { block_count - b_count, b_count };
+		} else if (a_count + b_count > 0) {
+			return {
+				block_count * a_count / (a_count + b_count),
+				block_count * b_count / (a_count + b_count)
+			};
+		} else {
+			return { block_count * successors[0].second, block_count * successors[1].second };
+		}
+	}
+
+	void apply_profile(Program &program, const Profile &profile) {
+		for (const Uptr<IRFunction> &function : program.get_ir_functions()) {
+			const Vec<Uptr<BasicBlock>> &blocks = function->get_blocks();
+
+			// the profile has to cover the whole function, or it's from a
+			// different version of the program
+			Vec<int64_t> counts;
+			for (const Uptr<BasicBlock> &block : blocks) {
+				Opt<int64_t> count = profile.get_block_count(function->get_name(), block->get_name());
+				if (!count) {
+					break;
+				}
+				counts.push_back(*count);
+			}
+			if (counts.size() != blocks.size()) {
+				std::cerr << "Warning: the profile doesn't match @" << function->get_name() << "; ignoring it there\n";
+				continue;
+			}
+			for (int i = 0; i < blocks.size(); ++i) {
+				blocks[i]->set_execution_count(counts[i]);
+			}
+
+			Map<BasicBlock *, int> num_predecessors;
+			num_predecessors[blocks[0].get()] = 1; // the function's caller
+			for (const Uptr<BasicBlock> &block : blocks) {
+				num_predecessors[block.get()];
+				for (auto &[succ, probability] : block->get_successors()) {
+					num_predecessors[succ] += 1;
+				}
+			}
+
+			for (const Uptr<BasicBlock> &block : blocks) {
+				if (block->get_execution_count().value() == 0) {
+					// nothing was measured, so keep the guesses
+					continue;
+				}
+				Vec<double> edge_counts = estimate_edge_counts(block.get(), num_predecessors);
+				Vec<Pair<BasicBlock *, double>> &successors = block->get_successors();
+				double total = 0.0;
+				for (double edge_count : edge_counts) {
+					total += edge_count;
+				}
+				if (total <= 0.0) {
+					continue;
+				}
+				for (int i = 0; i < successors.size(); ++i) {
+					successors[i].second = edge_counts[i] / total;
+				}
+			}
+		}
+	}
+
+	CounterTable::CounterTable(Program &program) {
+		for (const Uptr<IRFunction> &function : program.get_ir_functions()) {
+			std::string function_name = "@" + function->get_name();
+			this->function_counters[function.get()] = this->counter_names.size();
+			this->counter_names.push_back(function_name);
+			for (const Uptr<BasicBlock> &block : function->get_blocks()) {
+				this->block_counters[block.get()] = this->counter_names.size();
+				this->counter_names.push_back(function_name + " :" + block->get_name());
+			}
+		}
+		if (this->counter_names.size() > MAX_COUNTERS - 1) {
+			std::cerr << "Error: the program has too many functions and blocks to instrument\n";
+			exit(1);
+		}
+	}
+
+	std::string generate_increment(int64_t counter_index, const std::string &prefix) {
+		std::string counter = "%" + prefix + "counter";
+		std::string count = "%" + prefix + "count";
+		int64_t address = COUNTER_TABLE_ADDRESS + 8 * (counter_index + 1);
+		std::string sol = "\t" + counter + " <- " + std::to_string(address) + "\n";
+		sol += "\t" + count + " <- load " + counter + "\n";
+		sol += "\t" + count + " <- " + count + " + 1\n";
+		sol += "\tstore " + counter + " <- " + count + "\n";
+		return sol;
+	}
+
+	std::string CounterTable::get_increment(const IRFunction &function, const std::string &prefix) const {
+		return generate_increment(this->function_counters.at(&function), prefix);
+	}
+
+	std::string CounterTable::get_increment(const BasicBlock &block, const std::string &prefix) const {
+		return generate_increment(this->block_counters.at(&block), prefix);
+	}
+
+	std::string CounterTable::get_count_store(const std::string &prefix) const {
+		std::string table = "%" + prefix + "table";
+		std::string sol = "\t" + table + " <- " + std::to_string(COUNTER_TABLE_ADDRESS) + "\n";
+		sol += "\tstore " + table + " <- " + std::to_string(this->counter_names.size()) + "\n";
+		return sol;
+	}
+
+	void CounterTable::write_counter_names(const std::string &file_name) const {
+		std::ofstream o;
+		o.open(file_name);
+		for (const std::string &name : this->counter_names) {
+			o << name << "\n";
+		}
+		o.close();
+	}
+}
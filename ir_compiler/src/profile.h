@@ -0,0 +1,70 @@
+#pragma once
+#include "std_alias.h"
+#include "program.h"
+#include <string>
+
+// Execution-count profiling (IRc -finstrument).
+//
+// An instrumented program bumps one 8-byte counter per function call and one
+// per basic block execution. The counters live in a table that the runtime
+// (lib/runtime.c) maps at COUNTER_TABLE_ADDRESS before the program starts.
+// The table's first word holds the number of counters, which @main stores
+// when it starts, so that the runtime can tell an instrumented program
+// without looking through the table; counter i is the word after it.
+//
+// At compile time IRc writes COUNTER_NAMES_FILE, which holds the name of
+// counter i on line i:
+//     @function             (the function's prologue)
+//     @function :block      (a basic block, using its name from the IR source)
+//
+// At exit the runtime writes PROFILE_FILE with the same lines, each followed
+// by a space and the counter's value:
+//     @main 1
+//     @main :entry 1
+//     @main :loop 1000
+namespace IR::profile {
+	using namespace std_alias;
+	using namespace IR::program;
+
+	const int64_t COUNTER_TABLE_ADDRESS = 0x300000;
+	const int64_t MAX_COUNTERS = 1 << 17;
+	const std::string COUNTER_NAMES_FILE = "prog.counters";
+	const std::string PROFILE_FILE = "prog.profile";
+
+	// the execution counts from a PROFILE_FILE
+	class Profile {
+		Map<std::string, Map<std::string, int64_t>> block_counts; // function name -> block name -> count
+
+		public:
+
+		static Profile read(const std::string &file_name);
+
+		Opt<int64_t> get_block_count(const std::string &function_name, const std::string &block_name) const;
+	};
+
+	// Records each block's measured execution count and replaces the guessed
+	// branch probabilities with measured ones. Must be called before the block
+	// names are mangled.
+	void apply_profile(Program &program, const Profile &profile);
+
+	class CounterTable {
+		Vec<std::string> counter_names;
+		Map<const IRFunction *, int64_t> function_counters;
+		Map<const BasicBlock *, int64_t> block_counters;
+
+		public:
+
+		// assigns a counter to every function and block; must be called
+		// before the block names are mangled
+		explicit CounterTable(Program &program);
+
+		// the L3 instructions that bump the function's or block's counter
+		std::string get_increment(const IRFunction &function, const std::string &prefix) const;
+		std::string get_increment(const BasicBlock &block, const std::string &prefix) const;
+		// the L3 instructions that store the number of counters in the
+		// table's first word
+		std::string get_count_store(const std::string &prefix) const;
+
+		void write_counter_names(const std::string &file_name) const;
+	};
+}
@@ -16,6 +16,156 @@ namespace IR::program {
 		return "%" + prefix + std::to_string(counter);
 	}
 
+	// Where the runtime (lib/runtime.c) keeps the allocation state: the current
+	// heap pointer at HEAP_STATE_ADDRESS and the end of the current arena chunk
+	// right after it. The page is mapped at this fixed address before the
+	// program starts, so generated code can reach it without a call.
+	const int64_t HEAP_STATE_ADDRESS = 0x200000;
+
+	// Allocates a heap object with `num_elements` (a decoded variable) elements
+	// all set to encoded 0, and stores a pointer to it in `dest`. The object is
+	// bumped out of the runtime's current arena chunk inline, and we only call
+	// the runtime's allocate when the chunk doesn't have enough room.
+	std::string generate_allocation(const std::string &dest, const std::string &num_elements, const std::string &encoded_num_elements, std::string &prefix, int &counter) {
+		static int num_allocations = 0; // used to make the labels unique
+		std::string suffix = std::to_string(num_allocations);
+		num_allocations += 1;
+		std::string fast_label = ":allocfast" + suffix;
+		std::string fill_label = ":allocfill" + suffix;
+		std::string done_label = ":allocdone" + suffix;
+
+		std::string state = make_new_var_name(prefix, counter++);
+		std::string heap_pointer = make_new_var_name(prefix, counter++);
+		std::string new_heap_pointer = make_new_var_name(prefix, counter++);
+		std::string heap_limit = make_new_var_name(prefix, counter++);
+		std::string condition = make_new_var_name(prefix, counter++);
+		std::string cursor = make_new_var_name(prefix, counter++);
+		std::string room = make_new_var_name(prefix, counter++);
+		std::string is_not_negative = make_new_var_name(prefix, counter++);
+
+		// The object fits when 0 <= num_elements < room, where room is the
+		// number of words left in the chunk. Comparing element counts
+		// rather than end pointers keeps huge lengths from wrapping around,
+		// and negative lengths go to allocate so that it reports them.
+		std::string sol = "\t" + state + " <- " + std::to_string(HEAP_STATE_ADDRESS) + "\n";
+		sol += "\t" + heap_pointer + " <- load " + state + "\n";
+		sol += "\t" + state + " <- " + state + " + 8\n";
+		sol += "\t" + heap_limit + " <- load " + state + "\n";
+		sol += "\t" + room + " <- " + heap_limit + " - " + heap_pointer + "\n";
+		sol += "\t" + room + " <- " + room + " >> 3\n";
+		sol += "\t" + condition + " <- " + num_elements + " < " + room + "\n";
+		sol += "\t" + is_not_negative + " <- 0 <= " + num_elements + "\n";
+		sol += "\t" + condition + " <- " + condition + " & " + is_not_negative + "\n";
+		sol += "\tbr " + condition + " " + fast_label + "\n";
+
+		// slow path: the runtime maps a new chunk, or reports a negative
+		// length
+		sol += "\t" + dest + " <- call allocate(" + encoded_num_elements + ", 1)\n";
+		sol += "\tbr " + done_label + "\n";
+
+		// fast path: bump the heap pointer, write the header, and fill
+		sol += "\t" + fast_label + "\n";
+		sol += "\t" + new_heap_pointer + " <- " + num_elements + " << 3\n";
+		sol += "\t" + new_heap_pointer + " <- " + new_heap_pointer + " + 8\n";
+		sol += "\t" + new_heap_pointer + " <- " + heap_pointer + " + " + new_heap_pointer + "\n";
+		sol += "\t" + state + " <- " + std::to_string(HEAP_STATE_ADDRESS) + "\n";
+		sol += "\tstore " + state + " <- " + new_heap_pointer + "\n";
+		sol += "\tstore " + heap_pointer + " <- " + num_elements + "\n";
+		sol += "\t" + dest + " <- " + heap_pointer + "\n";
+		sol += "\t" + cursor + " <- " + heap_pointer + " + 8\n";
+		sol += "\t" + fill_label + "\n";
+		sol += "\t" + condition + " <- " + cursor + " >= " + new_heap_pointer + "\n";
+		sol += "\tbr " + condition + " " + done_label + "\n";
+		sol += "\tstore " + cursor + " <- 1\n";
+		sol += "\t" + cursor + " <- " + cursor + " + 8\n";
+		sol += "\tbr " + fill_label + "\n";
+
+		sol += "\t" + done_label + "\n";
+		return sol;
+	}
+
+	// The runtime also keeps a stack for the objects that functions put in
+	// their frames: the pointer to its top right after the heap state, and
+	// the end of the stack after that.
+	const int64_t FRAME_STACK_STATE_ADDRESS = HEAP_STATE_ADDRESS + 16;
+
+	std::string generate_frame_entry(const std::string &frame_base, const std::string &saved_pointer, int64_t frame_size, const std::string &prefix) {
+		static int num_frames = 0; // used to make the labels unique
+		std::string suffix = std::to_string(num_frames);
+		num_frames += 1;
+		std::string fast_label = ":framefast" + suffix;
+		std::string done_label = ":framedone" + suffix;
+
+		int counter = 0;
+		std::string state = make_new_var_name(prefix, counter++);
+		std::string new_pointer = make_new_var_name(prefix, counter++);
+		std::string limit = make_new_var_name(prefix, counter++);
+		std::string condition = make_new_var_name(prefix, counter++);
+
+		std::string sol = "\t" + state + " <- " + std::to_string(FRAME_STACK_STATE_ADDRESS) + "\n";
+		sol += "\t" + saved_pointer + " <- load " + state + "\n";
+		sol += "\t" + new_pointer + " <- " + saved_pointer + " + " + std::to_string(frame_size) + "\n";
+		sol += "\t" + state + " <- " + state + " + 8\n";
+		sol += "\t" + limit + " <- load " + state + "\n";
+		sol += "\t" + condition + " <- " + new_pointer + " <= " + limit + "\n";
+		sol += "\tbr " + condition + " " + fast_label + "\n";
+
+		// slow path: the frame stack is full (deep recursion), so the frame
+		// comes from the heap instead and the stack pointer stays put. The
+		// frame overwrites the header of the object allocate makes.
+		int64_t encoded_length = ((frame_size / 8 - 1) << 1) + 1;
+		sol += "\t" + frame_base + " <- call allocate(" + std::to_string(encoded_length) + ", 1)\n";
+		sol += "\tbr " + done_label + "\n";
+
+		sol += "\t" + fast_label + "\n";
+		sol += "\t" + state + " <- " + std::to_string(FRAME_STACK_STATE_ADDRESS) + "\n";
+		sol += "\tstore " + state + " <- " + new_pointer + "\n";
+		sol += "\t" + frame_base + " <- " + saved_pointer + "\n";
+		sol += "\t" + done_label + "\n";
+		return sol;
+	}
+
+	std::string generate_frame_exit(const std::string &saved_pointer, const std::string &prefix) {
+		std::string state = make_new_var_name(prefix, 0);
+		std::string sol = "\t" + state + " <- " + std::to_string(FRAME_STACK_STATE_ADDRESS) + "\n";
+		sol += "\tstore " + state + " <- " + saved_pointer + "\n";
+		return sol;
+	}
+
+	// Like generate_allocation, but the object goes in the slot at `offset`
+	// bytes into the function's frame, and `num_elements` is a constant.
+	// Small objects are filled without a loop.
+	std::string generate_frame_allocation(const std::string &dest, const std::string &frame_base, int64_t offset, int64_t num_elements, std::string &prefix, int &counter) {
+		std::string cursor = make_new_var_name(prefix, counter++);
+		std::string sol = "\t" + dest + " <- " + frame_base + " + " + std::to_string(offset) + "\n";
+		sol += "\tstore " + dest + " <- " + std::to_string(num_elements) + "\n";
+		if (num_elements <= 16) {
+			for (int64_t i = 1; i <= num_elements; ++i) {
+				sol += "\t" + cursor + " <- " + dest + " + " + std::to_string(i * 8) + "\n";
+				sol += "\tstore " + cursor + " <- 1\n";
+			}
+			return sol;
+		}
+
+		static int num_fills = 0; // used to make the labels unique
+		std::string suffix = std::to_string(num_fills);
+		num_fills += 1;
+		std::string fill_label = ":framefill" + suffix;
+		std::string done_label = ":framefilldone" + suffix;
+		std::string end = make_new_var_name(prefix, counter++);
+		std::string condition = make_new_var_name(prefix, counter++);
+		sol += "\t" + cursor + " <- " + dest + " + 8\n";
+		sol += "\t" + end + " <- " + dest + " + " + std::to_string((num_elements + 1) * 8) + "\n";
+		sol += "\t" + fill_label + "\n";
+		sol += "\t" + condition + " <- " + cursor + " >= " + end + "\n";
+		sol += "\tbr " + condition + " " + done_label + "\n";
+		sol += "\tstore " + cursor + " <- 1\n";
+		sol += "\t" + cursor + " <- " + cursor + " + 8\n";
+		sol += "\tbr " + fill_label + "\n";
+		sol += "\t" + done_label + "\n";
+		return sol;
+	}
+
 	std::pair<A_type, int64_t> str_to_a_type(const std::string& str) {
 		static const std::map<std::string, A_type> stringToTypeMap = {
 			{"int64", A_type::int64},
@@ -118,6 +268,20 @@ namespace IR::program {
 		}
 	}
 	
+	// the comparison that's true exactly when the given one is false
+	Opt<Operator> invert_comparison(Operator op) {
+		switch (op) {
+			case Operator::lt: return Operator::ge;
+			case Operator::le: return Operator::gt;
+			case Operator::gt: return Operator::le;
+			case Operator::ge: return Operator::lt;
+
+			// = has no inverse among the operators, and the rest aren't
+			// comparisons
+			default: return {};
+		}
+	}
+
 	template<> std::string ItemRef<Variable>::to_string() const {
 		std::string result = "%" + this->get_ref_name();
 		if (!this->referent_nullable) {
@@ -131,6 +295,14 @@ namespace IR::program {
 	template<> std::string ItemRef<Variable>::to_l3_expr(std::string prefix) {
 		return "%" + this->get_ref_name();
 	}
+	template<> void ItemRef<Variable>::collect_variables_read(Vec<Variable *> &result) const {
+		if (this->referent_nullable) {
+			result.push_back(this->referent_nullable);
+		}
+	}
+	template<> void ItemRef<Variable>::collect_variable_refs(Vec<ItemRef<Variable> *> &result) {
+		result.push_back(this);
+	}
 	template<> std::string ItemRef<BasicBlock>::to_string() const {
 		std::string result = ":" + this->get_ref_name();
 		if (!this->referent_nullable) {
@@ -144,6 +316,8 @@ namespace IR::program {
 	template<>std::string ItemRef<BasicBlock>::to_l3_expr(std::string prefix) {
 		return ":" + this->get_ref_name();
 	}
+	template<> void ItemRef<BasicBlock>::collect_variables_read(Vec<Variable *> &result) const {}
+	template<> void ItemRef<BasicBlock>::collect_variable_refs(Vec<ItemRef<Variable> *> &result) {}
 	template<> std::string ItemRef<IRFunction>::to_string() const {
 		std::string result = "@" + this->get_ref_name();
 		if (!this->referent_nullable) {
@@ -157,6 +331,8 @@ namespace IR::program {
 	template<> std::string ItemRef<IRFunction>::to_l3_expr(std::string prefix) {
 		return "@" + this->get_ref_name();
 	}
+	template<> void ItemRef<IRFunction>::collect_variables_read(Vec<Variable *> &result) const {}
+	template<> void ItemRef<IRFunction>::collect_variable_refs(Vec<ItemRef<Variable> *> &result) {}
 	template<> std::string ItemRef<ExternalFunction>::to_string() const {
 		std::string result = this->get_ref_name();
 		if (!this->referent_nullable) {
@@ -170,6 +346,8 @@ namespace IR::program {
 	template<> std::string ItemRef<ExternalFunction>::to_l3_expr(std::string prefix) {
 		return this->get_ref_name();
 	}
+	template<> void ItemRef<ExternalFunction>::collect_variables_read(Vec<Variable *> &result) const {}
+	template<> void ItemRef<ExternalFunction>::collect_variable_refs(Vec<ItemRef<Variable> *> &result) {}
 
 	std::string Variable::to_string() const {
 		return "%" + this->get_name();
@@ -180,6 +358,23 @@ namespace IR::program {
 			+ " " + program::op_to_string(this->op)
 			+ " " + this->rhs->to_string();
 	}
+	void BinaryOperation::collect_variables_read(Vec<Variable *> &result) const {
+		this->lhs->collect_variables_read(result);
+		this->rhs->collect_variables_read(result);
+	}
+	void BinaryOperation::collect_variable_refs(Vec<ItemRef<Variable> *> &result) {
+		this->lhs->collect_variable_refs(result);
+		this->rhs->collect_variable_refs(result);
+	}
+	void BinaryOperation::collect_operands(Vec<Uptr<Expr> *> &result) {
+		result.push_back(&this->lhs);
+		this->lhs->collect_operands(result);
+		result.push_back(&this->rhs);
+		this->rhs->collect_operands(result);
+	}
+	Uptr<Expr> BinaryOperation::clone() const {
+		return mkuptr<BinaryOperation>(this->lhs->clone(), this->rhs->clone(), this->op);
+	}
 	void BinaryOperation::bind_to_scope(AggregateScope &agg_scope) {
 		this->lhs->bind_to_scope(agg_scope);
 		this->rhs->bind_to_scope(agg_scope);
@@ -198,6 +393,33 @@ namespace IR::program {
 		result += ")";
 		return result;
 	}
+	void FunctionCall::collect_variables_read(Vec<Variable *> &result) const {
+		this->callee->collect_variables_read(result);
+		for (const Uptr<Expr> &arg : this->arguments) {
+			arg->collect_variables_read(result);
+		}
+	}
+	void FunctionCall::collect_variable_refs(Vec<ItemRef<Variable> *> &result) {
+		this->callee->collect_variable_refs(result);
+		for (Uptr<Expr> &arg : this->arguments) {
+			arg->collect_variable_refs(result);
+		}
+	}
+	void FunctionCall::collect_operands(Vec<Uptr<Expr> *> &result) {
+		result.push_back(&this->callee);
+		this->callee->collect_operands(result);
+		for (Uptr<Expr> &arg : this->arguments) {
+			result.push_back(&arg);
+			arg->collect_operands(result);
+		}
+	}
+	Uptr<Expr> FunctionCall::clone() const {
+		Vec<Uptr<Expr>> arguments;
+		for (const Uptr<Expr> &arg : this->arguments) {
+			arguments.push_back(arg->clone());
+		}
+		return mkuptr<FunctionCall>(this->callee->clone(), mv(arguments));
+	}
 	void FunctionCall::bind_to_scope(AggregateScope &agg_scope) {
 		this->callee->bind_to_scope(agg_scope);
 		for (Uptr<Expr> &arg : this->arguments) {
@@ -227,6 +449,38 @@ namespace IR::program {
 		}
 		return sol;
 	}
+	void MemoryLocation::collect_variables_read(Vec<Variable *> &result) const {
+		this->base->collect_variables_read(result);
+		for (const auto &expr : this->dimensions) {
+			expr->collect_variables_read(result);
+		}
+		if (this->hoisted_address) {
+			result.push_back(*this->hoisted_address);
+		}
+		result.insert(result.end(), this->hoisted_strides.begin(), this->hoisted_strides.end());
+	}
+	void MemoryLocation::collect_variable_refs(Vec<ItemRef<Variable> *> &result) {
+		this->base->collect_variable_refs(result);
+		for (Uptr<Expr> &expr : this->dimensions) {
+			expr->collect_variable_refs(result);
+		}
+	}
+	void MemoryLocation::collect_operands(Vec<Uptr<Expr> *> &result) {
+		for (Uptr<Expr> &expr : this->dimensions) {
+			result.push_back(&expr);
+			expr->collect_operands(result);
+		}
+	}
+	Uptr<MemoryLocation> MemoryLocation::clone() const {
+		Vec<Uptr<Expr>> dimensions;
+		for (const Uptr<Expr> &expr : this->dimensions) {
+			dimensions.push_back(expr->clone());
+		}
+		Uptr<MemoryLocation> result = mkuptr<MemoryLocation>(this->base->clone_ref(), mv(dimensions));
+		result->hoisted_address = this->hoisted_address;
+		result->hoisted_strides = this->hoisted_strides;
+		return result;
+	}
 	void MemoryLocation::bind_to_scope(AggregateScope &agg_scope) {
 		this->base->bind_to_scope(agg_scope);
 		for (const auto &expr : this->dimensions) {
@@ -235,6 +489,9 @@ namespace IR::program {
 	}
 	std::string MemoryLocation::to_l3(std::string prefix) {
 		int n = this->dimensions.size();
+		if (this->hoisted_address) {
+			return "\t%" + prefix + "sol <- " + (*this->hoisted_address)->to_l3() + "\n";
+		}
 		if (this->base->get_referent().value()->get_type().get_a_type() == A_type::tuple) {
 			std::string dimension = this->dimensions[0]->to_l3_expr(prefix);
 			std::string sol = "\t%" + prefix + "sol <- 1 + " + dimension + "\n"; 
@@ -245,26 +502,27 @@ namespace IR::program {
 		std::string base = this->base->to_l3_expr(prefix);
 		std::string sol = "";
 		int counter = 0;
-		for (int i = 0; i < n; i ++) {
-			std::string new_var = make_new_var_name(prefix, counter);
-			sol += "\t" + new_var + " <- " + std::to_string((i + 1) * 8) + " + " + base + "\n";
-			sol += "\t" +  new_var + " <- load " + new_var + "\n";
-			sol += decode_expr(new_var, new_var, prefix);
-			counter++;
-		}
-		std::string accum = make_new_var_name(prefix, counter);
-		sol += "\t" + accum + " <- 0" + "\n";
-		counter++;
-		for (int i = 0; i < n; i++) {
-			std::string curr_row = make_new_var_name(prefix, counter);
-			counter++;
-			sol += "\t" + curr_row + " <- 1\n";
-			for (int j = i + 1; j < n; j++) {
-				std::string multiply = make_new_var_name(prefix, j);
-				sol += "\t" + curr_row + " <- " + curr_row + " * " + multiply + "\n";
+		std::string accum = make_new_var_name(prefix, counter++);
+		if (!this->hoisted_strides.empty()) {
+			// offset = sum of index * stride, where the last dimension's stride is 1
+			sol += "\t" + accum + " <- " + this->dimensions[n - 1]->to_l3_expr(prefix) + "\n";
+			for (int i = 0; i < n - 1; i++) {
+				std::string term = make_new_var_name(prefix, counter++);
+				sol += "\t" + term + " <- " + this->dimensions[i]->to_l3_expr(prefix) + " * " + this->hoisted_strides[i]->to_l3() + "\n";
+				sol += "\t" + accum + " <- " + accum + " + " + term + "\n";
+			}
+		} else {
+			// Horner's rule: offset = (...(i0 * d1 + i1) * d2 + ...) + i(n-1),
+			// so the length of the first dimension is never needed
+			sol += "\t" + accum + " <- " + this->dimensions[0]->to_l3_expr(prefix) + "\n";
+			for (int i = 1; i < n; i++) {
+				std::string length = make_new_var_name(prefix, counter++);
+				sol += "\t" + length + " <- " + std::to_string((i + 1) * 8) + " + " + base + "\n";
+				sol += "\t" + length + " <- load " + length + "\n";
+				sol += decode_expr(length, length, prefix);
+				sol += "\t" + accum + " <- " + accum + " * " + length + "\n";
+				sol += "\t" + accum + " <- " + accum + " + " + this->dimensions[i]->to_l3_expr(prefix) + "\n";
 			}
-			sol += "\t" + curr_row + " <- " + curr_row + " * " + this->dimensions[i]->to_l3_expr(prefix) + "\n";
-			sol += "\t" + accum + " <- " + accum + " + " + curr_row + "\n";  
 		}
 		sol += "\t" + accum + " <- " + accum + " + " + std::to_string(n + 1) + "\n";
 		sol += "\t" + accum + " <- " + accum + " * 8\n";
@@ -280,6 +538,29 @@ namespace IR::program {
 		sol += ")";
 		return sol;
 	}
+	void ArrayDeclaration::collect_variables_read(Vec<Variable *> &result) const {
+		for (const auto &arg : this->args) {
+			arg->collect_variables_read(result);
+		}
+	}
+	void ArrayDeclaration::collect_variable_refs(Vec<ItemRef<Variable> *> &result) {
+		for (Uptr<Expr> &arg : this->args) {
+			arg->collect_variable_refs(result);
+		}
+	}
+	void ArrayDeclaration::collect_operands(Vec<Uptr<Expr> *> &result) {
+		for (Uptr<Expr> &arg : this->args) {
+			result.push_back(&arg);
+			arg->collect_operands(result);
+		}
+	}
+	Uptr<ArrayDeclaration> ArrayDeclaration::clone() const {
+		Vec<Uptr<Expr>> args;
+		for (const Uptr<Expr> &arg : this->args) {
+			args.push_back(arg->clone());
+		}
+		return mkuptr<ArrayDeclaration>(mv(args));
+	}
 	void ArrayDeclaration::bind_to_scope(AggregateScope &agg_scope) {
 		for (const auto &arg : this->args) {
 			arg->bind_to_scope(agg_scope);
@@ -292,6 +573,18 @@ namespace IR::program {
 		}
 		return sol;
 	}
+	void Length::collect_variables_read(Vec<Variable *> &result) const {
+		this->var->collect_variables_read(result);
+	}
+	void Length::collect_variable_refs(Vec<ItemRef<Variable> *> &result) {
+		this->var->collect_variable_refs(result);
+	}
+	Uptr<Length> Length::clone() const {
+		if (this->dimension) {
+			return mkuptr<Length>(this->var->clone_ref(), *this->dimension);
+		}
+		return mkuptr<Length>(this->var->clone_ref());
+	}
 	void Length::bind_to_scope(AggregateScope &agg_scope) {
 		this->var->bind_to_scope(agg_scope);
 	}
@@ -305,6 +598,28 @@ namespace IR::program {
 		sol += this->source->to_string();
 		return sol;
 	}
+	void InstructionAssignment::collect_variables_read(Vec<Variable *> &result) const {
+		this->source->collect_variables_read(result);
+	}
+	void InstructionAssignment::collect_variable_refs(Vec<ItemRef<Variable> *> &result) {
+		this->source->collect_variable_refs(result);
+	}
+	void InstructionAssignment::collect_operands(Vec<Uptr<Expr> *> &result) {
+		result.push_back(&this->source);
+		this->source->collect_operands(result);
+	}
+	Opt<ItemRef<Variable> *> InstructionAssignment::get_dest_ref() const {
+		if (this->maybe_dest) {
+			return this->maybe_dest.value().get();
+		}
+		return {};
+	}
+	Uptr<Instruction> InstructionAssignment::clone() const {
+		if (this->maybe_dest) {
+			return mkuptr<InstructionAssignment>((*this->maybe_dest)->clone_ref(), this->source->clone());
+		}
+		return mkuptr<InstructionAssignment>(this->source->clone());
+	}
 	void InstructionAssignment::bind_to_scope(AggregateScope &agg_scope){
 		if (this->maybe_dest.has_value()) {
 			this->maybe_dest.value()->bind_to_scope(agg_scope);
@@ -325,6 +640,7 @@ namespace IR::program {
 		sol += this->var->to_string();
 		return sol;
 	}
+	void InstructionDeclaration::collect_variables_read(Vec<Variable *> &result) const {}
 	void InstructionDeclaration::bind_to_scope(AggregateScope &agg_scope){
 	}
 	void InstructionDeclaration::resolver(AggregateScope &agg_scope) {
@@ -333,9 +649,29 @@ namespace IR::program {
 	std::string InstructionDeclaration::to_l3_inst(std::string prefix) {
 		return "";
 	}
+	Uptr<Instruction> InstructionDeclaration::clone() const {
+		std::cerr << "Logic error: declarations own their variable and can't be copied.\n";
+		exit(1);
+	}
 	std::string InstructionStore::to_string() const {
 		return this->dest->to_string() + " <- " + this->source->to_string();
 	}
+	void InstructionStore::collect_variables_read(Vec<Variable *> &result) const {
+		this->dest->collect_variables_read(result);
+		this->source->collect_variables_read(result);
+	}
+	void InstructionStore::collect_variable_refs(Vec<ItemRef<Variable> *> &result) {
+		this->dest->collect_variable_refs(result);
+		this->source->collect_variable_refs(result);
+	}
+	void InstructionStore::collect_operands(Vec<Uptr<Expr> *> &result) {
+		this->dest->collect_operands(result);
+		result.push_back(&this->source);
+		this->source->collect_operands(result);
+	}
+	Uptr<Instruction> InstructionStore::clone() const {
+		return mkuptr<InstructionStore>(this->dest->clone(), this->source->clone());
+	}
 	void InstructionStore::bind_to_scope(AggregateScope &agg_scope) {
 		this->dest->bind_to_scope(agg_scope);
 		this->source->bind_to_scope(agg_scope);
@@ -349,6 +685,18 @@ namespace IR::program {
 	std::string InstructionLoad::to_string() const {
 		return this->dest->to_string() + " <- " + this-> source->to_string();
 	}
+	void InstructionLoad::collect_variables_read(Vec<Variable *> &result) const {
+		this->source->collect_variables_read(result);
+	}
+	void InstructionLoad::collect_variable_refs(Vec<ItemRef<Variable> *> &result) {
+		this->source->collect_variable_refs(result);
+	}
+	void InstructionLoad::collect_operands(Vec<Uptr<Expr> *> &result) {
+		this->source->collect_operands(result);
+	}
+	Uptr<Instruction> InstructionLoad::clone() const {
+		return mkuptr<InstructionLoad>(this->dest->clone_ref(), this->source->clone());
+	}
 	void InstructionLoad::bind_to_scope(AggregateScope &agg_scope) {
 		this->dest->bind_to_scope(agg_scope);
 		this->source->bind_to_scope(agg_scope);
@@ -361,20 +709,74 @@ namespace IR::program {
 	}
 	std::string InstructionInitializeArray::to_string() const {
 		std::string sol = this->dest->to_string();
-		sol += " <- ";
+		sol += this->in_frame ? " <- frame " : " <- ";
 		sol += this->newArray->to_string();
 		return sol;
 	}
+	Opt<int64_t> InstructionInitializeArray::get_constant_num_words() const {
+		const Vec<Uptr<Expr>> &args = this->newArray->get_args();
+		bool is_tuple = this->dest->get_referent().value()->get_type().get_a_type() == A_type::tuple;
+		int64_t num_elements = 1;
+		for (const Uptr<Expr> &arg : args) {
+			const NumberLiteral *literal = dynamic_cast<const NumberLiteral *>(arg.get());
+			if (!literal || literal->get_value() % 2 == 0) {
+				return {};
+			}
+			int64_t length = literal->get_value() >> 1;
+			if (length < 0 || length > (1 << 20)) {
+				return {}; // let allocate report it, or too big for a frame anyway
+			}
+			num_elements *= length;
+			if (num_elements > (1 << 20)) {
+				return {};
+			}
+		}
+		if (!is_tuple) {
+			num_elements += args.size(); // the dimension lengths
+		}
+		return num_elements + 1;
+	}
+	void InstructionInitializeArray::collect_variables_read(Vec<Variable *> &result) const {
+		this->newArray->collect_variables_read(result);
+	}
+	void InstructionInitializeArray::collect_variable_refs(Vec<ItemRef<Variable> *> &result) {
+		this->newArray->collect_variable_refs(result);
+	}
+	void InstructionInitializeArray::collect_operands(Vec<Uptr<Expr> *> &result) {
+		this->newArray->collect_operands(result);
+	}
+	Uptr<Instruction> InstructionInitializeArray::clone() const {
+		return mkuptr<InstructionInitializeArray>(this->dest->clone_ref(), this->newArray->clone(), this->in_frame);
+	}
 	void InstructionInitializeArray::bind_to_scope(AggregateScope &agg_scope) {
 		this->dest->bind_to_scope(agg_scope);
 		this->dest->get_referent().value()->set_args(this->newArray->get_args());
 	}
 	std::string InstructionInitializeArray::to_l3_inst(std::string prefix) {
 		Vec<Uptr<Expr>> &args = this->newArray->get_args();
+		if (this->frame_slot) {
+			auto &[frame_base, offset] = *this->frame_slot;
+			int counter = 0;
+			int64_t num_elements = *this->get_constant_num_words() - 1;
+			std::string sol = generate_frame_allocation(this->dest->to_l3_expr(prefix), frame_base, offset, num_elements, prefix, counter);
+			if (this->dest->get_referent().value()->get_type().get_a_type() == A_type::tuple) {
+				return sol;
+			}
+			std::string address = make_new_var_name(prefix, counter++);
+			int64_t index = 1;
+			for (Uptr<Expr> &arg : args) {
+				sol += "\t" + address + " <- " + this->dest->to_l3_expr(prefix) + " + " + std::to_string(index * 8) + "\n";
+				sol += "\tstore " + address + " <- " + arg->to_l3_expr(prefix) + "\n";
+				index++;
+			}
+			return sol;
+		}
 		if (this->dest->get_referent().value()->get_type().get_a_type() == A_type::tuple) {
-			std::string sol = "";
+			int counter = 0;
+			std::string length = make_new_var_name(prefix, counter++);
 			Uptr<Expr> &arg = args[0];
-			sol += "\t" + this->dest->to_l3_expr(prefix) + " <- call allocate(" + arg->to_l3_expr(prefix) + ", 1)\n";
+			std::string sol = decode_expr(length, arg->to_l3_expr(prefix), prefix);
+			sol += generate_allocation(this->dest->to_l3_expr(prefix), length, arg->to_l3_expr(prefix), prefix, counter);
 			return sol;
 		}
 		int counter = 1;
@@ -387,8 +789,9 @@ namespace IR::program {
 			counter++;
 		}
 		sol += "\t" + base + " <- " + base + " + " + std::to_string(args.size()) + "\n";
-		sol += encode_expr(base, base, prefix);
-		sol += "\t" + this->dest->to_l3_expr(prefix) + " <- call allocate(" + base + ", 1)\n";
+		std::string encoded_base = make_new_var_name(prefix, counter++);
+		sol += encode_expr(encoded_base, base, prefix);
+		sol += generate_allocation(this->dest->to_l3_expr(prefix), base, encoded_base, prefix, counter);
 		int index = 1;
 		for(Uptr<Expr> &arg: args){
 			std::string new_var = "%" + prefix + std::to_string(counter);
@@ -402,6 +805,16 @@ namespace IR::program {
 	std::string InstructionLength::to_string() const {
 		return this->dest->to_string() + " <- " + this->source->to_string();
 	}
+	void InstructionLength::collect_variables_read(Vec<Variable *> &result) const {
+		this->source->collect_variables_read(result);
+	}
+	void InstructionLength::collect_variable_refs(Vec<ItemRef<Variable> *> &result) {
+		this->source->collect_variable_refs(result);
+	}
+	void InstructionLength::collect_operands(Vec<Uptr<Expr> *> &result) {}
+	Uptr<Instruction> InstructionLength::clone() const {
+		return mkuptr<InstructionLength>(this->dest->clone_ref(), this->source->clone());
+	}
 	void InstructionLength::bind_to_scope(AggregateScope &agg_scope) {
 		this->dest->bind_to_scope(agg_scope);
 		this->source->bind_to_scope(agg_scope);
@@ -423,6 +836,52 @@ namespace IR::program {
 		return sol;
 	}
 
+	std::string InstructionPhi::to_string() const {
+		std::string sol = this->dest->to_string() + " <- phi(";
+		bool first = true;
+		for (const auto &[pred, value] : this->incoming) {
+			if (!first) {
+				sol += ", ";
+			}
+			first = false;
+			sol += value->to_string() + " from :" + pred->get_name();
+		}
+		return sol + ")";
+	}
+	std::string InstructionPhi::to_l3_inst(std::string prefix) {
+		std::cerr << "phi " << this->to_string() << " was not removed before code generation\n";
+		exit(1);
+	}
+	void InstructionPhi::collect_variables_read(Vec<Variable *> &result) const {
+		for (const auto &[pred, value] : this->incoming) {
+			value->collect_variables_read(result);
+		}
+	}
+	void InstructionPhi::collect_variable_refs(Vec<ItemRef<Variable> *> &result) {
+		for (auto &[pred, value] : this->incoming) {
+			value->collect_variable_refs(result);
+		}
+	}
+	void InstructionPhi::collect_operands(Vec<Uptr<Expr> *> &result) {
+		for (auto &[pred, value] : this->incoming) {
+			result.push_back(&value);
+			value->collect_operands(result);
+		}
+	}
+	Uptr<Instruction> InstructionPhi::clone() const {
+		Uptr<InstructionPhi> result = mkuptr<InstructionPhi>(this->dest->clone_ref());
+		for (const auto &[pred, value] : this->incoming) {
+			result->incoming.emplace_back(pred, value->clone());
+		}
+		return result;
+	}
+	Opt<Variable *> Instruction::get_variable_written() const {
+		if (Opt<ItemRef<Variable> *> dest = this->get_dest_ref()) {
+			return (*dest)->get_referent();
+		}
+		return {};
+	}
+
 	void TerminatorBranchOne::bind_to_scope(AggregateScope &agg_scope) {
 		this->bb_ref->bind_to_scope(agg_scope);
 	}
@@ -434,6 +893,14 @@ namespace IR::program {
 		sol.push_back(std::make_pair(this->bb_ref->get_referent().value(), 1.0));
 		return sol;
 	}
+	Uptr<Terminator> TerminatorBranchOne::clone() const {
+		return mkuptr<TerminatorBranchOne>(this->bb_ref->clone_ref());
+	}
+	void TerminatorBranchOne::replace_successor(BasicBlock *old_succ, BasicBlock *new_succ) {
+		if (this->bb_ref->get_referent() == old_succ) {
+			this->bb_ref->bind(new_succ);
+		}
+	}
 	std::string TerminatorBranchOne::to_l3_terminator(std::string prefix, Trace &my_trace, BasicBlock *my_bb) {
 		bool printMe = true;
 		bool isNext = false;
@@ -452,6 +919,19 @@ namespace IR::program {
 		}
 		return "";
 	}
+	void TerminatorBranchTwo::collect_variables_read(Vec<Variable *> &result) const {
+		this->condition->collect_variables_read(result);
+	}
+	void TerminatorBranchTwo::collect_variable_refs(Vec<ItemRef<Variable> *> &result) {
+		this->condition->collect_variable_refs(result);
+	}
+	void TerminatorBranchTwo::collect_operands(Vec<Uptr<Expr> *> &result) {
+		result.push_back(&this->condition);
+		this->condition->collect_operands(result);
+	}
+	Uptr<Terminator> TerminatorBranchTwo::clone() const {
+		return mkuptr<TerminatorBranchTwo>(this->condition->clone(), this->branchTrue->clone_ref(), this->branchFalse->clone_ref());
+	}
 	void TerminatorBranchTwo::bind_to_scope(AggregateScope &agg_scope) {
 		this->condition->bind_to_scope(agg_scope);
 		this->branchTrue->bind_to_scope(agg_scope);
@@ -469,6 +949,14 @@ namespace IR::program {
 		sol.emplace_back(std::make_pair(this->branchFalse->get_referent().value(), 0.3));
 		return sol;
 	}
+	void TerminatorBranchTwo::replace_successor(BasicBlock *old_succ, BasicBlock *new_succ) {
+		if (this->branchTrue->get_referent() == old_succ) {
+			this->branchTrue->bind(new_succ);
+		}
+		if (this->branchFalse->get_referent() == old_succ) {
+			this->branchFalse->bind(new_succ);
+		}
+	}
 	std::string TerminatorBranchTwo::to_l3_terminator(std::string prefix, Trace &my_trace, BasicBlock *my_bb) {
 		bool printTrue = true;
 		bool isNext = false;
@@ -496,13 +984,27 @@ namespace IR::program {
 			sol += "\tbr " + this->condition->to_l3_expr(prefix) + " " + this->branchTrue->to_l3_expr(prefix) + "\n";
 			return sol;
 		} else {
-			sol += "\t%" + prefix + "t <- " + this->condition->to_l3_expr(prefix) + "\n";
-			sol += "\t%" + prefix + "t <- %" + prefix + "t = 1\n"; 
+			// the condition couldn't be inverted at its comparison (see
+			// fuse_negated_branches), so negate it here
+			sol += "\t%" + prefix + "t <- " + this->condition->to_l3_expr(prefix) + " = 1\n";
 			sol += "\t%" + prefix + "t <- %" + prefix + "t = 0\n"; 
 			sol += "\tbr %" + prefix + "t " + this->branchFalse->to_l3_expr(prefix) + "\n";
 			return sol;
 		}
 	}
+	void TerminatorReturnVar::collect_variables_read(Vec<Variable *> &result) const {
+		this->ret_expr->collect_variables_read(result);
+	}
+	void TerminatorReturnVar::collect_variable_refs(Vec<ItemRef<Variable> *> &result) {
+		this->ret_expr->collect_variable_refs(result);
+	}
+	void TerminatorReturnVar::collect_operands(Vec<Uptr<Expr> *> &result) {
+		result.push_back(&this->ret_expr);
+		this->ret_expr->collect_operands(result);
+	}
+	Uptr<Terminator> TerminatorReturnVar::clone() const {
+		return mkuptr<TerminatorReturnVar>(this->ret_expr->clone());
+	}
 	void TerminatorReturnVar::bind_to_scope(AggregateScope &agg_scope) {
 		this->ret_expr->bind_to_scope(agg_scope);
 	}
@@ -585,6 +1087,48 @@ namespace IR::program {
 		this->parameter_vars.push_back(var_ptr.get());
 		this->vars.emplace_back(mv(var_ptr));
 	}
+	Variable *IRFunction::add_generated_variable(const std::string &name_hint, Type type) {
+		std::string name;
+		for (int i = 0; name.empty() || this->agg_scope.variable_scope.get_item_maybe(name); ++i) {
+			name = name_hint + std::to_string(i);
+		}
+		Uptr<Variable> var_ptr = mkuptr<Variable>(name, type);
+		this->agg_scope.variable_scope.resolve_item(mv(name), var_ptr.get());
+		this->vars.push_back(mv(var_ptr));
+		return this->vars.back().get();
+	}
+	BasicBlock *IRFunction::insert_block(int index, const std::string &name_hint, Vec<Uptr<Instruction>> &&inst, Uptr<Terminator> &&te) {
+		std::string name;
+		for (int i = 0; name.empty() || this->agg_scope.basic_block_scope.get_item_maybe(name); ++i) {
+			name = name_hint + std::to_string(i);
+		}
+		Uptr<BasicBlock> bb = mkuptr<BasicBlock>(name, mv(inst), mv(te));
+		bb->set_successors(bb->get_terminator()->get_successor());
+		this->agg_scope.basic_block_scope.resolve_item(mv(name), bb.get());
+		this->blocks.insert(this->blocks.begin() + index, mv(bb));
+		return this->blocks[index].get();
+	}
+	void IRFunction::remove_blocks(const Set<BasicBlock *> &dead_blocks) {
+		Vec<Uptr<Instruction>> declarations;
+		for (const Uptr<BasicBlock> &block : this->blocks) {
+			if (!dead_blocks.count(block.get())) continue;
+			for (Uptr<Instruction> &inst : block->get_inst()) {
+				if (inst && dynamic_cast<InstructionDeclaration *>(inst.get())) {
+					declarations.push_back(mv(inst));
+				}
+			}
+		}
+		auto remove_begin = std::remove_if(
+			this->blocks.begin(),
+			this->blocks.end(),
+			[&](const Uptr<BasicBlock> &block) { return dead_blocks.count(block.get()) > 0; }
+		);
+		this->blocks.erase(remove_begin, this->blocks.end());
+		if (!declarations.empty()) {
+			Vec<Uptr<Instruction>> &entry_insts = this->blocks[0]->get_inst();
+			entry_insts.insert(entry_insts.begin(), std::make_move_iterator(declarations.begin()), std::make_move_iterator(declarations.end()));
+		}
+	}
 	std::string IRFunction::to_string() const {
 		std::string result = "define @" + this->name + "(";
 		for (const Variable *var : this->parameter_vars) {
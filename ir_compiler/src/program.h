@@ -23,6 +23,7 @@ namespace IR::program {
 	class BasicBlock;
 	class IRFunction;
 	class ExternalFunction;
+	template<typename Item> class ItemRef;
 	
 	std::pair<A_type, int64_t> str_to_type(const std::string& str);
 	std::string to_string(A_type t);
@@ -46,9 +47,19 @@ namespace IR::program {
 		virtual std::string to_string() const = 0;
 		virtual void bind_to_scope(AggregateScope &agg_scope) = 0;
 		virtual std::string to_l3_expr(std::string prefix) = 0;
+		// appends every variable this expression reads to `result`
+		virtual void collect_variables_read(Vec<Variable *> &result) const = 0;
+		// appends every variable reference this expression reads to `result`
+		virtual void collect_variable_refs(Vec<ItemRef<Variable> *> &result) = 0;
+		// appends every operand slot nested in this expression to `result`,
+		// so that a pass can replace the operands
+		virtual void collect_operands(Vec<Uptr<Expr> *> &result) = 0;
+		// a deep copy that refers to the same items
+		virtual Uptr<Expr> clone() const = 0;
 	};
 	struct Trace {
 	    Vec<BasicBlock *> block_sequence; 
+	    bool is_cold = false; // the trace only leads to errors or never ran
     };
 	template<typename Item>
 	class ItemRef : public Expr {
@@ -64,6 +75,15 @@ namespace IR::program {
 		virtual void bind_to_scope(AggregateScope &agg_scope) override;
 		virtual std::string to_string() const override;
 		virtual std::string to_l3_expr(std::string prefix) override;
+		virtual void collect_variables_read(Vec<Variable *> &result) const override;
+		virtual void collect_variable_refs(Vec<ItemRef<Variable> *> &result) override;
+		virtual void collect_operands(Vec<Uptr<Expr> *> &result) override {}
+		virtual Uptr<Expr> clone() const override { return this->clone_ref(); }
+		Uptr<ItemRef<Item>> clone_ref() const {
+			Uptr<ItemRef<Item>> result = mkuptr<ItemRef<Item>>(this->free_name);
+			result->referent_nullable = this->referent_nullable;
+			return result;
+		}
 		Opt<Item *> get_referent() const {
 			if (this->referent_nullable) {
 				return this->referent_nullable;
@@ -82,6 +102,14 @@ namespace IR::program {
 			this->referent_nullable = referent;
 		}
 	};
+	// makes a reference that is already bound, for passes that build new
+	// instructions after parsing
+	template<typename Item>
+	Uptr<ItemRef<Item>> make_bound_ref(Item *item) {
+		Uptr<ItemRef<Item>> ref = mkuptr<ItemRef<Item>>(item->get_name());
+		ref->bind(item);
+		return ref;
+	}
 	class NumberLiteral : public Expr {
 		int64_t value;
 
@@ -92,6 +120,10 @@ namespace IR::program {
 		virtual std::string to_string() const override {return std::to_string(this->value);};
 		virtual void bind_to_scope(AggregateScope &agg_scope) {return;}
 		virtual std::string to_l3_expr(std::string prefix) {return std::to_string(this->value); }
+		virtual void collect_variables_read(Vec<Variable *> &result) const override {}
+		virtual void collect_variable_refs(Vec<ItemRef<Variable> *> &result) override {}
+		virtual void collect_operands(Vec<Uptr<Expr> *> &result) override {}
+		virtual Uptr<Expr> clone() const override { return mkuptr<NumberLiteral>(this->value); }
 	};
 
 	enum struct Operator {
@@ -110,6 +142,7 @@ namespace IR::program {
 	Operator str_to_op(std::string str);
 	std::string op_to_string(Operator op);
 	Opt<Operator> flip_operator(Operator op);
+	Opt<Operator> invert_comparison(Operator op);
 
 	class BinaryOperation : public Expr {
 		Uptr<Expr> lhs;
@@ -123,9 +156,17 @@ namespace IR::program {
 			rhs { mv(rhs) },
 			op { op }
 		{}
+		Expr &get_lhs() const { return *this->lhs; }
+		Expr &get_rhs() const { return *this->rhs; }
+		Operator get_op() const { return this->op; }
+		void set_op(Operator op) { this->op = op; }
 		virtual void bind_to_scope(AggregateScope &agg_scope) override;
 		virtual std::string to_string() const override;
 		virtual std::string to_l3_expr(std::string prefix) override;
+		virtual void collect_variables_read(Vec<Variable *> &result) const override;
+		virtual void collect_variable_refs(Vec<ItemRef<Variable> *> &result) override;
+		virtual void collect_operands(Vec<Uptr<Expr> *> &result) override;
+		virtual Uptr<Expr> clone() const override;
 	};
 	class FunctionCall : public Expr {
 		Uptr<Expr> callee;
@@ -136,13 +177,22 @@ namespace IR::program {
 		FunctionCall(Uptr<Expr> &&callee, Vec<Uptr<Expr>> &&arguments) :
 			callee { mv(callee) }, arguments { mv(arguments) }
 		{}
+		Expr &get_callee() const { return *this->callee; }
 		virtual void bind_to_scope(AggregateScope &agg_scope) override;
 		virtual std::string to_string() const override;
 		virtual std::string to_l3_expr(std::string prefix) override;
+		virtual void collect_variables_read(Vec<Variable *> &result) const override;
+		virtual void collect_variable_refs(Vec<ItemRef<Variable> *> &result) override;
+		virtual void collect_operands(Vec<Uptr<Expr> *> &result) override;
+		virtual Uptr<Expr> clone() const override;
 	};
 	class MemoryLocation{
 		Uptr<ItemRef<Variable>> base;
 		Vec<Uptr<Expr>> dimensions;
+		// filled in by the addressing pass (see addressing.h) when the
+		// location's address or the array's strides are kept in variables
+		Opt<Variable *> hoisted_address;
+		Vec<Variable *> hoisted_strides; // the decoded stride of every dimension but the last
 
 		public:
 
@@ -153,7 +203,14 @@ namespace IR::program {
 		void bind_to_scope(AggregateScope &agg_scope);
 		std::string to_string() const;
 		std::string to_l3(std::string prefix);
+		void collect_variables_read(Vec<Variable *> &result) const;
+		void collect_variable_refs(Vec<ItemRef<Variable> *> &result);
+		void collect_operands(Vec<Uptr<Expr> *> &result);
 		Vec<Uptr<Expr>> &get_dimensions() {return this->dimensions; }
+		ItemRef<Variable> &get_base() const { return *this->base; }
+		void set_hoisted_address(Variable *address) { this->hoisted_address = address; }
+		void set_hoisted_strides(Vec<Variable *> strides) { this->hoisted_strides = mv(strides); }
+		Uptr<MemoryLocation> clone() const;
 	};
 	class ArrayDeclaration {
 		Vec<Uptr<Expr>> args;
@@ -164,7 +221,11 @@ namespace IR::program {
 		void bind_to_scope(AggregateScope &agg_scope);
 		std::string to_string() const;
 		std::string to_l3(std::string prefix);
+		void collect_variables_read(Vec<Variable *> &result) const;
+		void collect_variable_refs(Vec<ItemRef<Variable> *> &result);
+		void collect_operands(Vec<Uptr<Expr> *> &result);
 		Vec<Uptr<Expr>> &get_args(){return this->args;}
+		Uptr<ArrayDeclaration> clone() const;
 
 	};
 	class Length {
@@ -180,6 +241,9 @@ namespace IR::program {
 		Opt<int64_t> get_dim() const {return this->dimension; }
 		std::string to_string() const;
 		std::string to_l3(std::string prefix);
+		void collect_variables_read(Vec<Variable *> &result) const;
+		void collect_variable_refs(Vec<ItemRef<Variable> *> &result);
+		Uptr<Length> clone() const;
 	};
 
 	class Variable {
@@ -207,6 +271,15 @@ namespace IR::program {
 		virtual void bind_to_scope(AggregateScope &agg_scope) = 0;
 		virtual void resolver(AggregateScope &agg_scope){}
 		virtual std::string to_l3_inst(std::string prefix) = 0;
+		// appends every variable this instruction reads to `result`
+		virtual void collect_variables_read(Vec<Variable *> &result) const = 0;
+		virtual void collect_variable_refs(Vec<ItemRef<Variable> *> &result) = 0;
+		virtual void collect_operands(Vec<Uptr<Expr> *> &result) = 0;
+		// the reference to the variable this instruction writes, if any
+		virtual Opt<ItemRef<Variable> *> get_dest_ref() const { return {}; }
+		Opt<Variable *> get_variable_written() const;
+		// a deep copy that refers to the same variables
+		virtual Uptr<Instruction> clone() const = 0;
 	};
 	class InstructionAssignment: public Instruction {
 		Opt<Uptr<ItemRef<Variable>>> maybe_dest;
@@ -218,9 +291,16 @@ namespace IR::program {
 		InstructionAssignment(Uptr<ItemRef<Variable>> &&destination, Uptr<Expr> &&source) :
 			maybe_dest { mv(destination) }, source { mv(source) }
 		{}
+		const Opt<Uptr<ItemRef<Variable>>> &get_dest() const { return this->maybe_dest; }
+		Expr &get_source() const { return *this->source; }
 		virtual void bind_to_scope(AggregateScope &agg_scope) override;
 		virtual std::string to_string() const override;
 		virtual std::string to_l3_inst(std::string prefix) override;
+		virtual void collect_variables_read(Vec<Variable *> &result) const override;
+		virtual void collect_variable_refs(Vec<ItemRef<Variable> *> &result) override;
+		virtual void collect_operands(Vec<Uptr<Expr> *> &result) override;
+		virtual Opt<ItemRef<Variable> *> get_dest_ref() const override;
+		virtual Uptr<Instruction> clone() const override;
 	};
 	class InstructionDeclaration: public Instruction {
 		Uptr<Variable> var;
@@ -232,6 +312,10 @@ namespace IR::program {
 		virtual std::string to_string() const override;
 		virtual void resolver(AggregateScope &agg_scope) override;
 		virtual std::string to_l3_inst(std::string prefix) override;
+		virtual void collect_variables_read(Vec<Variable *> &result) const override;
+		virtual void collect_variable_refs(Vec<ItemRef<Variable> *> &result) override {}
+		virtual void collect_operands(Vec<Uptr<Expr> *> &result) override {}
+		virtual Uptr<Instruction> clone() const override;
 	};
 	class InstructionStore: public Instruction {
 		Uptr<MemoryLocation> dest; 
@@ -242,9 +326,14 @@ namespace IR::program {
 		InstructionStore(Uptr<MemoryLocation> dest, Uptr<Expr> source): 
 			dest {mv(dest)}, source {mv(source)}
 		{}
+		MemoryLocation &get_memory_location() const { return *this->dest; }
 		virtual void bind_to_scope(AggregateScope &agg_scope) override;
 		virtual std::string to_string() const override;
 		virtual std::string to_l3_inst(std::string prefix) override;
+		virtual void collect_variables_read(Vec<Variable *> &result) const override;
+		virtual void collect_variable_refs(Vec<ItemRef<Variable> *> &result) override;
+		virtual void collect_operands(Vec<Uptr<Expr> *> &result) override;
+		virtual Uptr<Instruction> clone() const override;
 	};
 	class InstructionLoad: public Instruction {
 		Uptr<ItemRef<Variable>> dest;
@@ -255,9 +344,15 @@ namespace IR::program {
 		InstructionLoad(Uptr<ItemRef<Variable>> dest, Uptr<MemoryLocation> source): 
 			dest {mv(dest)}, source {mv(source)}
 		{}
+		MemoryLocation &get_memory_location() const { return *this->source; }
 		virtual void bind_to_scope(AggregateScope &agg_scope) override;
 		virtual std::string to_string() const override;
 		virtual std::string to_l3_inst(std::string prefix) override;
+		virtual void collect_variables_read(Vec<Variable *> &result) const override;
+		virtual void collect_variable_refs(Vec<ItemRef<Variable> *> &result) override;
+		virtual void collect_operands(Vec<Uptr<Expr> *> &result) override;
+		virtual Opt<ItemRef<Variable> *> get_dest_ref() const override { return this->dest.get(); }
+		virtual Uptr<Instruction> clone() const override;
 	};
 	class InstructionLength: public Instruction {
 		Uptr<ItemRef<Variable>> dest;
@@ -268,22 +363,66 @@ namespace IR::program {
 		InstructionLength(Uptr<ItemRef<Variable>> dest, Uptr<Length> source): 
 			dest {mv(dest)}, source {mv(source)}
 		{}
+		Length &get_source() const { return *this->source; }
 		virtual void bind_to_scope(AggregateScope &agg_scope) override;
 		virtual std::string to_string() const override;
 		virtual std::string to_l3_inst(std::string prefix) override;
+		virtual void collect_variables_read(Vec<Variable *> &result) const override;
+		virtual void collect_variable_refs(Vec<ItemRef<Variable> *> &result) override;
+		virtual void collect_operands(Vec<Uptr<Expr> *> &result) override;
+		virtual Opt<ItemRef<Variable> *> get_dest_ref() const override { return this->dest.get(); }
+		virtual Uptr<Instruction> clone() const override;
 	};
+	// x <- new Array(...) or x <- new Tuple(...). With `new frame Array(...)`
+	// or `new frame Tuple(...)` the frontend promises that the object doesn't
+	// outlive the function call and that it is dead by the time the same
+	// instruction runs again, so when its size is constant it gets a fixed
+	// slot in the function's frame instead of coming from the heap (see
+	// generate_frame_entry).
 	class InstructionInitializeArray: public Instruction {
 		Uptr<ItemRef<Variable>> dest;
 		Uptr<ArrayDeclaration> newArray;
+		bool in_frame;
+		Opt<Pair<std::string, int64_t>> frame_slot; // (frame base variable, byte offset)
 
 		public:
 
-		InstructionInitializeArray(Uptr<ItemRef<Variable>> dest, Uptr<ArrayDeclaration> newArray): 
-			dest {mv(dest)}, newArray {mv(newArray)}
+		InstructionInitializeArray(Uptr<ItemRef<Variable>> dest, Uptr<ArrayDeclaration> newArray, bool in_frame = false): 
+			dest {mv(dest)}, newArray {mv(newArray)}, in_frame {in_frame}
 		{}
+		bool is_in_frame() const { return this->in_frame; }
+		// the number of words the object takes up including its header, if
+		// the lengths are all constants
+		Opt<int64_t> get_constant_num_words() const;
+		void set_frame_slot(std::string frame_base, int64_t offset) { this->frame_slot = Pair<std::string, int64_t> { mv(frame_base), offset }; }
 		virtual void bind_to_scope(AggregateScope &agg_scope) override;
 		virtual std::string to_string() const override;
 		virtual std::string to_l3_inst(std::string prefix) override;
+		virtual void collect_variables_read(Vec<Variable *> &result) const override;
+		virtual void collect_variable_refs(Vec<ItemRef<Variable> *> &result) override;
+		virtual void collect_operands(Vec<Uptr<Expr> *> &result) override;
+		virtual Opt<ItemRef<Variable> *> get_dest_ref() const override { return this->dest.get(); }
+		virtual Uptr<Instruction> clone() const override;
+	};
+	// x <- phi(v1 from :b1, v2 from :b2, ...), with one incoming value per
+	// predecessor. Phis only exist while a function is in SSA form (see
+	// ssa.h), so they can't be turned into L3.
+	class InstructionPhi: public Instruction {
+		Uptr<ItemRef<Variable>> dest;
+		Vec<Pair<BasicBlock *, Uptr<Expr>>> incoming;
+
+		public:
+
+		InstructionPhi(Uptr<ItemRef<Variable>> dest): dest {mv(dest)} {}
+		Vec<Pair<BasicBlock *, Uptr<Expr>>> &get_incoming() { return this->incoming; }
+		virtual void bind_to_scope(AggregateScope &agg_scope) override {}
+		virtual std::string to_string() const override;
+		virtual std::string to_l3_inst(std::string prefix) override;
+		virtual void collect_variables_read(Vec<Variable *> &result) const override;
+		virtual void collect_variable_refs(Vec<ItemRef<Variable> *> &result) override;
+		virtual void collect_operands(Vec<Uptr<Expr> *> &result) override;
+		virtual Opt<ItemRef<Variable> *> get_dest_ref() const override { return this->dest.get(); }
+		virtual Uptr<Instruction> clone() const override;
 	};
 
 	class Terminator {
@@ -294,6 +433,14 @@ namespace IR::program {
 		virtual Vec<Pair<BasicBlock *, double>> get_successor() = 0;
 		virtual std::string to_string() const = 0;
 		virtual std::string to_l3_terminator(std::string prefix, Trace &my_trace, BasicBlock *my_bb) = 0;
+		// appends every variable this terminator reads to `result`
+		virtual void collect_variables_read(Vec<Variable *> &result) const = 0;
+		virtual void collect_variable_refs(Vec<ItemRef<Variable> *> &result) {}
+		virtual void collect_operands(Vec<Uptr<Expr> *> &result) {}
+		// makes the terminator jump to new_succ wherever it jumped to old_succ
+		virtual void replace_successor(BasicBlock *old_succ, BasicBlock *new_succ) {}
+		// a deep copy that jumps to the same blocks
+		virtual Uptr<Terminator> clone() const = 0;
 	};
 	class TerminatorBranchOne : public Terminator{
 		Uptr<ItemRef<BasicBlock>> bb_ref;
@@ -304,6 +451,9 @@ namespace IR::program {
 		virtual std::string to_string() const;
 		virtual Vec<Pair<BasicBlock *, double>> get_successor();
 		virtual std::string to_l3_terminator(std::string prefix, Trace &my_trace, BasicBlock *my_bb) override;
+		virtual void collect_variables_read(Vec<Variable *> &result) const override {}
+		virtual void replace_successor(BasicBlock *old_succ, BasicBlock *new_succ) override;
+		virtual Uptr<Terminator> clone() const override;
 	};
 	class TerminatorBranchTwo : public Terminator{
 		Uptr<Expr> condition;
@@ -321,10 +471,19 @@ namespace IR::program {
 			branchTrue (mv(branchTrue)),
 			branchFalse {mv(branchFalse)}
 		{}
+		Expr &get_condition() const { return *this->condition; }
+		// swaps the true and false successors; the caller is responsible for
+		// inverting the condition
+		void swap_successors() { std::swap(this->branchTrue, this->branchFalse); }
 		virtual void bind_to_scope(AggregateScope &agg_scope);
 		virtual Vec<Pair<BasicBlock *, double>> get_successor();
 		virtual std::string to_string() const;
 		virtual std::string to_l3_terminator(std::string prefix, Trace &my_trace, BasicBlock *my_bb) override;
+		virtual void collect_variables_read(Vec<Variable *> &result) const override;
+		virtual void collect_variable_refs(Vec<ItemRef<Variable> *> &result) override;
+		virtual void collect_operands(Vec<Uptr<Expr> *> &result) override;
+		virtual void replace_successor(BasicBlock *old_succ, BasicBlock *new_succ) override;
+		virtual Uptr<Terminator> clone() const override;
 	};
 	class TerminatorReturnVoid : public Terminator {
 		public:
@@ -332,6 +491,8 @@ namespace IR::program {
 		virtual Vec<Pair<BasicBlock *, double>> get_successor() { return {}; }
 		virtual std::string to_string() const {return "return\n"; }
 		virtual std::string to_l3_terminator(std::string prefix, Trace &my_trace, BasicBlock *my_bb) {return "\treturn\n";};
+		virtual void collect_variables_read(Vec<Variable *> &result) const override {}
+		virtual Uptr<Terminator> clone() const override { return mkuptr<TerminatorReturnVoid>(); }
 	};
 	class TerminatorReturnVar : public Terminator {
 		Uptr<Expr> ret_expr;
@@ -343,6 +504,10 @@ namespace IR::program {
 		virtual std::string to_string() const;
 		virtual std::string to_l3_terminator(std::string prefix, Trace &my_trace, BasicBlock *my_bb) override;
 		virtual Vec<Pair<BasicBlock *, double>> get_successor() { return {};}
+		virtual void collect_variables_read(Vec<Variable *> &result) const override;
+		virtual void collect_variable_refs(Vec<ItemRef<Variable> *> &result) override;
+		virtual void collect_operands(Vec<Uptr<Expr> *> &result) override;
+		virtual Uptr<Terminator> clone() const override;
 	};
 
 	class BasicBlock {
@@ -350,6 +515,7 @@ namespace IR::program {
 		Vec<Uptr<Instruction>> inst;
 		Uptr<Terminator> te;
 		Vec<Pair<BasicBlock *, double>> successors;
+		Opt<int64_t> execution_count; // measured by a profiling run, if we have one
 
 		public:
 
@@ -369,6 +535,8 @@ namespace IR::program {
 		Vec<Uptr<Instruction>> &get_inst() { return this->inst; }
 		Uptr<Terminator> &get_terminator() { return this->te; }
 		void set_successors(Vec<Pair<BasicBlock *, double>> succ) {this->successors = mv(succ); }
+		const Opt<int64_t> &get_execution_count() const { return this->execution_count; }
+		void set_execution_count(int64_t count) { this->execution_count = count; }
 		void set_name(std::string new_name) {this->name = mv(new_name); }
 		void bind_to_scope(AggregateScope &agg_scope);
 
@@ -552,6 +720,16 @@ namespace IR::program {
 		const Vec<Uptr<BasicBlock>> &get_blocks() const { return this->blocks; }
 		const Vec<Variable *> &get_parameter_vars() const { return this->parameter_vars; }
 		AggregateScope &get_scope() { return this->agg_scope; }
+		// Adds a variable for the compiler's own use, named `name_hint`
+		// followed by a number that makes it unique in this function.
+		Variable *add_generated_variable(const std::string &name_hint, Type type);
+		// Adds a block at `index` in the block list, giving it a unique name
+		// that starts with `name_hint`. Its terminator must already be bound.
+		BasicBlock *insert_block(int index, const std::string &name_hint, Vec<Uptr<Instruction>> &&inst, Uptr<Terminator> &&te);
+		// Removes blocks from the block list. Nothing may still jump to them.
+		// Their declarations own variables that other blocks may still use,
+		// so those move to the entry block instead.
+		void remove_blocks(const Set<BasicBlock *> &dead_blocks);
 		virtual std::string to_string() const override;
 
 		class Builder {
@@ -617,4 +795,11 @@ namespace IR::program {
 	};
 
 	Vec<Uptr<ExternalFunction>> generate_std_functions();
+
+	// A function whose frame has room for `frame_size` bytes of objects
+	// claims it from the runtime's frame stack on entry, keeping the start
+	// of its frame in `frame_base` and the stack pointer to go back to in
+	// `saved_pointer`, and gives it back before each return.
+	std::string generate_frame_entry(const std::string &frame_base, const std::string &saved_pointer, int64_t frame_size, const std::string &prefix);
+	std::string generate_frame_exit(const std::string &saved_pointer, const std::string &prefix);
 }
\ No newline at end of file
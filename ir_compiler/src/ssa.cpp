@@ -0,0 +1,465 @@
+#include "ssa.h"
+
+namespace IR::ssa {
+	using namespace std_alias;
+	using namespace IR::program;
+
+	InstructionPhi *as_phi(const Uptr<Instruction> &inst) {
+		return dynamic_cast<InstructionPhi *>(inst.get());
+	}
+
+	Vec<BasicBlock *> get_distinct_successors(BasicBlock &block) {
+		Vec<BasicBlock *> result;
+		for (auto [succ, probability] : block.get_successors()) {
+			if (std::find(result.begin(), result.end(), succ) == result.end()) {
+				result.push_back(succ);
+			}
+		}
+		return result;
+	}
+
+	// Phis at the entry block would have no value for the function's own
+	// entry, so if something jumps back to the entry block, start the
+	// function with an empty block instead.
+	void ensure_entry_has_no_predecessors(IRFunction &ir_function) {
+		const Vec<Uptr<BasicBlock>> &blocks = ir_function.get_blocks();
+		BasicBlock *entry = blocks[0].get();
+		bool has_predecessor = std::any_of(
+			blocks.begin(),
+			blocks.end(),
+			[&](const Uptr<BasicBlock> &block) {
+				Vec<BasicBlock *> succs = get_distinct_successors(*block);
+				return std::find(succs.begin(), succs.end(), entry) != succs.end();
+			}
+		);
+		if (!has_predecessor) return;
+		BasicBlock *new_entry = ir_function.insert_block(0, "ssaentry", {}, mkuptr<TerminatorBranchOne>(make_bound_ref(entry)));
+		if (const Opt<int64_t> &count = entry->get_execution_count()) {
+			new_entry->set_execution_count(*count);
+		}
+	}
+
+	// Cytron et al.'s algorithm, as formulated by Cooper, Harvey & Kennedy
+	Vec<Set<int>> find_dominance_frontiers(const cfg::FlowGraph &graph, const Vec<int> &idoms) {
+		int num_blocks = graph.successors.size();
+		Vec<Set<int>> frontiers(num_blocks);
+		for (int block = 0; block < num_blocks; ++block) {
+			if (graph.predecessors[block].size() < 2 || idoms[block] == -1) continue;
+			for (int pred : graph.predecessors[block]) {
+				if (idoms[pred] == -1) continue;
+				int runner = pred;
+				while (runner != idoms[block]) {
+					frontiers[runner].insert(block);
+					runner = idoms[runner];
+				}
+			}
+		}
+		return frontiers;
+	}
+
+	struct Renamer {
+		IRFunction &ir_function;
+		const cfg::FlowGraph &graph;
+		Vec<Vec<int>> dominator_tree_children;
+		Map<Variable *, Vec<Variable *>> versions; // original -> stack of the versions currently in scope
+		SsaForm &ssa_form;
+
+		Variable *get_current_version(Variable *var) {
+			auto versions_it = this->versions.find(var);
+			if (versions_it == this->versions.end() || versions_it->second.empty()) {
+				return var;
+			}
+			return versions_it->second.back();
+		}
+
+		void rename(int block_index) {
+			BasicBlock &block = *this->ir_function.get_blocks()[block_index];
+			Vec<Variable *> vars_written;
+			for (Uptr<Instruction> &inst : block.get_inst()) {
+				if (!as_phi(inst)) {
+					Vec<ItemRef<Variable> *> refs;
+					inst->collect_variable_refs(refs);
+					for (ItemRef<Variable> *ref : refs) {
+						if (Opt<Variable *> var = ref->get_referent()) {
+							ref->bind(this->get_current_version(*var));
+						}
+					}
+				}
+				if (Opt<ItemRef<Variable> *> dest = inst->get_dest_ref()) {
+					Variable *original = (*dest)->get_referent().value();
+					Variable *version = this->ir_function.add_generated_variable(original->get_name() + "_", original->get_type());
+					this->ssa_form.original_vars.insert({ version, original });
+					this->versions[original].push_back(version);
+					vars_written.push_back(original);
+					(*dest)->bind(version);
+				}
+			}
+			Vec<ItemRef<Variable> *> terminator_refs;
+			block.get_terminator()->collect_variable_refs(terminator_refs);
+			for (ItemRef<Variable> *ref : terminator_refs) {
+				if (Opt<Variable *> var = ref->get_referent()) {
+					ref->bind(this->get_current_version(*var));
+				}
+			}
+
+			// fill in the values our successors' phis take when coming from us
+			for (BasicBlock *succ : get_distinct_successors(block)) {
+				for (Uptr<Instruction> &inst : succ->get_inst()) {
+					InstructionPhi *phi = as_phi(inst);
+					if (!phi) break;
+					for (auto &[pred, value] : phi->get_incoming()) {
+						if (pred != &block) continue;
+						ItemRef<Variable> &ref = dynamic_cast<ItemRef<Variable> &>(*value);
+						ref.bind(this->get_current_version(ref.get_referent().value()));
+					}
+				}
+			}
+
+			for (int child : this->dominator_tree_children[block_index]) {
+				this->rename(child);
+			}
+			for (Variable *var : vars_written) {
+				this->versions[var].pop_back();
+			}
+		}
+	};
+
+	SsaForm construct_ssa(IRFunction &ir_function) {
+		SsaForm ssa_form;
+		if (ir_function.get_blocks().empty()) {
+			return ssa_form;
+		}
+		cfg::remove_unreachable_blocks(ir_function);
+		ensure_entry_has_no_predecessors(ir_function);
+
+		const Vec<Uptr<BasicBlock>> &blocks = ir_function.get_blocks();
+		int num_blocks = blocks.size();
+		cfg::FlowGraph graph = cfg::make_flow_graph(blocks);
+		Vec<int> idoms = cfg::find_immediate_dominators(graph.successors);
+		Vec<Set<int>> frontiers = find_dominance_frontiers(graph, idoms);
+
+		// find where each variable is written, and which variables are read
+		// in a block before that block writes them
+		Vec<Variable *> vars_in_order;
+		Map<Variable *, Set<int>> write_blocks;
+		Set<Variable *> global_vars;
+		for (int i = 0; i < num_blocks; ++i) {
+			Set<Variable *> written_here;
+			auto note_reads = [&](const Vec<Variable *> &vars_read) {
+				for (Variable *var : vars_read) {
+					if (!written_here.count(var)) {
+						global_vars.insert(var);
+					}
+				}
+			};
+			for (const Uptr<Instruction> &inst : blocks[i]->get_inst()) {
+				Vec<Variable *> vars_read;
+				inst->collect_variables_read(vars_read);
+				note_reads(vars_read);
+				if (Opt<Variable *> var = inst->get_variable_written()) {
+					written_here.insert(*var);
+					auto [write_blocks_it, is_new] = write_blocks.insert({ *var, {} });
+					write_blocks_it->second.insert(i);
+					if (is_new) {
+						vars_in_order.push_back(*var);
+					}
+				}
+			}
+			Vec<Variable *> vars_read;
+			blocks[i]->get_terminator()->collect_variables_read(vars_read);
+			note_reads(vars_read);
+		}
+
+		// place phis at the iterated dominance frontier of each variable's writes
+		Vec<int> num_phis(num_blocks, 0);
+		for (Variable *var : vars_in_order) {
+			if (!global_vars.count(var)) continue;
+			Set<int> has_phi;
+			Vec<int> worklist(write_blocks[var].begin(), write_blocks[var].end());
+			while (!worklist.empty()) {
+				int block = worklist.back();
+				worklist.pop_back();
+				for (int frontier_block : frontiers[block]) {
+					if (!has_phi.insert(frontier_block).second) continue;
+					Uptr<InstructionPhi> phi = mkuptr<InstructionPhi>(make_bound_ref(var));
+					Set<int> preds_seen;
+					for (int pred : graph.predecessors[frontier_block]) {
+						if (preds_seen.insert(pred).second) {
+							phi->get_incoming().emplace_back(blocks[pred].get(), make_bound_ref(var));
+						}
+					}
+					Vec<Uptr<Instruction>> &insts = blocks[frontier_block]->get_inst();
+					insts.insert(insts.begin() + num_phis[frontier_block], mv(phi));
+					num_phis[frontier_block] += 1;
+					if (!write_blocks[var].count(frontier_block)) {
+						worklist.push_back(frontier_block);
+					}
+				}
+			}
+		}
+
+		Renamer renamer { ir_function, graph, Vec<Vec<int>>(num_blocks), {}, ssa_form };
+		for (int block = 1; block < num_blocks; ++block) {
+			renamer.dominator_tree_children[idoms[block]].push_back(block);
+		}
+		renamer.rename(0);
+		return ssa_form;
+	}
+
+	Uptr<Expr> copy_value(Expr &value, Variable *var) {
+		if (NumberLiteral *num = dynamic_cast<NumberLiteral *>(&value)) {
+			return mkuptr<NumberLiteral>(num->get_value());
+		}
+		return make_bound_ref(var);
+	}
+
+	// a new block on the edge from pred to succ
+	BasicBlock *split_edge(IRFunction &ir_function, BasicBlock *pred, BasicBlock *succ) {
+		const Vec<Uptr<BasicBlock>> &blocks = ir_function.get_blocks();
+		int succ_index = 0;
+		while (blocks[succ_index].get() != succ) {
+			succ_index += 1;
+		}
+		BasicBlock *edge = ir_function.insert_block(succ_index, "ssaedge", {}, mkuptr<TerminatorBranchOne>(make_bound_ref(succ)));
+		cfg::redirect_edge(*pred, succ, edge);
+		const Opt<int64_t> &pred_count = pred->get_execution_count();
+		const Opt<int64_t> &succ_count = succ->get_execution_count();
+		if (pred_count && succ_count) {
+			edge->set_execution_count(std::min(*pred_count, *succ_count));
+		}
+		return edge;
+	}
+
+	// the variables live at the end of each block, where a phi reads its
+	// values at the end of the predecessors they come from
+	Vec<Set<Variable *>> find_live_out(const Vec<Uptr<BasicBlock>> &blocks, const cfg::FlowGraph &graph) {
+		int num_blocks = blocks.size();
+		Vec<Set<Variable *>> upward_exposed(num_blocks);
+		Vec<Set<Variable *>> written(num_blocks);
+		Vec<Map<int, Set<Variable *>>> phi_reads(num_blocks); // block -> predecessor -> what the phis read from it
+		for (int i = 0; i < num_blocks; ++i) {
+			auto note_reads = [&](const Vec<Variable *> &vars_read) {
+				for (Variable *var : vars_read) {
+					if (!written[i].count(var)) {
+						upward_exposed[i].insert(var);
+					}
+				}
+			};
+			for (const Uptr<Instruction> &inst : blocks[i]->get_inst()) {
+				if (InstructionPhi *phi = as_phi(inst)) {
+					for (auto &[pred, value] : phi->get_incoming()) {
+						Vec<Variable *> vars_read;
+						value->collect_variables_read(vars_read);
+						phi_reads[i][graph.block_index_map.at(pred)].insert(vars_read.begin(), vars_read.end());
+					}
+				} else {
+					Vec<Variable *> vars_read;
+					inst->collect_variables_read(vars_read);
+					note_reads(vars_read);
+				}
+				if (Opt<Variable *> var = inst->get_variable_written()) {
+					written[i].insert(*var);
+				}
+			}
+			Vec<Variable *> vars_read;
+			blocks[i]->get_terminator()->collect_variables_read(vars_read);
+			note_reads(vars_read);
+		}
+
+		Vec<Set<Variable *>> live_in(num_blocks);
+		Vec<Set<Variable *>> live_out(num_blocks);
+		bool changed = true;
+		while (changed) {
+			changed = false;
+			for (int i = num_blocks - 1; i >= 0; --i) {
+				Set<Variable *> out;
+				for (int succ : graph.successors[i]) {
+					out.insert(live_in[succ].begin(), live_in[succ].end());
+					if (auto reads_it = phi_reads[succ].find(i); reads_it != phi_reads[succ].end()) {
+						out.insert(reads_it->second.begin(), reads_it->second.end());
+					}
+				}
+				Set<Variable *> in = upward_exposed[i];
+				for (Variable *var : out) {
+					if (!written[i].count(var)) {
+						in.insert(var);
+					}
+				}
+				if (in.size() != live_in[i].size() || out.size() != live_out[i].size()) {
+					changed = true;
+				}
+				live_in[i] = mv(in);
+				live_out[i] = mv(out);
+			}
+		}
+		return live_out;
+	}
+
+	// Picks the name each version gets once the function is out of SSA
+	// form. A version goes back to being its original variable unless it
+	// is live where another version of that variable is written (or the
+	// other way around), which can happen once a pass has replaced reads
+	// of one variable with another that holds the same value. Those
+	// versions keep their own names.
+	Map<Variable *, Variable *> choose_names(IRFunction &ir_function, const SsaForm &ssa_form) {
+		const Vec<Uptr<BasicBlock>> &blocks = ir_function.get_blocks();
+		auto get_original = [&](Variable *var) {
+			auto original_it = ssa_form.original_vars.find(var);
+			return original_it == ssa_form.original_vars.end() ? var : original_it->second;
+		};
+		cfg::FlowGraph graph = cfg::make_flow_graph(blocks);
+		Vec<Set<Variable *>> live_out = find_live_out(blocks, graph);
+
+		Set<Pair<Variable *, Variable *>> interferences;
+		auto note_write = [&](Variable *var, const Set<Variable *> &live) {
+			Variable *original = get_original(var);
+			for (Variable *live_var : live) {
+				if (live_var != var && get_original(live_var) == original) {
+					interferences.insert({ std::min(var, live_var), std::max(var, live_var) });
+				}
+			}
+		};
+		Vec<Variable *> versions_in_order;
+		for (int i = 0; i < blocks.size(); ++i) {
+			Set<Variable *> live = live_out[i];
+			Vec<Variable *> vars_read;
+			blocks[i]->get_terminator()->collect_variables_read(vars_read);
+			live.insert(vars_read.begin(), vars_read.end());
+			const Vec<Uptr<Instruction>> &insts = blocks[i]->get_inst();
+			for (auto it = insts.rbegin(); it != insts.rend() && !as_phi(*it); ++it) {
+				if (Opt<Variable *> var = (*it)->get_variable_written()) {
+					note_write(*var, live);
+					live.erase(*var);
+				}
+				vars_read.clear();
+				(*it)->collect_variables_read(vars_read);
+				live.insert(vars_read.begin(), vars_read.end());
+			}
+			// the phis all write at once at the start of the block
+			for (const Uptr<Instruction> &inst : insts) {
+				if (!as_phi(inst)) break;
+				note_write(inst->get_variable_written().value(), live);
+			}
+			for (const Uptr<Instruction> &inst : insts) {
+				if (Opt<Variable *> var = inst->get_variable_written()) {
+					versions_in_order.push_back(*var);
+				}
+			}
+		}
+
+		Map<Variable *, Variable *> names;
+		Map<Variable *, Vec<Variable *>> sharing_names; // original -> the versions that go back to it
+		for (Variable *version : versions_in_order) {
+			Variable *original = get_original(version);
+			auto [sharing_it, is_new] = sharing_names.insert({ original, { original } });
+			Vec<Variable *> &sharing = sharing_it->second;
+			bool interferes = std::any_of(
+				sharing.begin(),
+				sharing.end(),
+				[&](Variable *other) { return interferences.count({ std::min(version, other), std::max(version, other) }) > 0; }
+			);
+			if (interferes) {
+				names.insert({ version, version });
+			} else {
+				names.insert({ version, original });
+				sharing.push_back(version);
+			}
+		}
+		return names;
+	}
+
+	void destruct_ssa(IRFunction &ir_function, const SsaForm &ssa_form) {
+		Map<Variable *, Variable *> names = choose_names(ir_function, ssa_form);
+		auto get_name = [&](Variable *var) {
+			auto name_it = names.find(var);
+			return name_it == names.end() ? var : name_it->second;
+		};
+
+		Vec<BasicBlock *> blocks;
+		for (const Uptr<BasicBlock> &block : ir_function.get_blocks()) {
+			blocks.push_back(block.get());
+		}
+		for (BasicBlock *block : blocks) {
+			// the copies each predecessor has to do: (variable, value)
+			Vec<BasicBlock *> preds;
+			Map<BasicBlock *, Vec<Pair<Variable *, Expr *>>> copies;
+			for (Uptr<Instruction> &inst : block->get_inst()) {
+				InstructionPhi *phi = as_phi(inst);
+				if (!phi) break;
+				Variable *dest = get_name(phi->get_variable_written().value());
+				for (auto &[pred, value] : phi->get_incoming()) {
+					ItemRef<Variable> *ref = dynamic_cast<ItemRef<Variable> *>(value.get());
+					if (ref && get_name(ref->get_referent().value()) == dest) continue;
+					auto [copies_it, is_new] = copies.insert({ pred, {} });
+					if (is_new) {
+						preds.push_back(pred);
+					}
+					copies_it->second.emplace_back(dest, value.get());
+				}
+			}
+
+			for (BasicBlock *pred : preds) {
+				Vec<Pair<Variable *, Expr *>> &pred_copies = copies.at(pred);
+				BasicBlock *copy_block = pred;
+				if (get_distinct_successors(*pred).size() > 1) {
+					copy_block = split_edge(ir_function, pred, block);
+				}
+				Vec<Uptr<Instruction>> &insts = copy_block->get_inst();
+
+				// The copies happen all at once, so if one of them reads a
+				// variable that another one writes, go through temporaries.
+				Set<Variable *> dests;
+				for (auto [dest, value] : pred_copies) {
+					dests.insert(dest);
+				}
+				bool needs_temps = false;
+				Vec<Variable *> sources;
+				for (auto [dest, value] : pred_copies) {
+					Variable *source = nullptr;
+					if (ItemRef<Variable> *ref = dynamic_cast<ItemRef<Variable> *>(value)) {
+						source = get_name(ref->get_referent().value());
+						needs_temps = needs_temps || dests.count(source);
+					}
+					sources.push_back(source);
+				}
+				Vec<Uptr<Instruction>> temp_copies;
+				for (int i = 0; i < pred_copies.size(); ++i) {
+					auto [dest, value] = pred_copies[i];
+					if (needs_temps) {
+						Variable *temp = ir_function.add_generated_variable("ssacopy", dest->get_type());
+						insts.push_back(mkuptr<InstructionAssignment>(make_bound_ref(temp), copy_value(*value, sources[i])));
+						temp_copies.push_back(mkuptr<InstructionAssignment>(make_bound_ref(dest), make_bound_ref(temp)));
+					} else {
+						insts.push_back(mkuptr<InstructionAssignment>(make_bound_ref(dest), copy_value(*value, sources[i])));
+					}
+				}
+				for (Uptr<Instruction> &copy : temp_copies) {
+					insts.push_back(mv(copy));
+				}
+			}
+
+			Vec<Uptr<Instruction>> &insts = block->get_inst();
+			insts.erase(
+				std::remove_if(insts.begin(), insts.end(), [](const Uptr<Instruction> &inst) { return as_phi(inst) != nullptr; }),
+				insts.end()
+			);
+		}
+
+		// rename every version
+		for (const Uptr<BasicBlock> &block : ir_function.get_blocks()) {
+			Vec<ItemRef<Variable> *> refs;
+			for (Uptr<Instruction> &inst : block->get_inst()) {
+				inst->collect_variable_refs(refs);
+				if (Opt<ItemRef<Variable> *> dest = inst->get_dest_ref()) {
+					refs.push_back(*dest);
+				}
+			}
+			block->get_terminator()->collect_variable_refs(refs);
+			for (ItemRef<Variable> *ref : refs) {
+				if (Opt<Variable *> var = ref->get_referent()) {
+					ref->bind(get_name(*var));
+				}
+			}
+		}
+	}
+}
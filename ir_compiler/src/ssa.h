@@ -0,0 +1,30 @@
+#pragma once
+#include "std_alias.h"
+#include "program.h"
+#include "cfg.h"
+
+// Static single assignment form for IR functions (Cytron et al.).
+//
+// construct_ssa gives every write its own version of the variable, and puts
+// phis at the iterated dominance frontier of each variable's writes. It only
+// places phis for variables that are read in a different block than the one
+// that writes them (semi-pruned SSA). Reads with no write before them keep
+// the original variable, which is how parameters are read.
+//
+// destruct_ssa maps every version back to its original variable, except
+// for versions whose live ranges overlap with another version of the same
+// variable (which passes that reuse values can cause), which keep their own
+// names. The phi values that don't end up with the phi's own name turn into
+// copies on the incoming edges, splitting critical edges where needed.
+namespace IR::ssa {
+	using namespace std_alias;
+	using namespace IR::program;
+
+	struct SsaForm {
+		Map<Variable *, Variable *> original_vars; // version -> the variable it is a version of
+	};
+
+	SsaForm construct_ssa(IRFunction &ir_function);
+
+	void destruct_ssa(IRFunction &ir_function, const SsaForm &ssa_form);
+}
@@ -14,6 +14,12 @@ namespace IR::code_gen::target_arch {
 
 	std::string new_variable_names(IRFunction &fun, BasicBlock& bb);
 
+	// Marks the start of a function's cold blocks. The L1 backend moves
+	// everything after a label ending in this name into .text.unlikely. It
+	// doesn't start with an underscore, so it can't collide with a mangled
+	// block name.
+	const std::string COLD_REGION_LABEL = "coldregion";
+
     // Modifies a program so that its label names are all globally unique
 	// and always start with an underscore (so that non-underscore names can
 	// be used by the generator)
@@ -1,126 +1,293 @@
 #include "tracer.h"
 
 namespace IR::tracer {
-    Vec<Vec<double>> make_link_matrix(const Vec<Uptr<BasicBlock>> &blocks) {
+    // A row-stochastic transition matrix in compressed sparse row form. With
+    // damping, every row also has a small chance of jumping to any node, which
+    // is kept as one number per row instead of filling in the matrix.
+    struct TransitionMatrix {
+        int num_nodes;
+        Vec<int> row_offsets; // row r's entries are at [row_offsets[r], row_offsets[r + 1])
+        Vec<int> columns;
+        Vec<double> values;
+        Vec<double> jump_chances; // the chance of jumping from each row to any particular node
+    };
+
+    TransitionMatrix make_link_matrix(const Vec<Uptr<BasicBlock>> &blocks) {
         // map each BasicBlock * to its index
         Map<BasicBlock *, int> block_index_map;
         for (int i = 0; i < blocks.size(); ++i) {
             block_index_map.insert_or_assign(blocks[i].get(), i);
         }
 
-        Vec<Vec<double>> result;
+        TransitionMatrix result;
+        result.num_nodes = blocks.size();
+        result.row_offsets.push_back(0);
         for (const Uptr<BasicBlock> &block : blocks) {
-            // make a vector of zeros
-            Vec<double> &row = result.emplace_back(blocks.size());
-
             // add all its children
-            int n = block->get_successors().size();
             for (auto [succ, priority] : block->get_successors()) {
-                row[block_index_map.at(succ)] = priority;
+                result.columns.push_back(block_index_map.at(succ));
+                result.values.push_back(priority);
             }
+            result.row_offsets.push_back(result.columns.size());
         }
+        result.jump_chances.resize(blocks.size(), 0.0);
         return result;
     }
 
-    void incorporate_damping_factor(Vec<Vec<double>> &transition_matrix, double damping_factor) {
-        int num_nodes = transition_matrix.size();
+    void incorporate_damping_factor(TransitionMatrix &transition_matrix, double damping_factor) {
+        int num_nodes = transition_matrix.num_nodes;
         double rand_chance = 1.0 - damping_factor; // the chance of jumping to a random node
         double distributed_rand_chance = rand_chance / num_nodes; // the chance of jumping to any particular node
-        for (Vec<double> &row : transition_matrix) {
-            for (double &element : row) {
-                element *= damping_factor;
-                element += distributed_rand_chance;
+        for (int r = 0; r < num_nodes; ++r) {
+            double sum = rand_chance;
+            for (int i = transition_matrix.row_offsets[r]; i < transition_matrix.row_offsets[r + 1]; ++i) {
+                transition_matrix.values[i] *= damping_factor;
+                sum += transition_matrix.values[i];
             }
 
             // normalize probabilities
-            double sum = 0.0;
-            for (double element : row) {
-                sum += element;
-            }
             // sum is guaranteed to not be zero because of the damping factor
-            for (double & element : row) {
-                element /= sum;
+            for (int i = transition_matrix.row_offsets[r]; i < transition_matrix.row_offsets[r + 1]; ++i) {
+                transition_matrix.values[i] /= sum;
             }
+            transition_matrix.jump_chances[r] = distributed_rand_chance / sum;
         }
     }
 
-    void transpose(Vec<Vec<double>> &matrix) {
-        int n = matrix.size();
-        for (int r = 0; r < n; ++r) {
-            for (int c = r + 1; c < n; ++c) {
-                std::swap(matrix[r][c], matrix[c][r]);
+    // Finds the stationary distribution s = P^T s by power iteration. The
+    // damping factor makes the chain irreducible and aperiodic, so this
+    // converges geometrically at a rate of at least the damping factor.
+    Vec<double> find_steady_state(const TransitionMatrix &transition_matrix) {
+        const double convergence_threshold = 1e-12;
+        const int max_iterations = 1000;
+
+        int num_nodes = transition_matrix.num_nodes;
+        Vec<double> state(num_nodes, 1.0 / num_nodes);
+        Vec<double> next_state(num_nodes);
+        for (int iteration = 0; iteration < max_iterations; ++iteration) {
+            // every node gets the same share of the random jumps
+            double jump_share = 0.0;
+            for (int r = 0; r < num_nodes; ++r) {
+                jump_share += state[r] * transition_matrix.jump_chances[r];
+            }
+            std::fill(next_state.begin(), next_state.end(), jump_share);
+
+            for (int r = 0; r < num_nodes; ++r) {
+                for (int i = transition_matrix.row_offsets[r]; i < transition_matrix.row_offsets[r + 1]; ++i) {
+                    next_state[transition_matrix.columns[i]] += state[r] * transition_matrix.values[i];
+                }
+            }
+
+            // renormalize so that roundoff error doesn't accumulate
+            double sum = 0.0;
+            for (double x : next_state) {
+                sum += x;
+            }
+            double difference = 0.0;
+            for (int r = 0; r < num_nodes; ++r) {
+                next_state[r] /= sum;
+                difference += std::abs(next_state[r] - state[r]);
+            }
+            state.swap(next_state);
+            if (difference < convergence_threshold) {
+                break;
             }
         }
+        return state;
     }
 
-    Vec<double> find_steady_state(Vec<Vec<double>> transition_matrix) {
-        int num_nodes = transition_matrix.size();
-        Vec<Vec<double>> &mat = transition_matrix;
+    // Static branch prediction, after Ball & Larus and Wu & Larus. Each
+    // heuristic that applies to a branch gives a probability that the true
+    // edge is taken, and the probabilities are combined with Dempster-Shafer.
+    namespace heuristics {
+        const double LOOP_BRANCH = 0.88; // loop back-edges are taken
+        const double LOOP_EXIT = 0.80; // loop exits are not taken
+        const double NO_RETURN = 0.999; // paths that only report an error are not taken
+        const double POINTER = 0.60; // pointers are usually not null
+        const double OPCODE = 0.84; // x < 0 is usually false
+        const double EQUALITY = 0.66; // x = y is usually false
+        const double RETURN = 0.72; // edges straight to a return are not taken
+    }
 
-        // convert the transition matrix P into A = I - P^T,
-        transpose(mat);
-        for (int r = 0; r < num_nodes; ++r) {
-            for (int c = 0; c < num_nodes; ++c) {
-                mat[r][c] *= -1.0;
-                if (r == c) {
-                    mat[r][c] += 1.0;
-                }
+    double combine_probabilities(double a, double b) {
+        return a * b / (a * b + (1.0 - a) * (1.0 - b));
+    }
+
+    // whether the block calls one of the runtime's error reporters, which
+    // never return
+    bool calls_error_function(BasicBlock &block) {
+        for (const Uptr<Instruction> &inst : block.get_inst()) {
+            InstructionAssignment *assignment = dynamic_cast<InstructionAssignment *>(inst.get());
+            if (!assignment) continue;
+            FunctionCall *call = dynamic_cast<FunctionCall *>(&assignment->get_source());
+            if (!call) continue;
+            ItemRef<ExternalFunction> *callee = dynamic_cast<ItemRef<ExternalFunction> *>(&call->get_callee());
+            if (callee && (callee->get_ref_name() == "tensor-error" || callee->get_ref_name() == "tuple-error")) {
+                return true;
             }
         }
+        return false;
+    }
 
-        // solve A * s = 0
+    // finds the blocks that can only lead to an error report
+    Vec<bool> find_no_return_blocks(const Vec<Uptr<BasicBlock>> &blocks, const Vec<Vec<int>> &successors) {
+        int num_blocks = blocks.size();
+        Vec<bool> is_no_return(num_blocks, false);
+        for (int i = 0; i < num_blocks; ++i) {
+            is_no_return[i] = calls_error_function(*blocks[i]);
+        }
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (int i = 0; i < num_blocks; ++i) {
+                if (is_no_return[i] || successors[i].empty()) continue;
+                bool all_no_return = std::all_of(
+                    successors[i].begin(),
+                    successors[i].end(),
+                    [&](int succ) { return is_no_return[succ]; }
+                );
+                if (all_no_return) {
+                    is_no_return[i] = true;
+                    changed = true;
+                }
+            }
+        }
+        return is_no_return;
+    }
 
-        // add one equation to stipulate that the steady state vector be normalized
-        // mat.emplace_back(num_nodes);
+    bool is_return_block(BasicBlock &block) {
+        Terminator *terminator = block.get_terminator().get();
+        return dynamic_cast<TerminatorReturnVoid *>(terminator) || dynamic_cast<TerminatorReturnVar *>(terminator);
+    }
 
-        // iterate through the pivots
-        for (int p = 0; p < num_nodes - 1; ++p) {
-            // ignore the first p rows
+    // finds the comparison that computes the branch's condition in its block
+    const BinaryOperation *find_condition_definition(BasicBlock &block, const TerminatorBranchTwo &branch) {
+        ItemRef<Variable> *condition = dynamic_cast<ItemRef<Variable> *>(&branch.get_condition());
+        if (!condition || !condition->get_referent()) {
+            return nullptr;
+        }
+        const Vec<Uptr<Instruction>> &insts = block.get_inst();
+        for (auto it = insts.rbegin(); it != insts.rend(); ++it) {
+            InstructionAssignment *assignment = dynamic_cast<InstructionAssignment *>(it->get());
+            if (!assignment || !assignment->get_dest()) continue;
+            if (assignment->get_dest().value()->get_referent() != condition->get_referent()) continue;
+            return dynamic_cast<const BinaryOperation *>(&assignment->get_source());
+        }
+        return nullptr;
+    }
 
-            // find the row with the largest element in the pivot column
-            auto max_row_it = std::max_element(
-                mat.begin() + p,
-                mat.end(),
-                [p](const Vec<double> &a, const Vec<double> &b) { return a[p] < b[p]; }
-            );
+    bool is_pointer(Expr &expr) {
+        ItemRef<Variable> *var_ref = dynamic_cast<ItemRef<Variable> *>(&expr);
+        if (!var_ref || !var_ref->get_referent()) {
+            return false;
+        }
+        Type &type = var_ref->get_referent().value()->get_type();
+        return type.get_a_type() == A_type::tuple
+            || (type.get_a_type() == A_type::int64 && type.get_num_dimensions() > 0);
+    }
 
-            // move the maximum row to the pth row, to serve as the pivot row
-            max_row_it->swap(mat[p]);
+    bool is_number(Expr &expr, int64_t value) {
+        NumberLiteral *num = dynamic_cast<NumberLiteral *>(&expr);
+        return num && num->get_value() == value;
+    }
 
-            // normalize the pivot row
-            double pivot_value = mat[p][p];
-            assert(pivot_value != 0.0);
-            for (double &element : mat[p]) {
-                element /= pivot_value;
+    // the chance that the comparison is true, if a pointer or opcode
+    // heuristic applies to it
+    Opt<double> predict_comparison(const BinaryOperation &comparison) {
+        Operator op = comparison.get_op();
+        Expr &lhs = comparison.get_lhs();
+        Expr &rhs = comparison.get_rhs();
+        if (op == Operator::eq) {
+            if (is_pointer(lhs) || is_pointer(rhs)) {
+                return 1.0 - heuristics::POINTER;
             }
+            return 1.0 - heuristics::EQUALITY;
+        }
+        // comparisons of x against zero: x < 0 and x <= 0 are usually false
+        if ((op == Operator::lt || op == Operator::le) && is_number(rhs, 0)) {
+            return 1.0 - heuristics::OPCODE;
+        }
+        if ((op == Operator::gt || op == Operator::ge) && is_number(lhs, 0)) {
+            return 1.0 - heuristics::OPCODE;
+        }
+        if ((op == Operator::gt || op == Operator::ge) && is_number(rhs, 0)) {
+            return heuristics::OPCODE;
+        }
+        if ((op == Operator::lt || op == Operator::le) && is_number(lhs, 0)) {
+            return heuristics::OPCODE;
+        }
+        return {};
+    }
 
-            // eliminate all other rows
-            for (int r = 0; r < num_nodes; ++r) {
-                if (r == p) continue;
-                double first_value = mat[r][p];
-                for (int c = p; c < num_nodes; ++ c) {
-                    mat[r][c] -= first_value * mat[p][c];
-                }
+    void estimate_branch_probabilities(const Vec<Uptr<BasicBlock>> &blocks) {
+        // a profile has already measured the real probabilities
+        if (blocks.empty() || blocks[0]->get_execution_count()) {
+            return;
+        }
 
-                // although it should already be zero, roundoff error might happen
-                mat[r][p] = 0;
+        int num_blocks = blocks.size();
+        cfg::FlowGraph graph = cfg::make_flow_graph(blocks);
+        const Vec<Vec<int>> &successors = graph.successors;
+        Vec<int> idoms = cfg::find_immediate_dominators(successors);
+        Vec<Set<int>> loops_containing(num_blocks); // the headers of the loops containing each block
+        for (const cfg::NaturalLoop &loop : cfg::find_natural_loops(graph, idoms)) {
+            for (int body_block : loop.body) {
+                loops_containing[body_block].insert(loop.header);
             }
         }
 
-        // extract the solutions from the free variable
-        Vec<double> solution;
-        double sum = 0.0;
-        for (const Vec<double> &row : mat) {
-            double solution_component = -row.back();
-            solution.push_back(solution_component);
-            sum += solution_component;
-        }
-        solution.back() = 1.0;
-        sum += 1.0;
-        for (double &x : solution) {
-            x /= sum;
+        Vec<bool> is_no_return = find_no_return_blocks(blocks, successors);
+
+        for (int i = 0; i < num_blocks; ++i) {
+            BasicBlock &block = *blocks[i];
+            TerminatorBranchTwo *branch = dynamic_cast<TerminatorBranchTwo *>(block.get_terminator().get());
+            Vec<Pair<BasicBlock *, double>> &succs = block.get_successors();
+            if (!branch || succs.size() != 2 || succs[0].first == succs[1].first) continue;
+            int true_succ = successors[i][0];
+            int false_succ = successors[i][1];
+
+            // each heuristic that applies gives the chance that the true edge is taken
+            Vec<double> predictions;
+            if (is_no_return[true_succ] != is_no_return[false_succ]) {
+                predictions.push_back(is_no_return[true_succ] ? 1.0 - heuristics::NO_RETURN : heuristics::NO_RETURN);
+            }
+            bool true_is_back_edge = cfg::dominates(idoms, true_succ, i);
+            bool false_is_back_edge = cfg::dominates(idoms, false_succ, i);
+            if (true_is_back_edge != false_is_back_edge) {
+                predictions.push_back(true_is_back_edge ? heuristics::LOOP_BRANCH : 1.0 - heuristics::LOOP_BRANCH);
+            } else {
+                auto exits_loop = [&](int succ) {
+                    for (int header : loops_containing[i]) {
+                        if (!loops_containing[succ].count(header)) return true;
+                    }
+                    return false;
+                };
+                bool true_exits = exits_loop(true_succ);
+                bool false_exits = exits_loop(false_succ);
+                if (true_exits != false_exits) {
+                    predictions.push_back(true_exits ? 1.0 - heuristics::LOOP_EXIT : heuristics::LOOP_EXIT);
+                }
+            }
+            if (const BinaryOperation *comparison = find_condition_definition(block, *branch)) {
+                if (Opt<double> prediction = predict_comparison(*comparison)) {
+                    predictions.push_back(*prediction);
+                }
+            }
+            bool true_returns = is_return_block(*blocks[true_succ]);
+            bool false_returns = is_return_block(*blocks[false_succ]);
+            if (true_returns != false_returns) {
+                predictions.push_back(true_returns ? 1.0 - heuristics::RETURN : heuristics::RETURN);
+            }
+
+            // keep the default guess if nothing applies
+            if (predictions.empty()) continue;
+            double true_chance = 0.5;
+            for (double prediction : predictions) {
+                true_chance = combine_probabilities(true_chance, prediction);
+            }
+            succs[0].second = true_chance;
+            succs[1].second = 1.0 - true_chance;
         }
-        return solution;
     }
 
     struct BbEdge {
@@ -138,16 +305,42 @@ namespace IR::tracer {
 
     Vec<Trace> trace_cfg(const Vec<Uptr<BasicBlock>> &blocks) {
         // calculate how popular each block is its "rank"
-        Vec<Vec<double>> transition_matrix = make_link_matrix(blocks);
+        TransitionMatrix transition_matrix = make_link_matrix(blocks);
         incorporate_damping_factor(transition_matrix, 0.85);
-        Vec<double> block_ranks = find_steady_state(mv(transition_matrix));
+        Vec<double> block_ranks = find_steady_state(transition_matrix);
+
+        // if the blocks were profiled, their measured counts are better
+        // estimates of how often they run than their ranks
+        bool is_profiled = std::all_of(
+            blocks.begin(),
+            blocks.end(),
+            [](const Uptr<BasicBlock> &block) { return block->get_execution_count().has_value(); }
+        );
+
+        // Cold blocks are the ones that only lead to a runtime error, or that
+        // never ran in the profile. They're kept out of the hot traces so they
+        // can be emitted together at the end of the function.
+        cfg::FlowGraph graph = cfg::make_flow_graph(blocks);
+        const Map<BasicBlock *, int> &block_index_map = graph.block_index_map;
+        Vec<bool> is_cold = find_no_return_blocks(blocks, graph.successors);
+        if (is_profiled) {
+            for (int i = 0; i < blocks.size(); ++i) {
+                if (blocks[i]->get_execution_count().value() == 0) {
+                    is_cold[i] = true;
+                }
+            }
+        }
 
         // store all the edges by their weight
         std::priority_queue<BbEdge> edges;
         for (int from_index = 0; from_index < blocks.size(); ++from_index) {
             BasicBlock *from_block = blocks[from_index].get();
+            double frequency = is_profiled
+                ? from_block->get_execution_count().value()
+                : block_ranks[from_index];
             for (const auto [succ_block, priority] : from_block->get_successors()) {
-                double weight = priority * block_ranks[from_index];
+                if (is_cold[from_index] != is_cold[block_index_map.at(succ_block)]) continue;
+                double weight = priority * frequency;
                 edges.emplace(weight, from_block, succ_block);
             }
         }
@@ -208,6 +401,16 @@ namespace IR::tracer {
         );
         traces.erase(remove_begin, traces.end());
 
+        // move the cold traces after the hot ones
+        for (Trace &trace : traces) {
+            trace.is_cold = is_cold[block_index_map.at(trace.block_sequence.front())];
+        }
+        std::stable_partition(
+            traces.begin(),
+            traces.end(),
+            [](const Trace &trace) { return !trace.is_cold; }
+        );
+
         return traces;
     }
 }
\ No newline at end of file
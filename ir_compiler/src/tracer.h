@@ -1,11 +1,13 @@
 #pragma once
 #include "std_alias.h"
 #include "program.h"
+#include "cfg.h"
 
 #include <iostream>
 #include <iomanip>
 #include <queue>
 #include <algorithm>
+#include <cmath>
 #include <assert.h>
 
 namespace IR::tracer {
@@ -13,5 +15,10 @@ namespace IR::tracer {
     using namespace IR::program;
 
 
+    // replaces the default two-way branch probabilities with ones predicted
+    // from the shape of the CFG and the branch conditions; does nothing to
+    // functions that have a profile
+    void estimate_branch_probabilities(const Vec<Uptr<BasicBlock>> &blocks);
+
     Vec<Trace> trace_cfg(const Vec<Uptr<BasicBlock>> &blocks);
 }
\ No newline at end of file
@@ -58,4 +58,105 @@ namespace L1 {
 	std::string FunctionName::toString() const {
 		return std::string("FunctionName @") + this->name;
 	}
+
+	// RuntimeFunction methods
+
+	RuntimeFunction::RuntimeFunction(const std::string &name) : name {name} {}
+
+	std::string RuntimeFunction::toString() const {
+		return std::string("RuntimeFunction ") + this->name;
+	}
+
+	// MemoryLocation methods
+
+	MemoryLocation::MemoryLocation(Register *base, Number *offset) : base {base}, offset {offset} {}
+
+	std::string MemoryLocation::toString() const {
+		return std::string("mem ") + this->base->str + " " + std::to_string(this->offset->value);
+	}
+
+	// Operator methods
+
+	Operator::Operator(const std::string &op) : op {op} {}
+
+	std::string Operator::toString() const {
+		return this->op;
+	}
+
+	// Instruction methods
+
+	std::string Instruction_ret::toString() const {
+		return "return";
+	}
+
+	Instruction_assignment::Instruction_assignment(Item *destination, Item *source) :
+		source {source}, destination {destination}
+	{}
+
+	std::string Instruction_assignment::toString() const {
+		return this->destination->toString() + " <- " + this->source->toString();
+	}
+
+	Instruction_arithmetic::Instruction_arithmetic(Item *destination, Operator *op, Item *source) :
+		destination {destination}, op {op}, source {source}
+	{}
+
+	std::string Instruction_arithmetic::toString() const {
+		return this->destination->toString() + " " + this->op->op + " " + this->source->toString();
+	}
+
+	Instruction_increment::Instruction_increment(Register *destination, bool is_increment) :
+		destination {destination}, is_increment {is_increment}
+	{}
+
+	std::string Instruction_increment::toString() const {
+		return this->destination->toString() + (this->is_increment ? "++" : "--");
+	}
+
+	Instruction_compare_assignment::Instruction_compare_assignment(Register *destination, Item *lhs, Operator *op, Item *rhs) :
+		destination {destination}, lhs {lhs}, op {op}, rhs {rhs}
+	{}
+
+	std::string Instruction_compare_assignment::toString() const {
+		return this->destination->toString() + " <- " + this->lhs->toString()
+			+ " " + this->op->op + " " + this->rhs->toString();
+	}
+
+	Instruction_cjump::Instruction_cjump(Item *lhs, Operator *op, Item *rhs, Label *label) :
+		lhs {lhs}, op {op}, rhs {rhs}, label {label}
+	{}
+
+	std::string Instruction_cjump::toString() const {
+		return "cjump " + this->lhs->toString() + " " + this->op->op + " "
+			+ this->rhs->toString() + " " + this->label->toString();
+	}
+
+	Instruction_label::Instruction_label(Label *label) : label {label} {}
+
+	std::string Instruction_label::toString() const {
+		return this->label->toString();
+	}
+
+	Instruction_goto::Instruction_goto(Label *label) : label {label} {}
+
+	std::string Instruction_goto::toString() const {
+		return "goto " + this->label->toString();
+	}
+
+	Instruction_call::Instruction_call(Item *callee, int64_t num_arguments) :
+		callee {callee}, num_arguments {num_arguments}
+	{}
+
+	std::string Instruction_call::toString() const {
+		return "call " + this->callee->toString() + " " + std::to_string(this->num_arguments);
+	}
+
+	Instruction_leaq::Instruction_leaq(Register *destination, Register *base, Register *offset, int64_t scale) :
+		destination {destination}, base {base}, offset {offset}, scale {scale}
+	{}
+
+	std::string Instruction_leaq::toString() const {
+		return this->destination->toString() + " @ " + this->base->toString() + " "
+			+ this->offset->toString() + " " + std::to_string(this->scale);
+	}
 }
@@ -62,6 +62,35 @@ namespace L1 {
 		virtual std::string toString() const override;
 	};
 
+	// one of the runtime functions (print, input, allocate, tuple-error,
+	// tensor-error), which are called with the native C calling convention
+	struct RuntimeFunction : Item {
+		std::string name;
+
+		RuntimeFunction(const std::string &name);
+
+		virtual std::string toString() const override;
+	};
+
+	// "mem x M" in the grammar
+	struct MemoryLocation : Item {
+		Register *base;
+		Number *offset;
+
+		MemoryLocation(Register *base, Number *offset);
+
+		virtual std::string toString() const override;
+	};
+
+	// an arithmetic, shift, or comparison operator, kept in its L1 spelling
+	struct Operator : Item {
+		std::string op;
+
+		Operator(const std::string &op);
+
+		virtual std::string toString() const override;
+	};
+
 	/*
 	 * Instruction interface.
 	 */
@@ -70,11 +99,101 @@ namespace L1 {
 	/*
 	 * Instructions.
 	 */
-	struct Instruction_ret : Instruction {};
+	struct Instruction_ret : Instruction {
+		virtual std::string toString() const override;
+	};
 
+	// w <- s, w <- mem x M, and mem x M <- s
 	struct Instruction_assignment : Instruction {
 		Item *source;
 		Item *destination;
+
+		Instruction_assignment(Item *destination, Item *source);
+
+		virtual std::string toString() const override;
+	};
+
+	// w aop t, w sop sx, w sop N, mem x M += t, w += mem x M, etc
+	struct Instruction_arithmetic : Instruction {
+		Item *destination;
+		Operator *op;
+		Item *source;
+
+		Instruction_arithmetic(Item *destination, Operator *op, Item *source);
+
+		virtual std::string toString() const override;
+	};
+
+	// w ++ and w --
+	struct Instruction_increment : Instruction {
+		Register *destination;
+		bool is_increment;
+
+		Instruction_increment(Register *destination, bool is_increment);
+
+		virtual std::string toString() const override;
+	};
+
+	// w <- t cmp t
+	struct Instruction_compare_assignment : Instruction {
+		Register *destination;
+		Item *lhs;
+		Operator *op;
+		Item *rhs;
+
+		Instruction_compare_assignment(Register *destination, Item *lhs, Operator *op, Item *rhs);
+
+		virtual std::string toString() const override;
+	};
+
+	// cjump t cmp t label
+	struct Instruction_cjump : Instruction {
+		Item *lhs;
+		Operator *op;
+		Item *rhs;
+		Label *label;
+
+		Instruction_cjump(Item *lhs, Operator *op, Item *rhs, Label *label);
+
+		virtual std::string toString() const override;
+	};
+
+	struct Instruction_label : Instruction {
+		Label *label;
+
+		Instruction_label(Label *label);
+
+		virtual std::string toString() const override;
+	};
+
+	struct Instruction_goto : Instruction {
+		Label *label;
+
+		Instruction_goto(Label *label);
+
+		virtual std::string toString() const override;
+	};
+
+	// call u N, where u is a FunctionName, a Register, or a RuntimeFunction
+	struct Instruction_call : Instruction {
+		Item *callee;
+		int64_t num_arguments;
+
+		Instruction_call(Item *callee, int64_t num_arguments);
+
+		virtual std::string toString() const override;
+	};
+
+	// w @ w w E
+	struct Instruction_leaq : Instruction {
+		Register *destination;
+		Register *base;
+		Register *offset;
+		int64_t scale;
+
+		Instruction_leaq(Register *destination, Register *base, Register *offset, int64_t scale);
+
+		virtual std::string toString() const override;
 	};
 
 	/*
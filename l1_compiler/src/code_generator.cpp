@@ -1,12 +1,350 @@
 #include <string>
 #include <iostream>
 #include <fstream>
+#include <map>
+#include <assert.h>
+#include <stdint.h>
 
 #include <code_generator.h>
 
 using namespace std;
 
 namespace L1 {
+	// Calling convention
+	//
+	// Calls between L1 functions use the native x86 `call`/`ret` pair so that
+	// the return address is pushed and popped by the hardware and the
+	// return-stack predictor always guesses the right return target. The
+	// caller places stack arguments (arguments 7 and up) at `mem rsp -8`,
+	// `mem rsp -16`, etc before the call, and `call u N` reserves that space
+	// before pushing the return address. At the callee's entry the return
+	// address is at 0(%rsp) and the last argument is at 8(%rsp). The callee
+	// frees its locals and the stack arguments with `ret $n`, so the caller
+	// never has to clean up after a call.
+	//
+	// Runtime functions are plain C functions and are called natively without
+	// any stack arguments.
+
+	const int64_t NUM_ARG_REGISTERS = 6;
+	const int64_t WORD_SIZE = 8;
+
+	static const map<RegisterID, string> register_names_64 {
+		{ RegisterID::rax, "rax" },
+		{ RegisterID::rbx, "rbx" },
+		{ RegisterID::rcx, "rcx" },
+		{ RegisterID::rdx, "rdx" },
+		{ RegisterID::rdi, "rdi" },
+		{ RegisterID::rsi, "rsi" },
+		{ RegisterID::r8, "r8" },
+		{ RegisterID::r9, "r9" },
+		{ RegisterID::r10, "r10" },
+		{ RegisterID::r11, "r11" },
+		{ RegisterID::r12, "r12" },
+		{ RegisterID::r13, "r13" },
+		{ RegisterID::r14, "r14" },
+		{ RegisterID::r15, "r15" },
+		{ RegisterID::rbp, "rbp" },
+		{ RegisterID::rsp, "rsp" }
+	};
+
+	static const map<RegisterID, string> register_names_8 {
+		{ RegisterID::rax, "al" },
+		{ RegisterID::rbx, "bl" },
+		{ RegisterID::rcx, "cl" },
+		{ RegisterID::rdx, "dl" },
+		{ RegisterID::rdi, "dil" },
+		{ RegisterID::rsi, "sil" },
+		{ RegisterID::r8, "r8b" },
+		{ RegisterID::r9, "r9b" },
+		{ RegisterID::r10, "r10b" },
+		{ RegisterID::r11, "r11b" },
+		{ RegisterID::r12, "r12b" },
+		{ RegisterID::r13, "r13b" },
+		{ RegisterID::r14, "r14b" },
+		{ RegisterID::r15, "r15b" },
+		{ RegisterID::rbp, "bpl" }
+	};
+
+	static const map<string, string> runtime_function_names {
+		{ "print", "print" },
+		{ "input", "input" },
+		{ "allocate", "allocate" },
+		{ "tuple-error", "tuple_error" }
+	};
+
+	// tensor-error is overloaded on its number of arguments, and each
+	// overload is a separate function in the runtime
+	static const map<int64_t, string> tensor_error_names {
+		{ 1, "tensor_error_null" },
+		{ 3, "tensor_error_one_dim" },
+		{ 4, "tensor_error_multi_dim" }
+	};
+
+	string get_runtime_symbol(const RuntimeFunction *runtime, int64_t num_arguments) {
+		if (runtime->name == "tensor-error") {
+			auto it = tensor_error_names.find(num_arguments);
+			if (it == tensor_error_names.end()) {
+				cerr << "Error: tensor-error can't take " << num_arguments << " arguments\n";
+				exit(1);
+			}
+			return it->second;
+		}
+		return runtime_function_names.at(runtime->name);
+	}
+
+	string to_label_name(const string &name) {
+		return "_" + name;
+	}
+
+	string to_asm(const Register *reg) {
+		return "%" + register_names_64.at(reg->id);
+	}
+
+	string to_asm_8(const Register *reg) {
+		return "%" + register_names_8.at(reg->id);
+	}
+
+	// x86-64 immediates are 32 bits, sign-extended, except in movabsq
+	bool fits_in_immediate(int64_t value) {
+		return value >= INT32_MIN && value <= INT32_MAX;
+	}
+
+	// converts an operand to its AT&T representation
+	string to_asm(const Item *item) {
+		if (const Register *reg = dynamic_cast<const Register *>(item)) {
+			return to_asm(reg);
+		} else if (const Number *num = dynamic_cast<const Number *>(item)) {
+			if (!fits_in_immediate(num->value)) {
+				// the L2 compiler moves these into a variable first
+				cerr << "Error: " << num->value << " doesn't fit in an immediate operand\n";
+				exit(1);
+			}
+			return "$" + to_string(num->value);
+		} else if (const Label *label = dynamic_cast<const Label *>(item)) {
+			return "$" + to_label_name(label->name);
+		} else if (const FunctionName *function = dynamic_cast<const FunctionName *>(item)) {
+			return "$" + to_label_name(function->name);
+		} else if (const MemoryLocation *mem = dynamic_cast<const MemoryLocation *>(item)) {
+			return to_string(mem->offset->value) + "(" + to_asm(mem->base) + ")";
+		} else {
+			cerr << "Error: can't convert this item to assembly: " << item->toString() << "\n";
+			exit(1);
+		}
+	}
+
+	// the number of bytes a function pops off of the stack when it returns,
+	// not counting its locals
+	int64_t get_stack_arg_bytes(int64_t num_arguments) {
+		if (num_arguments <= NUM_ARG_REGISTERS) {
+			return 0;
+		}
+		return WORD_SIZE * (num_arguments - NUM_ARG_REGISTERS);
+	}
+
+	// the condition code suffix for "lhs op rhs", e.g. "l" for "<"
+	string get_condition_code(const string &op) {
+		if (op == "<") {
+			return "l";
+		} else if (op == "<=") {
+			return "le";
+		} else if (op == "=") {
+			return "e";
+		} else {
+			cerr << "Error: unknown comparison operator " << op << "\n";
+			exit(1);
+		}
+	}
+
+	// the condition code suffix for "rhs op lhs", e.g. "g" for "<"
+	string get_flipped_condition_code(const string &op) {
+		if (op == "<") {
+			return "g";
+		} else if (op == "<=") {
+			return "ge";
+		} else if (op == "=") {
+			return "e";
+		} else {
+			cerr << "Error: unknown comparison operator " << op << "\n";
+			exit(1);
+		}
+	}
+
+	bool evaluate_comparison(int64_t lhs, const string &op, int64_t rhs) {
+		if (op == "<") {
+			return lhs < rhs;
+		} else if (op == "<=") {
+			return lhs <= rhs;
+		} else {
+			return lhs == rhs;
+		}
+	}
+
+	// Emits a comparison of lhs and rhs and returns the condition code under
+	// which the comparison holds. `cmpq` can't take an immediate as its
+	// second operand, so if the lhs is a constant the operands are swapped.
+	string generate_comparison(ostream &o, const Item *lhs, const Operator *op, const Item *rhs) {
+		if (dynamic_cast<const Number *>(lhs)) {
+			o << "\tcmpq " << to_asm(lhs) << ", " << to_asm(rhs) << "\n";
+			return get_flipped_condition_code(op->op);
+		}
+		o << "\tcmpq " << to_asm(rhs) << ", " << to_asm(lhs) << "\n";
+		return get_condition_code(op->op);
+	}
+
+	// a constant that doesn't fit in an immediate goes into a register with
+	// movabsq, or into memory as two 32-bit halves
+	void generate_assignment(ostream &o, const Instruction_assignment *inst) {
+		const Number *num = dynamic_cast<const Number *>(inst->source);
+		if (!num || fits_in_immediate(num->value)) {
+			o << "\tmovq " << to_asm(inst->source) << ", " << to_asm(inst->destination) << "\n";
+		} else if (dynamic_cast<const Register *>(inst->destination)) {
+			o << "\tmovabsq $" << num->value << ", " << to_asm(inst->destination) << "\n";
+		} else {
+			const MemoryLocation *mem = dynamic_cast<const MemoryLocation *>(inst->destination);
+			uint64_t bits = static_cast<uint64_t>(num->value);
+			string base = "(" + to_asm(mem->base) + ")";
+			o << "\tmovl $" << (bits & 0xffffffff) << ", " << mem->offset->value << base << "\n";
+			o << "\tmovl $" << (bits >> 32) << ", " << mem->offset->value + 4 << base << "\n";
+		}
+	}
+
+	void generate_arithmetic(ostream &o, const Instruction_arithmetic *inst) {
+		static const map<string, string> mnemonics {
+			{ "+=", "addq" },
+			{ "-=", "subq" },
+			{ "*=", "imulq" },
+			{ "&=", "andq" },
+			{ "<<=", "salq" },
+			{ ">>=", "sarq" }
+		};
+		const string &mnemonic = mnemonics.at(inst->op->op);
+		string source;
+		if ((inst->op->op == "<<=" || inst->op->op == ">>=") && dynamic_cast<const Register *>(inst->source)) {
+			// variable shifts can only use the low byte of rcx
+			source = to_asm_8(dynamic_cast<const Register *>(inst->source));
+		} else {
+			source = to_asm(inst->source);
+		}
+		o << "\t" << mnemonic << " " << source << ", " << to_asm(inst->destination) << "\n";
+	}
+
+	void generate_call(ostream &o, const Instruction_call *inst) {
+		if (const RuntimeFunction *runtime = dynamic_cast<const RuntimeFunction *>(inst->callee)) {
+			o << "\tcall " << get_runtime_symbol(runtime, inst->num_arguments) << "\n";
+			return;
+		}
+
+		// reserve the space holding the stack arguments; the call itself
+		// pushes the return address right below them
+		int64_t stack_arg_bytes = get_stack_arg_bytes(inst->num_arguments);
+		if (stack_arg_bytes > 0) {
+			o << "\tsubq $" << stack_arg_bytes << ", %rsp\n";
+		}
+		if (const FunctionName *function = dynamic_cast<const FunctionName *>(inst->callee)) {
+			o << "\tcall " << to_label_name(function->name) << "\n";
+		} else if (const Register *reg = dynamic_cast<const Register *>(inst->callee)) {
+			o << "\tcall *" << to_asm(reg) << "\n";
+		} else {
+			cerr << "Error: can't call " << inst->callee->toString() << "\n";
+			exit(1);
+		}
+	}
+
+	void generate_return(ostream &o, const Function *f) {
+		if (f->num_locals > 0) {
+			o << "\taddq $" << WORD_SIZE * f->num_locals << ", %rsp\n";
+		}
+		int64_t stack_arg_bytes = get_stack_arg_bytes(f->num_arguments);
+		if (stack_arg_bytes > 0) {
+			o << "\tretq $" << stack_arg_bytes << "\n";
+		} else {
+			o << "\tretq\n";
+		}
+	}
+
+	void generate_instruction(ostream &o, const Function *f, const Instruction *inst) {
+		if (dynamic_cast<const Instruction_ret *>(inst)) {
+			generate_return(o, f);
+		} else if (const Instruction_assignment *i = dynamic_cast<const Instruction_assignment *>(inst)) {
+			generate_assignment(o, i);
+		} else if (const Instruction_arithmetic *i = dynamic_cast<const Instruction_arithmetic *>(inst)) {
+			generate_arithmetic(o, i);
+		} else if (const Instruction_increment *i = dynamic_cast<const Instruction_increment *>(inst)) {
+			o << "\t" << (i->is_increment ? "inc" : "dec") << " " << to_asm(i->destination) << "\n";
+		} else if (const Instruction_compare_assignment *i = dynamic_cast<const Instruction_compare_assignment *>(inst)) {
+			const Number *lhs_num = dynamic_cast<const Number *>(i->lhs);
+			const Number *rhs_num = dynamic_cast<const Number *>(i->rhs);
+			if (lhs_num && rhs_num) {
+				bool result = evaluate_comparison(lhs_num->value, i->op->op, rhs_num->value);
+				o << "\tmovq $" << (result ? 1 : 0) << ", " << to_asm(i->destination) << "\n";
+			} else {
+				string condition_code = generate_comparison(o, i->lhs, i->op, i->rhs);
+				o << "\tset" << condition_code << " " << to_asm_8(i->destination) << "\n";
+				o << "\tmovzbq " << to_asm_8(i->destination) << ", " << to_asm(i->destination) << "\n";
+			}
+		} else if (const Instruction_cjump *i = dynamic_cast<const Instruction_cjump *>(inst)) {
+			const Number *lhs_num = dynamic_cast<const Number *>(i->lhs);
+			const Number *rhs_num = dynamic_cast<const Number *>(i->rhs);
+			if (lhs_num && rhs_num) {
+				if (evaluate_comparison(lhs_num->value, i->op->op, rhs_num->value)) {
+					o << "\tjmp " << to_label_name(i->label->name) << "\n";
+				}
+			} else {
+				string condition_code = generate_comparison(o, i->lhs, i->op, i->rhs);
+				o << "\tj" << condition_code << " " << to_label_name(i->label->name) << "\n";
+			}
+		} else if (const Instruction_label *i = dynamic_cast<const Instruction_label *>(inst)) {
+			o << to_label_name(i->label->name) << ":\n";
+		} else if (const Instruction_goto *i = dynamic_cast<const Instruction_goto *>(inst)) {
+			o << "\tjmp " << to_label_name(i->label->name) << "\n";
+		} else if (const Instruction_call *i = dynamic_cast<const Instruction_call *>(inst)) {
+			generate_call(o, i);
+		} else if (const Instruction_leaq *i = dynamic_cast<const Instruction_leaq *>(inst)) {
+			o << "\tlea (" << to_asm(i->base) << ", " << to_asm(i->offset) << ", " << i->scale << "), "
+				<< to_asm(i->destination) << "\n";
+		} else {
+			cerr << "Error: can't generate code for " << inst->toString() << "\n";
+			exit(1);
+		}
+	}
+
+	// The IR compiler puts a function's cold blocks (error paths and blocks
+	// that never ran in a profile) after all of its hot code, behind a label
+	// ending in this name.
+	const string COLD_REGION_LABEL_SUFFIX = "coldregion";
+
+	bool ends_with(const string &s, const string &suffix) {
+		return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+	}
+
+	// whether the label starts a cold region that can be moved to another
+	// section: control can't fall through into it
+	bool starts_cold_region(const Instruction *prev_inst, const Instruction *inst) {
+		const Instruction_label *label_inst = dynamic_cast<const Instruction_label *>(inst);
+		return label_inst
+			&& ends_with(label_inst->label->name, COLD_REGION_LABEL_SUFFIX)
+			&& (dynamic_cast<const Instruction_goto *>(prev_inst) || dynamic_cast<const Instruction_ret *>(prev_inst));
+	}
+
+	void generate_function(ostream &o, const Function *f) {
+		o << "\t.text\n";
+		o << to_label_name(f->name) << ":\n";
+		if (f->num_locals > 0) {
+			o << "\tsubq $" << WORD_SIZE * f->num_locals << ", %rsp\n";
+		}
+		const Instruction *prev_inst = nullptr;
+		bool in_cold_region = false;
+		for (const Instruction *inst : f->instructions) {
+			if (!in_cold_region && starts_cold_region(prev_inst, inst)) {
+				// keep the cold code out of the hot code's cache lines
+				o << "\t.section .text.unlikely,\"ax\",@progbits\n";
+				in_cold_region = true;
+			}
+			generate_instruction(o, f, inst);
+			prev_inst = inst;
+		}
+	}
+
 	void generate_code(Program p){
 		/*
 		 * Open the output file.
@@ -17,7 +355,28 @@ namespace L1 {
 		/*
 		 * Generate target code
 		 */
-		//TODO
+		// `go` is called by the runtime; it saves the callee-saved registers
+		// and enters the program through a native call
+		outputFile << "\t.text\n"
+			<< "\t.globl go\n"
+			<< "go:\n"
+			<< "\tpushq %rbx\n"
+			<< "\tpushq %rbp\n"
+			<< "\tpushq %r12\n"
+			<< "\tpushq %r13\n"
+			<< "\tpushq %r14\n"
+			<< "\tpushq %r15\n"
+			<< "\tcall " << to_label_name(p.entryPointLabel) << "\n"
+			<< "\tpopq %r15\n"
+			<< "\tpopq %r14\n"
+			<< "\tpopq %r13\n"
+			<< "\tpopq %r12\n"
+			<< "\tpopq %rbp\n"
+			<< "\tpopq %rbx\n"
+			<< "\tretq\n";
+		for (const Function *f : p.functions) {
+			generate_function(outputFile, f);
+		}
 
 		/*
 		 * Close the output file.
@@ -68,7 +68,11 @@ int main(
 	 */
 	if (verbose) {
 		for (auto f : p.functions) {
-			//TODO
+			std::cout << "(@" << f->name << " " << f->num_arguments << " " << f->num_locals << "\n";
+			for (auto inst : f->instructions) {
+				std::cout << "\t" << inst->toString() << "\n";
+			}
+			std::cout << ")\n";
 		}
 	}
 
@@ -280,9 +280,11 @@ namespace L1 {
 	> {};
 
 	// "cmp" in the grammar
+	// "<=" must be tried before "<" so that the shorter operator doesn't
+	// steal the prefix of the longer one
 	struct comparison_operator : sor<
-		str_lt,
 		str_le,
+		str_lt,
 		str_eq
 	> {};
 
@@ -359,7 +361,7 @@ namespace L1 {
 		spaces,
 		str_arrow,
 		spaces,
-		register_writable_rule
+		source_value_rule
 	> {};
 
 	struct Instruction_arithmetic_operation_rule : seq<
@@ -458,6 +460,10 @@ namespace L1 {
 		label
 	> {};
 
+	struct Instruction_label_rule : seq<
+		label
+	> {};
+
 	struct Instruction_goto_rule : seq<
 		str_goto,
 		spaces,
@@ -538,8 +544,11 @@ namespace L1 {
 		lea_factor
 	> {};
 
+	// the comparison assignment must come before the plain assignment, since
+	// "w <- t" is a prefix of "w <- t cmp t"
 	struct Instruction_rule : sor<
 		with_lookahead<Instruction_return_rule>,
+		with_lookahead<Instruction_assignment_compare_rule>,
 		with_lookahead<Instruction_assignment_rule>,
 		with_lookahead<Instruction_memory_read_rule>,
 		with_lookahead<Instruction_memory_write_rule>,
@@ -550,9 +559,8 @@ namespace L1 {
 		with_lookahead<Instruction_plus_read_memory_rule>,
 		with_lookahead<Instruction_minus_write_memory_rule>,
 		with_lookahead<Instruction_minus_read_memory_rule>,
-		with_lookahead<Instruction_assignment_compare_rule>,
 		with_lookahead<Instruction_cjump_rule>,
-		with_lookahead<label>,
+		with_lookahead<Instruction_label_rule>,
 		with_lookahead<Instruction_goto_rule>,
 		with_lookahead<Instruction_call_rule>,
 		with_lookahead<Instruction_call_print_rule>,
@@ -575,10 +583,16 @@ namespace L1 {
 		>
 	> {};
 
+	// distinct from function_name_rule so that the action creating a new
+	// Function only fires for function headers
+	struct Function_header_name_rule : function_name_rule {};
+
+	struct Entry_point_name_rule : function_name_rule {};
+
 	struct Function_rule: seq<
 		seq<spaces, one< '(' >>,
 		seps_with_comments,
-		seq<spaces, function_name_rule>,
+		seq<spaces, Function_header_name_rule>,
 		seps_with_comments,
 		seq<spaces, argument_number>,
 		seps_with_comments,
@@ -600,7 +614,7 @@ namespace L1 {
 		seps_with_comments,
 		seq<spaces, one< '(' >>,
 		seps_with_comments,
-		function_name_rule,
+		Entry_point_name_rule,
 		seps_with_comments,
 		Functions_rule,
 		seps_with_comments,
@@ -612,67 +626,45 @@ namespace L1 {
 		entry_point_rule
 	> {};
 
+
 	/*
 	 * Actions attached to grammar rules.
 	 */
 	template<typename Rule>
 	struct action : pegtl::nothing<Rule> {};
 
+	// pops the most recently parsed item, which must be of the given type
+	template<typename T>
+	T *pop_item() {
+		assert(!parsed_items.empty());
+		T *item = dynamic_cast<T *>(parsed_items.back());
+		assert(item != nullptr);
+		parsed_items.pop_back();
+		return item;
+	}
+
+	void add_instruction(Program &p, Instruction *inst) {
+		assert(!p.functions.empty());
+		p.functions.back()->instructions.push_back(inst);
+	}
+
 	template<> struct action<register_rule> {
 		template<typename Input>
 		static void apply(const Input &in, Program &p) {
-			// std::cout << "saw a register |" << in.string() << "|" << std::endl;
 			parsed_items.push_back(new Register(in.string()));
 		}
 	};
 
-	template<> struct action<name> {
-		template<typename Input>
-		static void apply(const Input &in, Program &p) {
-			// std::cout << "saw a name |" << in.string() << "|" << std::endl;
-		}
-	};
-
 	template<> struct action<number> {
 		template<typename Input>
 		static void apply(const Input &in, Program &p) {
-			// std::cout << "saw a number |" << in.string() << "|" << std::endl;
-			parsed_items.push_back(new Number(std::stoll(in.string())) );
+			parsed_items.push_back(new Number(std::stoll(in.string())));
 		}
 	};
 
-	// template<> struct action<tensor_error_arg_number> {
-	// 	template<typename Input>
-	// 	static void apply(const Input &in, Program &p) {
-	// 		std::cout << "saw a tensor_error_arg_number |" << in.string() << "|" << std::endl;
-	// 	}
-	// };
-
-	// template<> struct action<lea_factor> {
-	// 	template<typename Input>
-	// 	static void apply(const Input &in, Program &p) {
-	// 		std::cout << "saw a lea_factor |" << in.string() << "|" << std::endl;
-	// 	}
-	// };
-
-	// template<> struct action<argument_number> {
-	// 	template<typename Input>
-	// 	static void apply(const Input &in, Program &p) {
-	// 		std::cout << "saw a argument_number |" << in.string() << "|" << std::endl;
-	// 	}
-	// };
-
-	// template<> struct action<local_number> {
-	// 	template<typename Input>
-	// 	static void apply(const Input &in, Program &p) {
-	// 		std::cout << "saw a local_number |" << in.string() << "|" << std::endl;
-	// 	}
-	// };
-
 	template<> struct action<label> {
 		template<typename Input>
 		static void apply(const Input &in, Program &p) {
-			// std::cout << "saw a label |" << in.string() << "|" << std::endl;
 			parsed_items.push_back(new Label(in.string().substr(1)));
 		}
 	};
@@ -680,379 +672,275 @@ namespace L1 {
 	template<> struct action<function_name_rule> {
 		template<typename Input>
 		static void apply(const Input &in, Program &p) {
-			// std::cout << "saw a function name |" << in.string() << "|" << std::endl;
 			parsed_items.push_back(new FunctionName(in.string().substr(1)));
 		}
 	};
 
-	// template<> struct action<register_rax_rule> {
-	// 	template<typename Input>
-	// 	static void apply(const Input &in, Program &p) {
-	// 		std::cout << "saw a register_rax_rule | " << in.string() << std::endl;
-	// 	}
-	// };
-
-	// template<> struct action<register_rbx_rule> {
-	// 	template<typename Input>
-	// 	static void apply(const Input &in, Program &p) {
-	// 		std::cout << "saw a register_rbx_rule | " << in.string() << std::endl;
-	// 	}
-	// };
-
-	// template<> struct action<register_rcx_rule> {
-	// 	template<typename Input>
-	// 	static void apply(const Input &in, Program &p) {
-	// 		std::cout << "saw a register_rcx_rule | " << in.string() << std::endl;
-	// 	}
-	// };
-
-	// template<> struct action<register_rdx_rule> {
-	// 	template<typename Input>
-	// 	static void apply(const Input &in, Program &p) {
-	// 		std::cout << "saw a register_rdx_rule | " << in.string() << std::endl;
-	// 	}
-	// };
-
-	// template<> struct action<register_rdi_rule> {
-	// 	template<typename Input>
-	// 	static void apply(const Input &in, Program &p) {
-	// 		std::cout << "saw a struct register_rdi_rule | " << in.string() << std::endl;
-	// 	}
-	// };
-
-	// template<> struct action<register_rsi_rule> {
-	// 	template<typename Input>
-	// 	static void apply(const Input &in, Program &p) {
-	// 		std::cout << "saw a register_rsi_rule | " << in.string() << std::endl;
-	// 	}
-	// };
-
-	// template<> struct action<register_r8_rule> {
-	// 	template<typename Input>
-	// 	static void apply(const Input &in, Program &p) {
-	// 		std::cout << "saw a register_r8_rule | " << in.string() << std::endl;
-	// 	}
-	// };
-
-	// template<> struct action<register_r9_rule> {
-	// 	template<typename Input>
-	// 	static void apply(const Input &in, Program &p) {
-	// 		std::cout << "saw a register_r9_rule | " << in.string() << std::endl;
-	// 	}
-	// };
-
-	// template<> struct action<register_r10_rule> {
-	// 	template<typename Input>
-	// 	static void apply(const Input &in, Program &p) {
-	// 		std::cout << "saw a register_r10_rule | " << in.string() << std::endl;
-	// 	}
-	// };
-
-	// template<> struct action<register_r11_rule> {
-	// 	template<typename Input>
-	// 	static void apply(const Input &in, Program &p) {
-	// 		std::cout << "saw a register_r11_rule | " << in.string() << std::endl;
-	// 	}
-	// };
-
-	// template<> struct action<register_r12_rule> {
-	// 	template<typename Input>
-	// 	static void apply(const Input &in, Program &p) {
-	// 		std::cout << "saw a register_r12_rule | " << in.string() << std::endl;
-	// 	}
-	// };
-
-	// template<> struct action<register_r13_rule> {
-	// 	template<typename Input>
-	// 	static void apply(const Input &in, Program &p) {
-	// 		std::cout << "saw a register_r13_rule | " << in.string() << std::endl;
-	// 	}
-	// };
-
-	// template<> struct action<register_r14_rule> {
-	// 	template<typename Input>
-	// 	static void apply(const Input &in, Program &p) {
-	// 		std::cout << "saw a register_r14_rule | " << in.string() << std::endl;
-	// 	}
-	// };
-
-	// template<> struct action<register_r15_rule> {
-	// 	template<typename Input>
-	// 	static void apply(const Input &in, Program &p) {
-	// 		std::cout << "saw a register_r15_rule | " << in.string() << std::endl;
-	// 	}
-	// };
-
-	// template<> struct action<register_rbp_rule> {
-	// 	template<typename Input>
-	// 	static void apply(const Input &in, Program &p) {
-	// 		std::cout << "saw a register_rbp_rule | " << in.string() << std::endl;
-	// 	}
-	// };
-
-	// template<> struct action<register_rsp_rule> {
-	// 	template<typename Input>
-	// 	static void apply(const Input &in, Program &p) {
-	// 		std::cout << "saw a register_rsp_rule | " << in.string() << std::endl;
-	// 	}
-	// };
-
-	// template<> struct action<register_shift_rule> {
-	// 	template<typename Input>
-	// 	static void apply(const Input &in, Program &p) {
-	// 		std::cout << "saw a register_shift_rule |" << in.string() << "|" << std::endl;
-	// 	}
-	// };
-
-	// template<> struct action<register_writable_rule> {
-	// 	template<typename Input>
-	// 	static void apply(const Input &in, Program &p) {
-	// 		std::cout << "saw a register_writable_rule |" << in.string() << "|" << std::endl;
-	// 	}
-	// };
-
-	// template<> struct action<register_idk_rule> {
-	// 	template<typename Input>
-	// 	static void apply(const Input &in, Program &p) {
-	// 		std::cout << "saw a register_idk_rule |" << in.string() << "|" << std::endl;
-	// 	}
-	// };
-
-	// template<> struct action<register_any_rule> {
-	// 	template<typename Input>
-	// 	static void apply(const Input &in, Program &p) {
-	// 		std::cout << "saw a register |" << in.string() << "|" << std::endl;
-	// 	}
-	// };
-
-	template<> struct action<call_dest_rule> {
+	template<> struct action<arithmetic_operator> {
 		template<typename Input>
 		static void apply(const Input &in, Program &p) {
-			std::cout << "saw a call_dest |" << in.string() << "|" << std::endl;
+			parsed_items.push_back(new Operator(in.string()));
 		}
 	};
 
-	template<> struct action<arithmetic_value_rule> {
+	template<> struct action<shift_operator> {
 		template<typename Input>
 		static void apply(const Input &in, Program &p) {
-			std::cout << "saw an arithmetic value |" << in.string() << "|" << std::endl;
+			parsed_items.push_back(new Operator(in.string()));
 		}
 	};
 
-	template<> struct action<source_value_rule> {
+	template<> struct action<comparison_operator> {
 		template<typename Input>
 		static void apply(const Input &in, Program &p) {
-			std::cout << "saw a source value |" << in.string() << "|" << std::endl;
+			parsed_items.push_back(new Operator(in.string()));
 		}
 	};
 
-	template<> struct action<arithmetic_operator> {
+	template<> struct action<Entry_point_name_rule> {
 		template<typename Input>
 		static void apply(const Input &in, Program &p) {
-			std::cout << "saw an arithmetic operator |" << in.string() << "|" << std::endl;
+			p.entryPointLabel = in.string().substr(1);
 		}
 	};
 
-	template<> struct action<shift_operator> {
+	template<> struct action<Function_header_name_rule> {
 		template<typename Input>
 		static void apply(const Input &in, Program &p) {
-			std::cout << "saw a shift operator |" << in.string() << "|" << std::endl;
+			Function *f = new Function();
+			f->name = in.string().substr(1);
+			f->num_arguments = 0;
+			f->num_locals = 0;
+			p.functions.push_back(f);
 		}
 	};
 
-	template<> struct action<comparison_operator> {
+	template<> struct action<argument_number> {
+		template<typename Input>
+		static void apply(const Input &in, Program &p) {
+			p.functions.back()->num_arguments = pop_item<Number>()->value;
+		}
+	};
+
+	template<> struct action<local_number> {
 		template<typename Input>
 		static void apply(const Input &in, Program &p) {
-			std::cout << "saw a comparison operator |" << in.string() << "|" << std::endl;
+			p.functions.back()->num_locals = pop_item<Number>()->value;
 		}
 	};
 
 	template<> struct action<Instruction_return_rule> {
 		template<typename Input>
 		static void apply(const Input &in, Program &p) {
-			std::cout << "saw an instruction return |" << in.string() << "|" << std::endl;
+			add_instruction(p, new Instruction_ret());
 		}
 	};
 
 	template<> struct action<Instruction_assignment_rule> {
 		template<typename Input>
 		static void apply(const Input &in, Program &p) {
-			std::cout << "saw an Instruction_assignment_rule |" << in.string() << "|" << std::endl;
+			Item *source = pop_item<Item>();
+			Register *destination = pop_item<Register>();
+			add_instruction(p, new Instruction_assignment(destination, source));
 		}
 	};
 
 	template<> struct action<Instruction_memory_read_rule> {
 		template<typename Input>
 		static void apply(const Input &in, Program &p) {
-			std::cout << "saw an instruction memory read |" << in.string() << "|" << std::endl;
+			Number *offset = pop_item<Number>();
+			Register *base = pop_item<Register>();
+			Register *destination = pop_item<Register>();
+			add_instruction(p, new Instruction_assignment(destination, new MemoryLocation(base, offset)));
 		}
 	};
 
 	template<> struct action<Instruction_memory_write_rule> {
 		template<typename Input>
 		static void apply(const Input &in, Program &p) {
-			std::cout << "saw an instruction memory write |" << in.string() << "|" << std::endl;
+			Item *source = pop_item<Item>();
+			Number *offset = pop_item<Number>();
+			Register *base = pop_item<Register>();
+			add_instruction(p, new Instruction_assignment(new MemoryLocation(base, offset), source));
 		}
 	};
 
+	// w aop t, w sop sx, and w sop N all share the same shape
+	void add_arithmetic_instruction(Program &p) {
+		Item *source = pop_item<Item>();
+		Operator *op = pop_item<Operator>();
+		Register *destination = pop_item<Register>();
+		add_instruction(p, new Instruction_arithmetic(destination, op, source));
+	}
+
+	// mem x M += t and mem x M -= t
+	void add_write_memory_instruction(Program &p, const std::string &op) {
+		Item *source = pop_item<Item>();
+		Number *offset = pop_item<Number>();
+		Register *base = pop_item<Register>();
+		add_instruction(p, new Instruction_arithmetic(new MemoryLocation(base, offset), new Operator(op), source));
+	}
+
+	// w += mem x M and w -= mem x M
+	void add_read_memory_instruction(Program &p, const std::string &op) {
+		Number *offset = pop_item<Number>();
+		Register *base = pop_item<Register>();
+		Register *destination = pop_item<Register>();
+		add_instruction(p, new Instruction_arithmetic(destination, new Operator(op), new MemoryLocation(base, offset)));
+	}
+
 	template<> struct action<Instruction_arithmetic_operation_rule> {
 		template<typename Input>
 		static void apply(const Input &in, Program &p) {
-			std::cout << "saw an instruction arithmetic_operation |" << in.string() << "|" << std::endl;
+			add_arithmetic_instruction(p);
 		}
 	};
 
 	template<> struct action<Instruction_shift_operation_register_rule> {
 		template<typename Input>
 		static void apply(const Input &in, Program &p) {
-			std::cout << "saw a instruction shift operation register |" << in.string() << "|" << std::endl;
+			add_arithmetic_instruction(p);
 		}
 	};
 
 	template<> struct action<Instruction_shift_operation_immediate_rule> {
 		template<typename Input>
 		static void apply(const Input &in, Program &p) {
-			std::cout << "saw a Instruction_shift_operation_immediate_rule |" << in.string() << "|" << std::endl;
+			add_arithmetic_instruction(p);
 		}
 	};
 
 	template<> struct action<Instruction_plus_write_memory_rule> {
 		template<typename Input>
 		static void apply(const Input &in, Program &p) {
-			std::cout << "saw an instruction plus write |" << in.string() << "|" << std::endl;
+			add_write_memory_instruction(p, "+=");
 		}
 	};
 
 	template<> struct action<Instruction_minus_write_memory_rule> {
 		template<typename Input>
 		static void apply(const Input &in, Program &p) {
-			std::cout << "saw a instructon minus write |" << in.string() << "|" << std::endl;
+			add_write_memory_instruction(p, "-=");
 		}
 	};
 
 	template<> struct action<Instruction_plus_read_memory_rule> {
 		template<typename Input>
 		static void apply(const Input &in, Program &p) {
-			std::cout << "saw a instruction plus read |" << in.string() << "|" << std::endl;
+			add_read_memory_instruction(p, "+=");
 		}
 	};
 
 	template<> struct action<Instruction_minus_read_memory_rule> {
 		template<typename Input>
 		static void apply(const Input &in, Program &p) {
-			std::cout << "saw a instruction minus read |" << in.string() << "|" << std::endl;
+			add_read_memory_instruction(p, "-=");
 		}
 	};
 
 	template<> struct action<Instruction_assignment_compare_rule> {
 		template<typename Input>
 		static void apply(const Input &in, Program &p) {
-			std::cout << "saw a Instruction_assignment_compare_rule |" << in.string() << "|" << std::endl;
+			Item *rhs = pop_item<Item>();
+			Operator *op = pop_item<Operator>();
+			Item *lhs = pop_item<Item>();
+			Register *destination = pop_item<Register>();
+			add_instruction(p, new Instruction_compare_assignment(destination, lhs, op, rhs));
 		}
 	};
 
 	template<> struct action<Instruction_cjump_rule> {
 		template<typename Input>
 		static void apply(const Input &in, Program &p) {
-			std::cout << "saw a Instruction_cjump_rule |" << in.string() << "|" << std::endl;
+			Label *label = pop_item<Label>();
+			Item *rhs = pop_item<Item>();
+			Operator *op = pop_item<Operator>();
+			Item *lhs = pop_item<Item>();
+			add_instruction(p, new Instruction_cjump(lhs, op, rhs, label));
+		}
+	};
+
+	template<> struct action<Instruction_label_rule> {
+		template<typename Input>
+		static void apply(const Input &in, Program &p) {
+			add_instruction(p, new Instruction_label(pop_item<Label>()));
 		}
 	};
 
 	template<> struct action<Instruction_goto_rule> {
 		template<typename Input>
 		static void apply(const Input &in, Program &p) {
-			std::cout << "saw a Instruction_goto_rule |" << in.string() << "|" << std::endl;
+			add_instruction(p, new Instruction_goto(pop_item<Label>()));
 		}
 	};
 
 	template<> struct action<Instruction_call_rule> {
 		template<typename Input>
 		static void apply(const Input &in, Program &p) {
-			std::cout << "saw a Instruction_call_rule |" << in.string() << "|" << std::endl;
+			Number *num_arguments = pop_item<Number>();
+			Item *callee = pop_item<Item>();
+			add_instruction(p, new Instruction_call(callee, num_arguments->value));
 		}
 	};
 
 	template<> struct action<Instruction_call_print_rule> {
 		template<typename Input>
 		static void apply(const Input &in, Program &p) {
-			std::cout << "saw a Instruction_call_print_rule |" << in.string() << "|" << std::endl;
+			add_instruction(p, new Instruction_call(new RuntimeFunction("print"), 1));
 		}
 	};
 
 	template<> struct action<Instruction_call_input_rule> {
 		template<typename Input>
 		static void apply(const Input &in, Program &p) {
-			std::cout << "saw a Instruction_call_input_rule |" << in.string() << "|" << std::endl;
+			add_instruction(p, new Instruction_call(new RuntimeFunction("input"), 0));
 		}
 	};
 
 	template<> struct action<Instruction_call_allocate_rule> {
 		template<typename Input>
 		static void apply(const Input &in, Program &p) {
-			std::cout << "saw a Instruction_call_allocate_rule |" << in.string() << "|" << std::endl;
+			add_instruction(p, new Instruction_call(new RuntimeFunction("allocate"), 2));
 		}
 	};
 
 	template<> struct action<Instruction_call_tuple_error_rule> {
 		template<typename Input>
 		static void apply(const Input &in, Program &p) {
-			std::cout << "saw a Instruction_call_tuple_error_rule |" << in.string() << "|" << std::endl;
+			add_instruction(p, new Instruction_call(new RuntimeFunction("tuple-error"), 3));
 		}
 	};
 
 	template<> struct action<Instruction_call_tensor_error_rule> {
 		template<typename Input>
 		static void apply(const Input &in, Program &p) {
-			std::cout << "saw a Instruction_call_tensor_error_rule |" << in.string() << "|" << std::endl;
+			Number *num_arguments = pop_item<Number>();
+			add_instruction(p, new Instruction_call(new RuntimeFunction("tensor-error"), num_arguments->value));
 		}
 	};
 
 	template<> struct action<Instruction_writable_increment_rule> {
 		template<typename Input>
 		static void apply(const Input &in, Program &p) {
-			std::cout << "saw a Instruction_writable_increment_rule |" << in.string() << "|" << std::endl;
+			add_instruction(p, new Instruction_increment(pop_item<Register>(), true));
 		}
 	};
 
 	template<> struct action<Instruction_writable_decrement_rule> {
 		template<typename Input>
 		static void apply(const Input &in, Program &p) {
-			std::cout << "saw a Instruction_writable_decrement_rule |" << in.string() << "|" << std::endl;
+			add_instruction(p, new Instruction_increment(pop_item<Register>(), false));
 		}
 	};
 
 	template<> struct action<Instruction_leaq_rule> {
 		template<typename Input>
 		static void apply(const Input &in, Program &p) {
-			std::cout << "saw a Instruction_leaq_rule |" << in.string() << "|" << std::endl;
-		}
-	};
-
-	template<> struct action<Instruction_rule> {
-		template<typename Input>
-		static void apply(const Input &in, Program &p) {
-			std::cout << "saw a Instruction_rule |" << in.string() << "|" << std::endl;
-		}
-	};
-
-	template<> struct action<Instructions_rule> {
-		template<typename Input>
-		static void apply(const Input &in, Program &p) {
-			std::cout << "saw a Instructions_rule |" << in.string() << "|" << std::endl;
-		}
-	};
-
-	template<> struct action<Function_rule> {
-		template<typename Input>
-		static void apply(const Input &in, Program &p) {
-			std::cout << "saw a Function_rule |" << in.string() << "|" << std::endl;
-		}
-	};
-
-	template<> struct action<Functions_rule> {
-		template<typename Input>
-		static void apply(const Input &in, Program &p) {
-			std::cout << "saw a Functions_rule |" << in.string() << "|" << std::endl;
+			Number *scale = pop_item<Number>();
+			Register *offset = pop_item<Register>();
+			Register *base = pop_item<Register>();
+			Register *destination = pop_item<Register>();
+			add_instruction(p, new Instruction_leaq(destination, base, offset, scale->value));
 		}
 	};
 
@@ -1073,10 +961,6 @@ namespace L1 {
 		Program p;
 		parse<grammar, action>(fileInput, p);
 
-		for (Item *item : parsed_items) {
-			std::cout << item->toString() << "\n";
-		}
-
 		return p;
 	}
 }
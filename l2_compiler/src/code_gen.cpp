@@ -3,6 +3,7 @@
 #include "register_allocator.h"
 #include <iostream>
 #include <fstream>
+#include <stdint.h>
 
 namespace L2::code_gen {
 	using namespace L2::program;
@@ -33,7 +34,8 @@ namespace L2::code_gen {
 			o << std::to_string(expr.value);
 		}
 		virtual void visit(StackArg &expr) {
-			int64_t byte_offset = this->spill_overflow * 8 + expr.stack_num->value;
+			// skip over the locals and the return address pushed by the call
+			int64_t byte_offset = this->spill_overflow * 8 + 8 + expr.stack_num->value;
 			o << "mem rsp " << std::to_string(byte_offset);
 		}
 		virtual void visit(MemoryLocation &expr) {
@@ -130,6 +132,60 @@ namespace L2::code_gen {
 		}
 	};
 
+	// x86-64 immediates are 32 bits, sign-extended, except when moving a
+	// constant into a register
+	bool fits_in_immediate(const Expr &expr) {
+		const NumberLiteral *num = dynamic_cast<const NumberLiteral *>(&expr);
+		return !num || (num->value >= INT32_MIN && num->value <= INT32_MAX);
+	}
+
+	// Moves the constants that don't fit in an immediate into new variables
+	// before registers are allocated, so that L1 only ever gets them as
+	// `register <- N`. Shift amounts are left alone since only their low
+	// bits count.
+	void legalize_immediates(L2Function &f) {
+		int next_var = 0;
+		for (int index = 0; index < f.instructions.size(); ++index) {
+			Instruction *inst = f.instructions[index].get();
+			std::vector<std::unique_ptr<Expr> *> operands;
+			if (InstructionAssignment *assignment = dynamic_cast<InstructionAssignment *>(inst)) {
+				bool into_register = assignment->op == AssignOperator::pure
+					&& (dynamic_cast<VariableRef *>(assignment->destination.get()) || dynamic_cast<RegisterRef *>(assignment->destination.get()));
+				bool is_shift = assignment->op == AssignOperator::lshift || assignment->op == AssignOperator::rshift;
+				if (!into_register && !is_shift) {
+					operands.push_back(&assignment->source);
+				}
+			} else if (InstructionCompareAssignment *compare = dynamic_cast<InstructionCompareAssignment *>(inst)) {
+				operands.push_back(&compare->lhs);
+				operands.push_back(&compare->rhs);
+			} else if (InstructionCompareJump *cjump = dynamic_cast<InstructionCompareJump *>(inst)) {
+				operands.push_back(&cjump->lhs);
+				operands.push_back(&cjump->rhs);
+			}
+			for (std::unique_ptr<Expr> *operand : operands) {
+				if (fits_in_immediate(**operand)) {
+					continue;
+				}
+				std::string name;
+				do {
+					name = "immediate" + std::to_string(next_var);
+					next_var++;
+				} while (f.agg_scope.variable_scope.get_item_maybe(name));
+				Variable *var = f.agg_scope.variable_scope.get_item_or_create(name);
+				f.insert_instruction(
+					index,
+					std::make_unique<InstructionAssignment>(
+						AssignOperator::pure,
+						std::move(*operand),
+						std::make_unique<VariableRef>(var)
+					)
+				);
+				index++;
+				*operand = std::make_unique<VariableRef>(var);
+			}
+		}
+	}
+
 	int get_spill_overflow(L2Function &f){
 		int sol = 0;
 		for (const auto &i: f.agg_scope.variable_scope.get_all_items()) {
@@ -148,6 +204,7 @@ namespace L2::code_gen {
 		o << "(@" << p.get_entry_function_ref().get_referent()->get_name() << "\n";
 
 		for (const std::unique_ptr<L2Function> &f : p.get_l2_functions()) {
+			legalize_immediates(*f);
 			analyze::RegAllocMap reg_alloc_map =
 				analyze::allocate_and_spill_with_backup(*f);
             int spill_overflow = get_spill_overflow(*f);
@@ -22,7 +22,7 @@ namespace L3::code_gen::target_arch {
 			return register_args[argument_index] + " <- " + l2_syntax;
 		}
 
-		int64_t rsp_offset = -WORD_SIZE * (argument_index - NUM_ARG_REGISTERS + 2); // 2 because simply offsetting by 1 would collide with return address
+		int64_t rsp_offset = -WORD_SIZE * (argument_index - NUM_ARG_REGISTERS + 1); // the call instruction pushes the return address below the stack arguments
 		return "mem rsp " + std::to_string(rsp_offset) + " <- " + l2_syntax;
 	}
 
@@ -1037,9 +1037,6 @@ namespace L3::code_gen::tiles {
 			static const int cost = 1;
 
 			virtual Vec<std::string> to_l2_instructions() const override {
-				static int num_call_return_labels = 0; // the number of call-return labels we've seen so far
-				static const std::string call_return_label_prefix = ":callret";
-
 				Vec<std::string> result;
 
 				// add the instructions preparing the arguments
@@ -1050,23 +1047,10 @@ namespace L3::code_gen::tiles {
 					));
 				}
 
-				// add the actual call instruction
+				// add the actual call instruction; the return address is pushed by
+				// the native call instruction, so no return label is needed
 				result.push_back("call " + to_l2_expr(*this->callee) + " " + std::to_string(this->arguments.size()));
 
-				// wrap in return label if the function is not an std function
-				const FunctionCn *maybe_fun_cn_ptr = dynamic_cast<const FunctionCn *>(this->callee);
-				bool is_std = maybe_fun_cn_ptr && dynamic_cast<const ExternalFunction *>(maybe_fun_cn_ptr->function);
-				if (!is_std) {
-					std::string return_label = call_return_label_prefix + std::to_string(num_call_return_labels);
-					num_call_return_labels += 1;
-
-					result.insert(
-						result.end() - 1, // insert before the call instruction
-						"mem rsp -8 <- " + return_label
-					);
-					result.push_back(mv(return_label));
-				}
-
 				// store the return value if the call returns something
 				if (this->maybe_dest) {
 					result.push_back(to_l2_expr(*this->maybe_dest) + " <- rax");
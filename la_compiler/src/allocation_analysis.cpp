@@ -0,0 +1,151 @@
+#include "allocation_analysis.h"
+#include "cfg.h"
+#include "dataflow.h"
+#include <iostream>
+
+namespace La::allocation_analysis {
+	using namespace std_alias;
+
+	struct State {
+		bool reachable;
+		Set<mir::LocalVar *> allocated; // variables that are definitely non-zero
+		Map<mir::LocalVar *, mir::LocalVar *> null_tests; // condition -> the variable it compares to 0
+
+		bool operator==(const State &other) const {
+			return this->reachable == other.reachable
+				&& this->allocated == other.allocated
+				&& this->null_tests == other.null_tests;
+		}
+	};
+
+	mir::LocalVar *get_var(const mir::Operand &operand) {
+		const mir::Place *place = dynamic_cast<const mir::Place *>(&operand);
+		return place && place->indices.empty() ? place->target : nullptr;
+	}
+
+	bool is_zero(const mir::Operand &operand) {
+		const mir::Int64Constant *constant = dynamic_cast<const mir::Int64Constant *>(&operand);
+		return constant && constant->value == 0;
+	}
+
+	// the variable that the operation compares to 0, if it does
+	mir::LocalVar *get_tested_var(const mir::BinaryOperation &bin_op) {
+		if (bin_op.op != mir::Operator::eq) return nullptr;
+		if (is_zero(*bin_op.rhs)) return get_var(*bin_op.lhs);
+		if (is_zero(*bin_op.lhs)) return get_var(*bin_op.rhs);
+		return nullptr;
+	}
+
+	void transfer_instruction(State &state, const mir::Instruction &inst) {
+		if (!inst.destination || !(*inst.destination)->indices.empty()) return;
+		mir::LocalVar *var = (*inst.destination)->target;
+
+		bool is_allocated = false;
+		mir::LocalVar *tested_var = nullptr;
+		const mir::Rvalue *rvalue = inst.rvalue.get();
+		if (dynamic_cast<const mir::NewArray *>(rvalue) || dynamic_cast<const mir::NewTuple *>(rvalue)) {
+			is_allocated = true;
+		} else if (const mir::Operand *operand = dynamic_cast<const mir::Operand *>(rvalue)) {
+			mir::LocalVar *source = get_var(*operand);
+			is_allocated = source && state.allocated.count(source);
+		} else if (const mir::BinaryOperation *bin_op = dynamic_cast<const mir::BinaryOperation *>(rvalue)) {
+			tested_var = get_tested_var(*bin_op);
+		}
+
+		state.allocated.erase(var);
+		state.null_tests.erase(var);
+		for (auto it = state.null_tests.begin(); it != state.null_tests.end();) {
+			it = it->second == var ? state.null_tests.erase(it) : std::next(it);
+		}
+		if (is_allocated) {
+			state.allocated.insert(var);
+		}
+		if (tested_var && tested_var != var) {
+			state.null_tests.insert_or_assign(var, tested_var);
+		}
+	}
+
+	// the variable that a branch's condition compares to 0, if it does.
+	// The branch is taken when the variable is 0.
+	mir::LocalVar *get_tested_var(const State &state, const mir::Operand &condition) {
+		mir::LocalVar *condition_var = get_var(condition);
+		if (!condition_var) return nullptr;
+		auto it = state.null_tests.find(condition_var);
+		return it == state.null_tests.end() ? nullptr : it->second;
+	}
+
+	State get_state_before_terminator(const State &in_state, const mir::BasicBlock &block) {
+		State state = in_state;
+		for (const Uptr<mir::Instruction> &inst : block.instructions) {
+			transfer_instruction(state, *inst);
+		}
+		return state;
+	}
+
+	struct AllocationProblem {
+		using State = allocation_analysis::State;
+
+		State get_boundary_state() {
+			return State { true, {}, {} };
+		}
+		State get_unreachable_state() {
+			return State { false, {}, {} };
+		}
+		State join(const State &a, const State &b) {
+			if (!a.reachable) return b;
+			if (!b.reachable) return a;
+			State result { true, {}, {} };
+			for (mir::LocalVar *var : a.allocated) {
+				if (b.allocated.count(var)) {
+					result.allocated.insert(var);
+				}
+			}
+			for (const auto &[condition, var] : a.null_tests) {
+				if (auto it = b.null_tests.find(condition); it != b.null_tests.end() && it->second == var) {
+					result.null_tests.insert({ condition, var });
+				}
+			}
+			return result;
+		}
+		void transfer(State &state, const mir::Instruction &inst) {
+			transfer_instruction(state, inst);
+		}
+		void transfer_branch(State &state, const mir::Operand &condition, bool taken) {
+			if (mir::LocalVar *tested_var = get_tested_var(state, condition); tested_var && !taken) {
+				state.allocated.insert(tested_var);
+			}
+		}
+	};
+
+	int64_t eliminate_allocation_checks(mir::FunctionDef &function) {
+		if (function.basic_blocks.empty()) return 0;
+		cfg::FlowGraph graph = cfg::make_flow_graph(function);
+		AllocationProblem problem;
+		Vec<State> in_states = dataflow::solve_forward(function, graph, problem);
+		int64_t num_removed = 0;
+		for (int i = 0; i < function.basic_blocks.size(); ++i) {
+			mir::BasicBlock &block = *function.basic_blocks[i];
+			const mir::BasicBlock::Branch *branch = std::get_if<mir::BasicBlock::Branch>(&block.terminator);
+			if (!branch || !in_states[i].reachable) continue;
+			State state = get_state_before_terminator(in_states[i], block);
+			mir::LocalVar *tested_var = get_tested_var(state, *branch->condition);
+			if (tested_var && state.allocated.count(tested_var)) {
+				block.terminator = mir::BasicBlock::Goto { branch->else_block };
+				num_removed += 1;
+			}
+		}
+		cfg::remove_unreachable_blocks(function);
+		cfg::merge_blocks(function);
+		return num_removed;
+	}
+
+	void eliminate_allocation_checks(mir::Program &program, bool verbose) {
+		int64_t num_removed = 0;
+		for (Uptr<mir::FunctionDef> &function : program.function_defs) {
+			num_removed += eliminate_allocation_checks(*function);
+		}
+		if (verbose) {
+			std::cerr << "allocation analysis removed " << num_removed << " checks\n";
+		}
+	}
+}
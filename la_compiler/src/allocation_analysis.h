@@ -0,0 +1,21 @@
+#pragma once
+#include "std_alias.h"
+#include "mir.h"
+
+// Removes the lowering's `%tempcond <- %arr = 0` checks for arrays and
+// tuples that are known to be allocated.
+//
+// A forward dataflow analysis finds the variables that are definitely
+// non-zero at each point: those just assigned a `new Array(...)` or
+// `new Tuple(...)`, copies of them, and those that an earlier check has
+// already found non-zero on every path. Branches on checks of such
+// variables become jumps, and the blocks that the branches used to split
+// are merged back together.
+namespace La::allocation_analysis {
+	using namespace std_alias;
+
+	// returns the number of checks removed
+	int64_t eliminate_allocation_checks(mir::FunctionDef &function);
+
+	void eliminate_allocation_checks(mir::Program &program, bool verbose);
+}
@@ -0,0 +1,217 @@
+#include "cfg.h"
+#include <algorithm>
+
+namespace La::cfg {
+	using namespace std_alias;
+
+	Vec<mir::BasicBlock *> get_successors(const mir::BasicBlock &block) {
+		if (const mir::BasicBlock::Goto *term = std::get_if<mir::BasicBlock::Goto>(&block.terminator)) {
+			return { term->successor };
+		} else if (const mir::BasicBlock::Branch *term = std::get_if<mir::BasicBlock::Branch>(&block.terminator)) {
+			return { term->then_block, term->else_block };
+		} else {
+			return {};
+		}
+	}
+
+	FlowGraph make_flow_graph(const mir::FunctionDef &function) {
+		const Vec<Uptr<mir::BasicBlock>> &blocks = function.basic_blocks;
+		FlowGraph graph;
+		for (int i = 0; i < blocks.size(); ++i) {
+			graph.block_index_map.insert_or_assign(blocks[i].get(), i);
+		}
+		graph.successors.resize(blocks.size());
+		graph.predecessors.resize(blocks.size());
+		for (int i = 0; i < blocks.size(); ++i) {
+			for (mir::BasicBlock *succ : get_successors(*blocks[i])) {
+				int succ_index = graph.block_index_map.at(succ);
+				graph.successors[i].push_back(succ_index);
+				graph.predecessors[succ_index].push_back(i);
+			}
+		}
+		return graph;
+	}
+
+	Vec<int> get_reverse_postorder(const FlowGraph &graph) {
+		Vec<int> postorder;
+		if (graph.successors.empty()) {
+			return postorder;
+		}
+		Vec<bool> visited(graph.successors.size(), false);
+		Vec<Pair<int, int>> stack; // (block, index of the next successor to visit)
+		stack.emplace_back(0, 0);
+		visited[0] = true;
+		while (!stack.empty()) {
+			auto &[block, next_succ] = stack.back();
+			if (next_succ < graph.successors[block].size()) {
+				int succ = graph.successors[block][next_succ];
+				next_succ += 1;
+				if (!visited[succ]) {
+					visited[succ] = true;
+					stack.emplace_back(succ, 0);
+				}
+			} else {
+				postorder.push_back(block);
+				stack.pop_back();
+			}
+		}
+		std::reverse(postorder.begin(), postorder.end());
+		return postorder;
+	}
+
+	Vec<int> find_immediate_dominators(const FlowGraph &graph) {
+		int num_blocks = graph.successors.size();
+		if (num_blocks == 0) {
+			return {};
+		}
+
+		Vec<int> postorder = get_reverse_postorder(graph);
+		std::reverse(postorder.begin(), postorder.end());
+		Vec<int> postorder_number(num_blocks, -1);
+		for (int i = 0; i < postorder.size(); ++i) {
+			postorder_number[postorder[i]] = i;
+		}
+
+		Vec<int> idoms(num_blocks, -1);
+		idoms[0] = 0;
+		auto intersect = [&](int a, int b) {
+			while (a != b) {
+				while (postorder_number[a] < postorder_number[b]) a = idoms[a];
+				while (postorder_number[b] < postorder_number[a]) b = idoms[b];
+			}
+			return a;
+		};
+		bool changed = true;
+		while (changed) {
+			changed = false;
+			for (auto it = postorder.rbegin(); it != postorder.rend(); ++it) {
+				int block = *it;
+				if (block == 0) continue;
+				int new_idom = -1;
+				for (int pred : graph.predecessors[block]) {
+					if (idoms[pred] == -1) continue;
+					new_idom = new_idom == -1 ? pred : intersect(pred, new_idom);
+				}
+				if (idoms[block] != new_idom) {
+					idoms[block] = new_idom;
+					changed = true;
+				}
+			}
+		}
+		return idoms;
+	}
+
+	bool dominates(const Vec<int> &idoms, int dominator, int block) {
+		if (idoms[block] == -1) {
+			return false;
+		}
+		while (block != dominator) {
+			if (block == 0) {
+				return false;
+			}
+			block = idoms[block];
+		}
+		return true;
+	}
+
+	Vec<NaturalLoop> find_natural_loops(const FlowGraph &graph, const Vec<int> &idoms) {
+		Vec<NaturalLoop> loops;
+		Map<int, int> loop_index_by_header;
+		for (int block = 0; block < graph.successors.size(); ++block) {
+			for (int header : graph.successors[block]) {
+				if (!dominates(idoms, header, block)) continue;
+				auto [loop_it, is_new] = loop_index_by_header.insert({ header, loops.size() });
+				if (is_new) {
+					loops.push_back(NaturalLoop { header, { header } });
+				}
+				Set<int> &body = loops[loop_it->second].body;
+				Vec<int> worklist { block };
+				while (!worklist.empty()) {
+					int body_block = worklist.back();
+					worklist.pop_back();
+					if (body.count(body_block) && body_block != block) continue;
+					body.insert(body_block);
+					if (body_block == header) continue;
+					for (int pred : graph.predecessors[body_block]) {
+						if (!body.count(pred)) {
+							worklist.push_back(pred);
+						}
+					}
+				}
+			}
+		}
+		return loops;
+	}
+
+	void redirect_edge(mir::BasicBlock &pred, mir::BasicBlock *old_succ, mir::BasicBlock *new_succ) {
+		if (mir::BasicBlock::Goto *term = std::get_if<mir::BasicBlock::Goto>(&pred.terminator)) {
+			if (term->successor == old_succ) {
+				term->successor = new_succ;
+			}
+		} else if (mir::BasicBlock::Branch *term = std::get_if<mir::BasicBlock::Branch>(&pred.terminator)) {
+			if (term->then_block == old_succ) {
+				term->then_block = new_succ;
+			}
+			if (term->else_block == old_succ) {
+				term->else_block = new_succ;
+			}
+		}
+	}
+
+	const mir::FunctionCall *get_error_report(const mir::BasicBlock &block) {
+		for (const Uptr<mir::Instruction> &inst : block.instructions) {
+			const mir::FunctionCall *call = dynamic_cast<const mir::FunctionCall *>(inst->rvalue.get());
+			if (!call) continue;
+			const mir::ExtCodeConstant *callee = dynamic_cast<const mir::ExtCodeConstant *>(call->callee.get());
+			if (callee && (callee->value == &mir::tensor_error || callee->value == &mir::tuple_error)) {
+				return call;
+			}
+		}
+		return nullptr;
+	}
+
+	void remove_unreachable_blocks(mir::FunctionDef &function) {
+		FlowGraph graph = make_flow_graph(function);
+		Vec<int> reachable_order = get_reverse_postorder(graph);
+		if (reachable_order.size() == function.basic_blocks.size()) return;
+
+		Vec<bool> reachable(function.basic_blocks.size(), false);
+		for (int block : reachable_order) {
+			reachable[block] = true;
+		}
+		Vec<Uptr<mir::BasicBlock>> kept_blocks;
+		for (int i = 0; i < function.basic_blocks.size(); ++i) {
+			if (reachable[i]) {
+				kept_blocks.push_back(mv(function.basic_blocks[i]));
+			}
+		}
+		function.basic_blocks = mv(kept_blocks);
+	}
+
+	void merge_blocks(mir::FunctionDef &function) {
+		FlowGraph graph = make_flow_graph(function);
+		Vec<Uptr<mir::BasicBlock>> &blocks = function.basic_blocks;
+		Vec<bool> merged(blocks.size(), false);
+		for (int i = 0; i < blocks.size(); ++i) {
+			if (merged[i]) continue;
+			mir::BasicBlock &block = *blocks[i];
+			while (const mir::BasicBlock::Goto *term = std::get_if<mir::BasicBlock::Goto>(&block.terminator)) {
+				int succ = graph.block_index_map.at(term->successor);
+				if (succ == i || succ == 0 || graph.predecessors[succ].size() != 1) break;
+				mir::BasicBlock &succ_block = *blocks[succ];
+				for (Uptr<mir::Instruction> &inst : succ_block.instructions) {
+					block.instructions.push_back(mv(inst));
+				}
+				block.terminator = mv(succ_block.terminator);
+				merged[succ] = true;
+			}
+		}
+		Vec<Uptr<mir::BasicBlock>> kept_blocks;
+		for (int i = 0; i < blocks.size(); ++i) {
+			if (!merged[i]) {
+				kept_blocks.push_back(mv(blocks[i]));
+			}
+		}
+		blocks = mv(kept_blocks);
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include "std_alias.h"
+#include "mir.h"
+
+// Control-flow graph analyses shared by the MIR passes. Blocks are referred
+// to by their index in the function's block list, and block 0 is the entry.
+namespace La::cfg {
+	using namespace std_alias;
+
+	struct FlowGraph {
+		Map<mir::BasicBlock *, int> block_index_map;
+		Vec<Vec<int>> successors;
+		Vec<Vec<int>> predecessors;
+	};
+
+	Vec<mir::BasicBlock *> get_successors(const mir::BasicBlock &block);
+
+	FlowGraph make_flow_graph(const mir::FunctionDef &function);
+
+	// the reachable blocks, each before all of its successors except along
+	// back edges
+	Vec<int> get_reverse_postorder(const FlowGraph &graph);
+
+	// Cooper, Harvey & Kennedy's iterative algorithm. Returns the index of
+	// each block's immediate dominator, with -1 for unreachable blocks and
+	// the entry block's own index for the entry block.
+	Vec<int> find_immediate_dominators(const FlowGraph &graph);
+
+	bool dominates(const Vec<int> &idoms, int dominator, int block);
+
+	// A back edge goes to a block that dominates its source; the body of its
+	// natural loop is everything that reaches the source without going
+	// through the header. Loops that share a header are merged.
+	struct NaturalLoop {
+		int header;
+		Set<int> body; // includes the header
+	};
+
+	Vec<NaturalLoop> find_natural_loops(const FlowGraph &graph, const Vec<int> &idoms);
+
+	// makes `pred` jump to new_succ wherever it jumped to old_succ
+	void redirect_edge(mir::BasicBlock &pred, mir::BasicBlock *old_succ, mir::BasicBlock *new_succ);
+
+	// the call to tensor-error or tuple-error if the block reports a runtime
+	// error, and nullptr otherwise
+	const mir::FunctionCall *get_error_report(const mir::BasicBlock &block);
+
+	// deletes the blocks that can't be reached from the entry block
+	void remove_unreachable_blocks(mir::FunctionDef &function);
+
+	// appends each block that is only jumped to from one other block to that
+	// block
+	void merge_blocks(mir::FunctionDef &function);
+}
@@ -1,6 +1,7 @@
 #include "std_alias.h"
 #include "parser.h"
 #include "hir_to_mir.h"
+#include "optimize.h"
 #include <string>
 #include <vector>
 #include <utility>
@@ -68,7 +69,8 @@ int main(
 	);
 
 	if (enable_code_generator) {
-		auto mir_program = La::hir_to_mir::make_mir_program(*hir_program);
+		auto mir_program = La::hir_to_mir::make_mir_program(*hir_program, optimizationLevel > 0);
+		La::optimize::run_pipeline(*mir_program, La::optimize::get_pipeline(optimizationLevel), verbose);
 		std::ofstream o;
 		o.open("prog.IR");
 		o << mir_program->to_ir_syntax();
@@ -0,0 +1,171 @@
+#pragma once
+#include "std_alias.h"
+#include "mir.h"
+#include "cfg.h"
+
+// A worklist solver for dataflow problems over a function's blocks. A
+// problem supplies the lattice and the transfer functions:
+//
+//	struct Problem {
+//		using State = ...; // copyable, with ==
+//		State get_boundary_state(); // on entry (forward) or after a return (backward)
+//		State get_unreachable_state(); // joining with it changes nothing
+//		State join(const State &a, const State &b);
+//		void transfer(State &state, const mir::Instruction &inst);
+//		// forward problems only: refines the state along one edge out of a
+//		// branch
+//		void transfer_branch(State &state, const mir::Operand &condition, bool taken);
+//		// backward problems only: the terminator's effect, applied before
+//		// the block's instructions
+//		void transfer_terminator(State &state, const mir::BasicBlock &block);
+//	};
+//
+// Forward problems give the state on entry to each block and backward
+// problems give the state on exit from each block; blocks that can't be
+// reached from the entry have the unreachable state.
+namespace La::dataflow {
+	using namespace std_alias;
+
+	template <typename Problem>
+	Vec<typename Problem::State> solve_forward(const mir::FunctionDef &function, const cfg::FlowGraph &graph, Problem &problem) {
+		using State = typename Problem::State;
+		int num_blocks = graph.successors.size();
+		Vec<State> in_states(num_blocks, problem.get_unreachable_state());
+		if (num_blocks == 0) return in_states;
+
+		Vec<int> order = cfg::get_reverse_postorder(graph);
+		Vec<int> order_index(num_blocks, -1);
+		for (int i = 0; i < order.size(); ++i) {
+			order_index[order[i]] = i;
+		}
+		// the state along each edge, so that a block's entry state is the
+		// join of what its predecessors send now rather than ever sent
+		Map<Pair<int, int>, State> edge_states;
+		in_states[0] = problem.get_boundary_state();
+
+		Set<Pair<int, int>> worklist { { 0, 0 } }; // (position in reverse postorder, block)
+		while (!worklist.empty()) {
+			int block = worklist.begin()->second;
+			worklist.erase(worklist.begin());
+
+			const mir::BasicBlock &mir_block = *function.basic_blocks[block];
+			State state = in_states[block];
+			for (const Uptr<mir::Instruction> &inst : mir_block.instructions) {
+				problem.transfer(state, *inst);
+			}
+			Map<int, State> out_states;
+			auto send = [&](mir::BasicBlock *succ, State succ_state) {
+				int succ_index = graph.block_index_map.at(succ);
+				auto [it, is_new] = out_states.insert({ succ_index, succ_state });
+				if (!is_new) {
+					it->second = problem.join(it->second, succ_state);
+				}
+			};
+			if (const mir::BasicBlock::Goto *term = std::get_if<mir::BasicBlock::Goto>(&mir_block.terminator)) {
+				send(term->successor, state);
+			} else if (const mir::BasicBlock::Branch *term = std::get_if<mir::BasicBlock::Branch>(&mir_block.terminator)) {
+				State then_state = state;
+				problem.transfer_branch(then_state, *term->condition, true);
+				problem.transfer_branch(state, *term->condition, false);
+				send(term->then_block, mv(then_state));
+				send(term->else_block, mv(state));
+			}
+
+			for (auto &[succ, out_state] : out_states) {
+				edge_states.insert_or_assign(Pair<int, int> { block, succ }, mv(out_state));
+				State new_state = succ == 0 ? problem.get_boundary_state() : problem.get_unreachable_state();
+				for (int pred : graph.predecessors[succ]) {
+					if (auto it = edge_states.find(Pair<int, int> { pred, succ }); it != edge_states.end()) {
+						new_state = problem.join(new_state, it->second);
+					}
+				}
+				if (!(new_state == in_states[succ])) {
+					in_states[succ] = mv(new_state);
+					worklist.insert({ order_index[succ], succ });
+				}
+			}
+		}
+		return in_states;
+	}
+
+	template <typename Problem>
+	Vec<typename Problem::State> solve_backward(const mir::FunctionDef &function, const cfg::FlowGraph &graph, Problem &problem) {
+		using State = typename Problem::State;
+		int num_blocks = graph.successors.size();
+		Vec<State> out_states(num_blocks, problem.get_unreachable_state());
+		Vec<State> in_states(num_blocks, problem.get_unreachable_state());
+		Vec<int> order = cfg::get_reverse_postorder(graph);
+
+		// blocks late in the order go first, so that most blocks see their
+		// successors' states before they are visited
+		Set<Pair<int, int>> worklist; // (position from the end of the order, block)
+		for (int i = 0; i < order.size(); ++i) {
+			int block = order[i];
+			if (graph.successors[block].empty()) {
+				out_states[block] = problem.get_boundary_state();
+			}
+			worklist.insert({ static_cast<int>(order.size()) - 1 - i, block });
+		}
+		Vec<int> position(num_blocks, -1);
+		for (auto [pos, block] : worklist) {
+			position[block] = pos;
+		}
+
+		while (!worklist.empty()) {
+			int block = worklist.begin()->second;
+			worklist.erase(worklist.begin());
+
+			const mir::BasicBlock &mir_block = *function.basic_blocks[block];
+			State state = out_states[block];
+			problem.transfer_terminator(state, mir_block);
+			for (auto it = mir_block.instructions.rbegin(); it != mir_block.instructions.rend(); ++it) {
+				problem.transfer(state, **it);
+			}
+			if (state == in_states[block]) continue;
+			in_states[block] = mv(state);
+
+			for (int pred : graph.predecessors[block]) {
+				if (position[pred] == -1) continue; // unreachable
+				State new_state = problem.get_unreachable_state();
+				for (int succ : graph.successors[pred]) {
+					new_state = problem.join(new_state, in_states[succ]);
+				}
+				if (!(new_state == out_states[pred])) {
+					out_states[pred] = mv(new_state);
+					worklist.insert({ position[pred], pred });
+				}
+			}
+		}
+		return out_states;
+	}
+
+	// the variables that may be read before they are next written
+	struct LivenessProblem {
+		using State = Set<mir::LocalVar *>;
+
+		State get_boundary_state() {
+			return {};
+		}
+		State get_unreachable_state() {
+			return {};
+		}
+		State join(const State &a, const State &b) {
+			State result = a;
+			result.insert(b.begin(), b.end());
+			return result;
+		}
+		void transfer(State &state, const mir::Instruction &inst) {
+			if (Opt<mir::LocalVar *> var = inst.get_var_written()) {
+				state.erase(*var);
+			}
+			Vec<mir::LocalVar *> vars_read;
+			inst.collect_vars_read(vars_read);
+			state.insert(vars_read.begin(), vars_read.end());
+		}
+		void transfer_terminator(State &state, const mir::BasicBlock &block) {
+			Vec<mir::LocalVar *> vars_read;
+			block.collect_vars_read(vars_read);
+			state.insert(vars_read.begin(), vars_read.end());
+		}
+	};
+}
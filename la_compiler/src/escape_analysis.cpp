@@ -0,0 +1,169 @@
+#include "escape_analysis.h"
+#include "cfg.h"
+#include "dataflow.h"
+#include <iostream>
+
+namespace La::escape_analysis {
+	using namespace std_alias;
+
+	// the most words (including the header) an object in a frame can take
+	const int64_t MAX_FRAME_OBJECT_WORDS = 64;
+
+	mir::LocalVar *get_var(const mir::Operand &operand) {
+		const mir::Place *place = dynamic_cast<const mir::Place *>(&operand);
+		return place && place->indices.empty() ? place->target : nullptr;
+	}
+
+	bool holds_object(const mir::LocalVar *var) {
+		if (std::holds_alternative<mir::Type::TupleType>(var->type.type)) return true;
+		const mir::Type::ArrayType *array_type = std::get_if<mir::Type::ArrayType>(&var->type.type);
+		return array_type && array_type->num_dimensions > 0;
+	}
+
+	// whether the callee could keep a pointer to its arguments; print only
+	// reads them
+	bool may_capture_arguments(const mir::FunctionCall &call) {
+		const mir::ExtCodeConstant *callee = dynamic_cast<const mir::ExtCodeConstant *>(call.callee.get());
+		return !callee || callee->value->name != "print";
+	}
+
+	// the variables that copies connect, grouped with union-find
+	struct CopyGroups {
+		Map<mir::LocalVar *, mir::LocalVar *> parents;
+
+		mir::LocalVar *find(mir::LocalVar *var) {
+			auto it = this->parents.find(var);
+			if (it == this->parents.end() || it->second == var) return var;
+			mir::LocalVar *root = this->find(it->second);
+			it->second = root;
+			return root;
+		}
+		void unite(mir::LocalVar *a, mir::LocalVar *b) {
+			a = this->find(a);
+			b = this->find(b);
+			if (a != b) {
+				this->parents[a] = b;
+			}
+		}
+	};
+
+	// the number of words a new object with these encoded lengths takes up,
+	// if they are all constants
+	Opt<int64_t> get_constant_num_words(const Vec<const mir::Operand *> &lengths, bool is_tuple) {
+		int64_t num_elements = 1;
+		for (const mir::Operand *length : lengths) {
+			const mir::Int64Constant *constant = dynamic_cast<const mir::Int64Constant *>(length);
+			if (!constant || constant->value % 2 == 0) return {};
+			int64_t decoded = constant->value >> 1;
+			if (decoded < 0 || decoded > MAX_FRAME_OBJECT_WORDS) return {};
+			num_elements *= decoded;
+			if (num_elements > MAX_FRAME_OBJECT_WORDS) return {};
+		}
+		if (!is_tuple) {
+			num_elements += lengths.size();
+		}
+		return num_elements + 1;
+	}
+
+	// the flag to set if the instruction makes a small object of constant
+	// size in a variable, and nullptr otherwise
+	bool *get_frame_flag(mir::Instruction &inst) {
+		if (!inst.destination || !(*inst.destination)->indices.empty()) return nullptr;
+		Vec<const mir::Operand *> lengths;
+		bool is_tuple = false;
+		bool *flag = nullptr;
+		if (mir::NewArray *new_array = dynamic_cast<mir::NewArray *>(inst.rvalue.get())) {
+			for (const Uptr<mir::Operand> &length : new_array->dimension_lengths) {
+				lengths.push_back(length.get());
+			}
+			flag = &new_array->in_frame;
+		} else if (mir::NewTuple *new_tuple = dynamic_cast<mir::NewTuple *>(inst.rvalue.get())) {
+			lengths.push_back(new_tuple->length.get());
+			is_tuple = true;
+			flag = &new_tuple->in_frame;
+		} else {
+			return nullptr;
+		}
+		Opt<int64_t> num_words = get_constant_num_words(lengths, is_tuple);
+		return num_words && *num_words <= MAX_FRAME_OBJECT_WORDS ? flag : nullptr;
+	}
+
+	int64_t place_allocations_in_frames(mir::FunctionDef &function) {
+		// group the variables, and find the groups that escape
+		CopyGroups groups;
+		for (const Uptr<mir::BasicBlock> &block : function.basic_blocks) {
+			for (const Uptr<mir::Instruction> &inst : block->instructions) {
+				Opt<mir::LocalVar *> dest = inst->get_var_written();
+				const mir::Operand *operand = dynamic_cast<const mir::Operand *>(inst->rvalue.get());
+				mir::LocalVar *source = operand ? get_var(*operand) : nullptr;
+				if (dest && source && holds_object(*dest) && holds_object(source)) {
+					groups.unite(*dest, source);
+				}
+			}
+		}
+		Set<mir::LocalVar *> escaped;
+		auto mark_escaped = [&](const mir::Operand &operand) {
+			if (mir::LocalVar *var = get_var(operand); var && holds_object(var)) {
+				escaped.insert(groups.find(var));
+			}
+		};
+		for (const Uptr<mir::BasicBlock> &block : function.basic_blocks) {
+			for (const Uptr<mir::Instruction> &inst : block->instructions) {
+				const mir::Rvalue *rvalue = inst->rvalue.get();
+				if (inst->destination && !(*inst->destination)->indices.empty()) {
+					if (const mir::Operand *operand = dynamic_cast<const mir::Operand *>(rvalue)) {
+						mark_escaped(*operand);
+					}
+				} else if (const mir::FunctionCall *call = dynamic_cast<const mir::FunctionCall *>(rvalue)) {
+					if (may_capture_arguments(*call)) {
+						for (const Uptr<mir::Operand> &arg : call->arguments) {
+							mark_escaped(*arg);
+						}
+					}
+				}
+			}
+			if (const mir::BasicBlock::ReturnVal *term = std::get_if<mir::BasicBlock::ReturnVal>(&block->terminator)) {
+				mark_escaped(*term->return_value);
+			}
+		}
+
+		// place the allocations whose earlier objects are dead
+		cfg::FlowGraph graph = cfg::make_flow_graph(function);
+		dataflow::LivenessProblem problem;
+		Vec<Set<mir::LocalVar *>> out_states = dataflow::solve_backward(function, graph, problem);
+		int64_t num_placed = 0;
+		for (int i = 0; i < function.basic_blocks.size(); ++i) {
+			mir::BasicBlock &block = *function.basic_blocks[i];
+			Set<mir::LocalVar *> live = out_states[i];
+			problem.transfer_terminator(live, block);
+			for (auto it = block.instructions.rbegin(); it != block.instructions.rend(); ++it) {
+				mir::Instruction &inst = **it;
+				problem.transfer(live, inst);
+				bool *frame_flag = get_frame_flag(inst);
+				if (!frame_flag) continue;
+
+				mir::LocalVar *group = groups.find((*inst.destination)->target);
+				if (escaped.count(group)) continue;
+				bool group_is_live = false;
+				for (mir::LocalVar *var : live) {
+					group_is_live = group_is_live || groups.find(var) == group;
+				}
+				if (!group_is_live) {
+					*frame_flag = true;
+					num_placed += 1;
+				}
+			}
+		}
+		return num_placed;
+	}
+
+	void place_allocations_in_frames(mir::Program &program, bool verbose) {
+		int64_t num_placed = 0;
+		for (Uptr<mir::FunctionDef> &function : program.function_defs) {
+			num_placed += place_allocations_in_frames(*function);
+		}
+		if (verbose) {
+			std::cerr << "escape analysis placed " << num_placed << " allocations in frames\n";
+		}
+	}
+}
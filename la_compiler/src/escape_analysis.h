@@ -0,0 +1,22 @@
+#pragma once
+#include "std_alias.h"
+#include "mir.h"
+
+// Moves the arrays and tuples that can't outlive their function call out of
+// the heap and into the function's frame (`new frame Array(...)` in IR).
+//
+// Variables that copy into each other are grouped together, and an
+// allocation escapes if any variable in its group is stored into memory,
+// returned, or passed to a call other than print. The IR compiler gives
+// each allocation in a frame a single slot, so the object that the same
+// instruction made last time must be dead when it runs again: none of the
+// variables in the group can be live right before it. Only small objects
+// with constant lengths are moved.
+namespace La::escape_analysis {
+	using namespace std_alias;
+
+	// returns the number of allocations moved into the frame
+	int64_t place_allocations_in_frames(mir::FunctionDef &function);
+
+	void place_allocations_in_frames(mir::Program &program, bool verbose);
+}
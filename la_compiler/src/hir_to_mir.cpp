@@ -12,24 +12,35 @@ namespace La::hir_to_mir {
 		const Map<hir::LaFunction *, mir::FunctionDef *> &func_map;
 		Map<hir::Variable *, mir::LocalVar *> &var_map;
 		Map<std::string, mir::BasicBlock *> block_map;
+		// Whether int64 local variables hold plain values. Otherwise they
+		// hold encoded values like memory does. Either way, values are
+		// encoded when they are stored to memory or passed to an external
+		// function.
+		bool unbox_int64s;
 
 		// local variables and blocks used for compiler purposes such as array checking
 		// nullptr if we did not use them
 		struct CompilerAdditions {
 			mir::LocalVar *temp_condition; // used to store the value of a really short-lived boolean condition
-			mir::LocalVar *line_number; // used to store the line number for tensor-error etc. purposes; ENCODED
-			mir::LocalVar *error_dim; // used to store the dimension index for tensor-error etc.; ENCODED
-			mir::LocalVar *error_length; // used to store the dimension length for tensor-error etc.; ENCODED
-			mir::LocalVar *error_index; // used to store the index for tensor-error etc.; ENCODED
-			mir::BasicBlock *unalloced_error; // used to report use of an unallocated tensor
-			mir::BasicBlock *out_of_range_tuple_error; // used to report use of an out-of-range tuple
-			mir::BasicBlock *out_of_range_one_dim_error; // used to report use of an out-of-range 1D tensor
-			mir::BasicBlock *out_of_range_multi_dim_error; // used to report use of an out-of-range n-D tensor
+			mir::LocalVar *error_length; // used to store the dimension length for tensor-error etc.; ENCODED unless int64s are unboxed
+			mir::LocalVar *error_index; // used to store the index for tensor-error etc.; ENCODED unless int64s are unboxed
+			// the blocks that report errors, by label name. Each access site
+			// gets its own, with the line number and dimension as constants,
+			// so that the accesses themselves don't have to store them.
+			Map<std::string, mir::BasicBlock *> error_reporters;
 		} compiler_additions;
 
 		// null if the previous BasicBlock already has a terminator or there are no BasicBlocks yet
 		mir::BasicBlock *active_basic_block_nullable;
 
+		// Temporaries only live within the LA instruction that creates them,
+		// so once the instruction is done they can hold the next one's
+		// values. Reusing them keeps the number of variables the register
+		// allocator has to color down.
+		Vec<mir::LocalVar *> free_temps;
+		Vec<mir::LocalVar *> instruction_temps; // in use by the current instruction
+		int64_t num_temps;
+
 		void add_inst(Opt<Uptr<mir::Place>> destination, Uptr<mir::Rvalue> rvalue) {
 			this->active_basic_block_nullable->instructions.push_back(
 				mkuptr<mir::Instruction>(mv(destination), mv(rvalue))
@@ -41,18 +52,6 @@ namespace La::hir_to_mir {
 			}
 			return this->compiler_additions.temp_condition;
 		}
-		mir::LocalVar *get_compiler_addition_line_number() {
-			if (!this->compiler_additions.line_number) {
-				this->compiler_additions.line_number = this->make_local_var_int64("linenum");
-			}
-			return this->compiler_additions.line_number;
-		}
-		mir::LocalVar *get_compiler_addition_error_dim() {
-			if (!this->compiler_additions.error_dim) {
-				this->compiler_additions.error_dim = this->make_local_var_int64("errordim");
-			}
-			return this->compiler_additions.error_dim;
-		}
 		mir::LocalVar *get_compiler_addition_error_length() {
 			if (!this->compiler_additions.error_length) {
 				this->compiler_additions.error_length = this->make_local_var_int64("errorlength");
@@ -65,72 +64,69 @@ namespace La::hir_to_mir {
 			}
 			return this->compiler_additions.error_index;
 		}
-		mir::BasicBlock *get_compiler_addition_unalloced_error() {
-			if (!this->compiler_additions.unalloced_error) {
-				this->compiler_additions.unalloced_error = this->create_basic_block(false, "unallocederror");
-				Vec<Uptr<mir::Operand>> args;
-				args.push_back(mkuptr<mir::Place>(this->get_compiler_addition_line_number()));
-				compiler_additions.unalloced_error->instructions.push_back(mkuptr<mir::Instruction>(
-					Opt<Uptr<mir::Place>>(),
-					mkuptr<mir::FunctionCall>(
-						mkuptr<mir::ExtCodeConstant>(&mir::tensor_error),
-						mv(args)
-					)
-				));
-			}
-			return this->compiler_additions.unalloced_error;
-		}
-		mir::BasicBlock *get_compiler_addition_out_of_range_tuple_error() {
-			if (!this->compiler_additions.out_of_range_tuple_error) {
-				this->compiler_additions.out_of_range_tuple_error = this->create_basic_block(false, "outofrangetuple");
-				Vec<Uptr<mir::Operand>> args;
-				args.push_back(mkuptr<mir::Place>(this->get_compiler_addition_line_number()));
-				args.push_back(mkuptr<mir::Place>(this->get_compiler_addition_error_length()));
-				args.push_back(mkuptr<mir::Place>(this->get_compiler_addition_error_index()));
-				compiler_additions.out_of_range_tuple_error->instructions.push_back(mkuptr<mir::Instruction>(
-					Opt<Uptr<mir::Place>>(),
-					mkuptr<mir::FunctionCall>(
-						mkuptr<mir::ExtCodeConstant>(&mir::tuple_error),
-						mv(args)
-					)
-				));
-			}
-			return this->compiler_additions.out_of_range_tuple_error;
-		}
-		mir::BasicBlock *get_compiler_addition_out_of_range_one_dim_error() {
-			if (!this->compiler_additions.out_of_range_one_dim_error) {
-				this->compiler_additions.out_of_range_one_dim_error = this->create_basic_block(false, "outofrangeonedim");
-				Vec<Uptr<mir::Operand>> args;
-				args.push_back(mkuptr<mir::Place>(this->get_compiler_addition_line_number()));
-				args.push_back(mkuptr<mir::Place>(this->get_compiler_addition_error_length()));
-				args.push_back(mkuptr<mir::Place>(this->get_compiler_addition_error_index()));
-				compiler_additions.out_of_range_one_dim_error->instructions.push_back(mkuptr<mir::Instruction>(
-					Opt<Uptr<mir::Place>>(),
-					mkuptr<mir::FunctionCall>(
-						mkuptr<mir::ExtCodeConstant>(&mir::tensor_error),
-						mv(args)
-					)
-				));
+		mir::BasicBlock *get_compiler_addition_error_reporter(std::string label_name, mir::ExternalFunction *reporter, Vec<Uptr<mir::Operand>> args) {
+			auto it = this->compiler_additions.error_reporters.find(label_name);
+			if (it != this->compiler_additions.error_reporters.end()) {
+				return it->second;
 			}
-			return this->compiler_additions.out_of_range_one_dim_error;
-		}
-		mir::BasicBlock *get_compiler_addition_out_of_range_multi_dim_error() {
-			if (!this->compiler_additions.out_of_range_multi_dim_error) {
-				this->compiler_additions.out_of_range_multi_dim_error = this->create_basic_block(false, "outofrangemultidim");
-				Vec<Uptr<mir::Operand>> args;
-				args.push_back(mkuptr<mir::Place>(this->get_compiler_addition_line_number()));
-				args.push_back(mkuptr<mir::Place>(this->get_compiler_addition_error_dim()));
-				args.push_back(mkuptr<mir::Place>(this->get_compiler_addition_error_length()));
-				args.push_back(mkuptr<mir::Place>(this->get_compiler_addition_error_index()));
-				compiler_additions.out_of_range_multi_dim_error->instructions.push_back(mkuptr<mir::Instruction>(
-					Opt<Uptr<mir::Place>>(),
-					mkuptr<mir::FunctionCall>(
-						mkuptr<mir::ExtCodeConstant>(&mir::tensor_error),
-						mv(args)
-					)
-				));
+			mir::BasicBlock *block = this->create_basic_block(false, label_name);
+			if (this->unbox_int64s) {
+				// the reporters expect the encoded index and length
+				for (const Uptr<mir::Operand> &arg : args) {
+					const mir::Place *place = dynamic_cast<const mir::Place *>(arg.get());
+					if (!place) continue;
+					// %ARG <- %ARG << 1
+					block->instructions.push_back(mkuptr<mir::Instruction>(
+						mkuptr<mir::Place>(place->target),
+						mkuptr<mir::BinaryOperation>(mkuptr<mir::Place>(place->target), mkuptr<mir::Int64Constant>(1), mir::Operator::lshift)
+					));
+					// %ARG <- %ARG + 1
+					block->instructions.push_back(mkuptr<mir::Instruction>(
+						mkuptr<mir::Place>(place->target),
+						mkuptr<mir::BinaryOperation>(mkuptr<mir::Place>(place->target), mkuptr<mir::Int64Constant>(1), mir::Operator::plus)
+					));
+				}
 			}
-			return this->compiler_additions.out_of_range_multi_dim_error;
+			block->instructions.push_back(mkuptr<mir::Instruction>(
+				Opt<Uptr<mir::Place>>(),
+				mkuptr<mir::FunctionCall>(
+					mkuptr<mir::ExtCodeConstant>(reporter),
+					mv(args)
+				)
+			));
+			this->compiler_additions.error_reporters.insert({ mv(label_name), block });
+			return block;
+		}
+		mir::BasicBlock *get_compiler_addition_unalloced_error(int64_t line) {
+			Vec<Uptr<mir::Operand>> args;
+			args.push_back(this->encode(mkuptr<mir::Int64Constant>(line)));
+			return this->get_compiler_addition_error_reporter("unallocederror" + std::to_string(line), &mir::tensor_error, mv(args));
+		}
+		mir::BasicBlock *get_compiler_addition_out_of_range_tuple_error(int64_t line) {
+			Vec<Uptr<mir::Operand>> args;
+			args.push_back(this->encode(mkuptr<mir::Int64Constant>(line)));
+			args.push_back(mkuptr<mir::Place>(this->get_compiler_addition_error_length()));
+			args.push_back(mkuptr<mir::Place>(this->get_compiler_addition_error_index()));
+			return this->get_compiler_addition_error_reporter("outofrangetuple" + std::to_string(line), &mir::tuple_error, mv(args));
+		}
+		mir::BasicBlock *get_compiler_addition_out_of_range_one_dim_error(int64_t line) {
+			Vec<Uptr<mir::Operand>> args;
+			args.push_back(this->encode(mkuptr<mir::Int64Constant>(line)));
+			args.push_back(mkuptr<mir::Place>(this->get_compiler_addition_error_length()));
+			args.push_back(mkuptr<mir::Place>(this->get_compiler_addition_error_index()));
+			return this->get_compiler_addition_error_reporter("outofrangeonedim" + std::to_string(line), &mir::tensor_error, mv(args));
+		}
+		mir::BasicBlock *get_compiler_addition_out_of_range_multi_dim_error(int64_t line, int64_t dim) {
+			Vec<Uptr<mir::Operand>> args;
+			args.push_back(this->encode(mkuptr<mir::Int64Constant>(line)));
+			args.push_back(this->encode(mkuptr<mir::Int64Constant>(dim)));
+			args.push_back(mkuptr<mir::Place>(this->get_compiler_addition_error_length()));
+			args.push_back(mkuptr<mir::Place>(this->get_compiler_addition_error_index()));
+			return this->get_compiler_addition_error_reporter(
+				"outofrangemultidim" + std::to_string(line) + "_" + std::to_string(dim),
+				&mir::tensor_error,
+				mv(args)
+			);
 		}
 
 		public:
@@ -139,34 +135,38 @@ namespace La::hir_to_mir {
 			mir::FunctionDef &mir_function,
 			const Map<hir::ExternalFunction *, mir::ExternalFunction *> &ext_func_map,
 			const Map<hir::LaFunction *, mir::FunctionDef *> &func_map,
-			Map<hir::Variable *, mir::LocalVar *> &var_map
+			Map<hir::Variable *, mir::LocalVar *> &var_map,
+			bool unbox_int64s
 		) :
 			mir_function { mir_function },
 			ext_func_map { ext_func_map },
 			func_map { func_map },
 			var_map { var_map },
 			block_map {},
+			unbox_int64s { unbox_int64s },
 			compiler_additions {
 				nullptr,
 				nullptr,
 				nullptr,
-				nullptr,
-				nullptr,
-				nullptr,
-				nullptr,
-				nullptr,
-				nullptr
+				{}
 			},
-			active_basic_block_nullable { nullptr }
+			active_basic_block_nullable { nullptr },
+			free_temps {},
+			instruction_temps {},
+			num_temps { 0 }
 		{}
 
 		void visit(hir::InstructionDeclaration &inst) override {
 			this->ensure_active_basic_block();
 			Uptr<mir::Operand> dest_operand = this->evaluate_expr(inst.variable);
 			Uptr<mir::Place> dest_place = utils::downcast_uptr<mir::Operand, mir::Place>(mv(dest_operand));
+			Uptr<mir::Operand> default_value = inst.type.get_default_value();
+			if (this->unbox_int64s && is_int64(inst.type)) {
+				default_value = mkuptr<mir::Int64Constant>(0);
+			}
 			this->add_inst(
 				mv(dest_place),
-				inst.type.get_default_value()
+				mv(default_value)
 			);
 		}
 		void visit(hir::InstructionAssignment &inst) override {
@@ -219,13 +219,19 @@ namespace La::hir_to_mir {
 		void visit(hir::InstructionBranchConditional &inst) override {
 			this->ensure_active_basic_block();
 			this->active_basic_block_nullable->terminator = mir::BasicBlock::Branch {
-				this->decode(this->evaluate_expr(inst.condition)),
+				this->evaluate_int64(inst.condition),
 				this->get_basic_block_by_name(inst.then_label_name),
 				this->get_basic_block_by_name(inst.else_label_name)
 			};
 			this->active_basic_block_nullable = nullptr;
 		}
 
+		// the current instruction's temporaries are free for the next one
+		void release_temps() {
+			this->free_temps.insert(this->free_temps.end(), this->instruction_temps.rbegin(), this->instruction_temps.rend());
+			this->instruction_temps.clear();
+		}
+
 		void finish() {
 			if (this->mir_function.basic_blocks.empty()) {
 				this->create_basic_block(false, "");
@@ -235,9 +241,19 @@ namespace La::hir_to_mir {
 		private:
 
 		mir::LocalVar *make_local_var_int64(std::string debug_name) {
-			auto var_ptr = mkuptr<mir::LocalVar>(false, mv(debug_name), mir::Type { mir::Type::ArrayType { 0 } });
-			mir::LocalVar *result = var_ptr.get();
-			this->mir_function.local_vars.push_back(mv(var_ptr)); // TODO consider push_front?
+			return this->mir_function.add_local_var(false, mv(debug_name), mir::Type { mir::Type::ArrayType { 0 } });
+		}
+		// an int64 that is only used within the current instruction
+		mir::LocalVar *make_temp_var_int64() {
+			mir::LocalVar *result;
+			if (this->free_temps.empty()) {
+				result = this->make_local_var_int64("temp" + std::to_string(this->num_temps));
+				this->num_temps += 1;
+			} else {
+				result = this->free_temps.back();
+				this->free_temps.pop_back();
+			}
+			this->instruction_temps.push_back(result);
 			return result;
 		}
 
@@ -282,7 +298,7 @@ namespace La::hir_to_mir {
 			}
 		}
 		mir::BasicBlock *create_basic_block(bool user_labeled, std::string_view label_name) {
-			Uptr<mir::BasicBlock> block = mkuptr<mir::BasicBlock>(user_labeled, std::string(label_name));
+			Uptr<mir::BasicBlock> block = this->mir_function.make_basic_block(user_labeled, std::string(label_name));
 			if (std::holds_alternative<mir::Type::VoidType>(this->mir_function.return_type.type)) {
 				// no return value
 				block->terminator = mir::BasicBlock::ReturnVoid {};
@@ -312,14 +328,19 @@ namespace La::hir_to_mir {
 		// see also evaluate_expr
 		void evaluate_expr_into_existing_place(const Uptr<hir::Expr> &expr, Opt<Uptr<mir::Place>> place) {
 			if (const hir::BinaryOperation *bin_op = dynamic_cast<hir::BinaryOperation *>(expr.get())) {
-				mir::LocalVar *decoded_result = this->make_local_var_int64("");
+				Uptr<mir::BinaryOperation> result = mkuptr<mir::BinaryOperation>(
+					this->evaluate_int64(bin_op->lhs),
+					this->evaluate_int64(bin_op->rhs),
+					bin_op->op
+				);
+				if (this->unbox_int64s && is_local(place)) {
+					this->add_inst(mv(place), mv(result));
+					return;
+				}
+				mir::LocalVar *decoded_result = this->make_temp_var_int64();
 				this->add_inst(
 					mkuptr<mir::Place>(decoded_result),
-					mkuptr<mir::BinaryOperation>(
-						this->decode(this->evaluate_expr(bin_op->lhs)),
-						this->decode(this->evaluate_expr(bin_op->rhs)),
-						bin_op->op
-					)
+					mv(result)
 				);
 				this->add_inst(
 					mv(place),
@@ -328,14 +349,22 @@ namespace La::hir_to_mir {
 			} else if (const hir::LengthGetter *length_getter = dynamic_cast<hir::LengthGetter *>(expr.get())) {
 				Opt<Uptr<mir::Operand>> dimension;
 				if (length_getter->dimension.has_value()) {
-					dimension = this->decode(this->evaluate_expr(length_getter->dimension.value()));
+					dimension = this->evaluate_int64(length_getter->dimension.value());
+				}
+				Uptr<mir::LengthGetter> length = mkuptr<mir::LengthGetter>(
+					this->evaluate_expr(length_getter->target),
+					mv(dimension)
+				);
+				if (this->unbox_int64s && is_local(place)) {
+					// %TEMP_VAR <- length %TARGET DIM
+					mir::LocalVar *encoded_length = this->make_temp_var_int64();
+					this->add_inst(mkuptr<mir::Place>(encoded_length), mv(length));
+					this->add_inst(mv(place), this->decode(mkuptr<mir::Place>(encoded_length)));
+					return;
 				}
 				this->add_inst(
 					mv(place),
-					mkuptr<mir::LengthGetter>(
-						this->evaluate_expr(length_getter->target),
-						mv(dimension)
-					)
+					mv(length)
 				);
 			} else if (const hir::FunctionCall *call = dynamic_cast<hir::FunctionCall *>(expr.get())) {
 				this->add_inst(
@@ -345,7 +374,7 @@ namespace La::hir_to_mir {
 			} else if (const hir::NewArray *new_array = dynamic_cast<hir::NewArray *>(expr.get())) {
 				Vec<Uptr<mir::Operand>> dimension_lengths;
 				for (const Uptr<hir::Expr> &hir_dim_len : new_array->dimension_lengths) {
-					dimension_lengths.push_back(this->evaluate_expr(hir_dim_len));
+					dimension_lengths.push_back(this->evaluate_encoded(hir_dim_len));
 				}
 				this->add_inst(
 					mv(place),
@@ -354,13 +383,38 @@ namespace La::hir_to_mir {
 			} else if (const hir::NewTuple *new_tuple = dynamic_cast<hir::NewTuple *>(expr.get())) {
 				this->add_inst(
 					mv(place),
-					mkuptr<mir::NewTuple>(this->evaluate_expr(new_tuple->length))
+					mkuptr<mir::NewTuple>(this->evaluate_encoded(new_tuple->length))
+				);
+			} else if (!this->unbox_int64s) {
+				this->add_inst(
+					mv(place),
+					this->evaluate_expr(expr)
+				);
+			} else if (!is_local(place)) {
+				// a store to memory
+				this->add_inst(
+					mv(place),
+					this->evaluate_encoded(expr)
 				);
 			} else {
+				const hir::IndexingExpr *indexing_expr = dynamic_cast<hir::IndexingExpr *>(expr.get());
+				mir::LocalVar *dest_var = place.value()->target;
 				this->add_inst(
 					mv(place),
 					this->evaluate_expr(expr)
 				);
+				if (indexing_expr && indexing_expr->indices.size() > 0 && is_int64(dest_var->type)) {
+					// a load of an int64 from memory
+					// %DEST <- %DEST >> 1
+					this->add_inst(
+						mkuptr<mir::Place>(dest_var),
+						mkuptr<mir::BinaryOperation>(
+							mkuptr<mir::Place>(dest_var),
+							mkuptr<mir::Int64Constant>(1),
+							mir::Operator::rshift
+						)
+					);
+				}
 			}
 		}
 
@@ -393,7 +447,8 @@ namespace La::hir_to_mir {
 					exit(1);
 				}
 			} else if (const hir::NumberLiteral *num_lit = dynamic_cast<hir::NumberLiteral *>(expr.get())) {
-				return this->encode(mkuptr<mir::Int64Constant>(num_lit->value));
+				Uptr<mir::Operand> constant = mkuptr<mir::Int64Constant>(num_lit->value);
+				return this->unbox_int64s ? mv(constant) : this->encode(mv(constant));
 			} else if (const hir::IndexingExpr *indexing_expr = dynamic_cast<hir::IndexingExpr *>(expr.get())) {
 				return evaluate_indexing_expr(*indexing_expr);
 			} else {
@@ -423,7 +478,8 @@ namespace La::hir_to_mir {
 
 			Vec<Uptr<mir::Operand>> arguments;
 			for (const Uptr<hir::Expr> &hir_arg : call.arguments) {
-				arguments.push_back(this->evaluate_expr(hir_arg));
+				// LA functions take int64s the same way the locals hold them
+				arguments.push_back(std_func_nullable ? this->evaluate_encoded(hir_arg) : this->evaluate_expr(hir_arg));
 			}
 
 			Uptr<mir::Rvalue> result = mkuptr<mir::FunctionCall>(
@@ -431,12 +487,15 @@ namespace La::hir_to_mir {
 				mv(arguments)
 			);
 			if (std_func_nullable && std_func_nullable->returns_val) {
-				mir::LocalVar *temp_var = this->make_local_var_int64("");
+				mir::LocalVar *temp_var = this->make_temp_var_int64();
 				this->add_inst(
 					mkuptr<mir::Place>(temp_var),
 					mv(result)
 				);
 				result = mkuptr<mir::Place>(temp_var);
+				if (this->unbox_int64s) {
+					result = this->decode(mkuptr<mir::Place>(temp_var));
+				}
 			}
 			return result;
 		}
@@ -455,13 +514,10 @@ namespace La::hir_to_mir {
 			if (hir::Variable *hir_var = dynamic_cast<hir::Variable *>(hir_name)) {
 				mir::LocalVar *mir_var = this->var_map.at(hir_var);
 
+				// the line that the error reporters name; only accesses have one
+				int64_t line = indexing_expr.indices.size() > 0 ? static_cast<int64_t>(indexing_expr.src_pos.value().line) : 0;
 				if (indexing_expr.indices.size() > 0) {
 					// check that the array was allocated
-					// %linenum <- LINE_NUM
-					this->add_inst(
-						mkuptr<mir::Place>(this->get_compiler_addition_line_number()),
-						this->encode(mkuptr<mir::Int64Constant>(static_cast<int64_t>(indexing_expr.src_pos.value().line)))
-					);
 					// %booooool <- %TARGET = 0
 					this->add_inst(
 						mkuptr<mir::Place>(this->get_compiler_addition_temp_condition()),
@@ -471,28 +527,25 @@ namespace La::hir_to_mir {
 							mir::Operator::eq
 						)
 					);
-					// br %booooool :unallocederror :CONTINUE
-					this->branch_to_block(this->get_compiler_addition_unalloced_error());
+					// br %booooool :unallocederrorLINE_NUM :CONTINUE
+					this->branch_to_block(this->get_compiler_addition_unalloced_error(line));
 				}
 
 
 				Vec<Uptr<mir::Operand>> mir_indices;
 				if (indexing_expr.indices.size() > 0) {
 					bool is_tuple = std::holds_alternative<mir::Type::TupleType>(mir_var->type.type);
-					mir::BasicBlock *error_reporter;
-					bool is_multi_dim = false;
-					if (is_tuple) {
-						error_reporter = this->get_compiler_addition_out_of_range_tuple_error();
-					} else if (indexing_expr.indices.size() == 1) {
-						error_reporter = this->get_compiler_addition_out_of_range_one_dim_error();
-					} else {
-						// must be a multi-dimensional tensor
-						error_reporter = this->get_compiler_addition_out_of_range_multi_dim_error();
-						is_multi_dim = true;
-					}
-
 					for (int dim_num = 0; dim_num < indexing_expr.indices.size(); ++dim_num) {
 						assert(!is_tuple || dim_num == 0);
+						mir::BasicBlock *error_reporter;
+						if (is_tuple) {
+							error_reporter = this->get_compiler_addition_out_of_range_tuple_error(line);
+						} else if (indexing_expr.indices.size() == 1) {
+							error_reporter = this->get_compiler_addition_out_of_range_one_dim_error(line);
+						} else {
+							// must be a multi-dimensional tensor
+							error_reporter = this->get_compiler_addition_out_of_range_multi_dim_error(line, dim_num);
+						}
 						const Uptr<hir::Expr> &hir_index = indexing_expr.indices[dim_num];
 
 						Uptr<mir::Operand> mir_index = this->evaluate_expr(hir_index);
@@ -511,19 +564,23 @@ namespace La::hir_to_mir {
 								is_tuple ? Opt<Uptr<mir::Operand>>() : mkuptr<mir::Int64Constant>(dim_num)
 							)
 						);
-						if (is_multi_dim) {
-							// %errordim <- encoded(DIM_NUM)
+						if (this->unbox_int64s) {
+							// %errorlength <- %errorlength >> 1
 							this->add_inst(
-								mkuptr<mir::Place>(this->get_compiler_addition_error_dim()),
-								this->encode(mkuptr<mir::Int64Constant>(dim_num))
+								mkuptr<mir::Place>(this->get_compiler_addition_error_length()),
+								mkuptr<mir::BinaryOperation>(
+									mkuptr<mir::Place>(this->get_compiler_addition_error_length()),
+									mkuptr<mir::Int64Constant>(1),
+									mir::Operator::rshift
+								)
 							);
 						}
-						// %booooool <- %errorindex < 1; compare with 1 instead of 0 because encoded(0) == 1
+						// %booooool <- %errorindex < 0; when boxed, compare with 1 instead because encoded(0) == 1
 						this->add_inst(
 							mkuptr<mir::Place>(this->get_compiler_addition_temp_condition()),
 							mkuptr<mir::BinaryOperation>(
 								mkuptr<mir::Place>(this->get_compiler_addition_error_index()),
-								mkuptr<mir::Int64Constant>(1),
+								mkuptr<mir::Int64Constant>(this->unbox_int64s ? 0 : 1),
 								mir::Operator::lt
 							)
 						);
@@ -541,7 +598,7 @@ namespace La::hir_to_mir {
 						// br %booooool :ERROR_REPORTER :CONTINUE
 						this->branch_to_block(error_reporter);
 
-						mir_indices.push_back(this->decode(mv(mir_index)));
+						mir_indices.push_back(this->unbox_int64s ? mv(mir_index) : this->decode(mv(mir_index)));
 					}
 				}
 
@@ -558,6 +615,32 @@ namespace La::hir_to_mir {
 			}
 		}
 
+		// the expression's value as a plain int64
+		Uptr<mir::Operand> evaluate_int64(const Uptr<hir::Expr> &expr) {
+			Uptr<mir::Operand> operand = this->evaluate_expr(expr);
+			return this->unbox_int64s ? mv(operand) : this->decode(mv(operand));
+		}
+		// the expression's value the way memory and external functions hold
+		// it
+		Uptr<mir::Operand> evaluate_encoded(const Uptr<hir::Expr> &expr) {
+			Uptr<mir::Operand> operand = this->evaluate_expr(expr);
+			if (!this->unbox_int64s) {
+				return operand;
+			}
+			mir::Place *place = dynamic_cast<mir::Place *>(operand.get());
+			if (dynamic_cast<mir::Int64Constant *>(operand.get()) || (place && place->indices.empty() && is_int64(place->target->type))) {
+				return this->encode(mv(operand));
+			}
+			return operand; // pointers aren't encoded
+		}
+		static bool is_int64(const mir::Type &type) {
+			const mir::Type::ArrayType *array_type = std::get_if<mir::Type::ArrayType>(&type.type);
+			return array_type && array_type->num_dimensions == 0;
+		}
+		static bool is_local(const Opt<Uptr<mir::Place>> &place) {
+			return place.has_value() && place.value()->indices.empty();
+		}
+
 		Uptr<mir::Operand> encode(Uptr<mir::Operand> operand) {
 			if (mir::Int64Constant *num = dynamic_cast<mir::Int64Constant *>(operand.get())) {
 				num->value = num->value * 2 + 1;
@@ -574,7 +657,7 @@ namespace La::hir_to_mir {
 						// encode an int64 by bit-shifting
 
 						// %TEMP_VAR <- %OPERAND << 1
-						mir::LocalVar *temp_var = this->make_local_var_int64("");
+						mir::LocalVar *temp_var = this->make_temp_var_int64();
 						this->add_inst(
 							mkuptr<mir::Place>(temp_var),
 							mkuptr<mir::BinaryOperation>(
@@ -631,7 +714,7 @@ namespace La::hir_to_mir {
 				const mir::Type::ArrayType &arr_type = std::get<mir::Type::ArrayType>(place->target->type.type);
 				// assert(arr_type.num_dimensions == 0); TODO why is this assertion sometimes failing?
 
-				mir::LocalVar *decoded_var = this->make_local_var_int64("");
+				mir::LocalVar *decoded_var = this->make_temp_var_int64();
 				this->add_inst(
 					mkuptr<mir::Place>(decoded_var),
 					mkuptr<mir::BinaryOperation>(
@@ -657,33 +740,35 @@ namespace La::hir_to_mir {
 		mir::FunctionDef &mir_function,
 		const hir::LaFunction &hir_function,
 		const Map<hir::LaFunction *, mir::FunctionDef *> &func_map,
-		const Map<hir::ExternalFunction *, mir::ExternalFunction *> &ext_func_map
+		const Map<hir::ExternalFunction *, mir::ExternalFunction *> &ext_func_map,
+		bool unbox_int64s
 	) {
 		Map<hir::Variable *, mir::LocalVar *> var_map;
 
 		// transfer the user-declared local variables and parameters
 		for (const Uptr<hir::Variable> &hir_var : hir_function.vars) {
-			Uptr<mir::LocalVar> mir_var = mkuptr<mir::LocalVar>(
+			mir::LocalVar *mir_var = mir_function.add_local_var(
 				true,
 				hir_var->name,
 				hir_var->type
 			);
-			var_map.insert_or_assign(hir_var.get(), mir_var.get());
-			mir_function.local_vars.push_back(mv(mir_var));
+			mir_var->is_encoded = !unbox_int64s;
+			var_map.insert_or_assign(hir_var.get(), mir_var);
 		}
 		for (hir::Variable *parameter_var : hir_function.parameter_vars) {
 			mir_function.parameter_vars.push_back(var_map.at(parameter_var));
 		}
 
 		// transfer over each instruction into the basic blocks
-		InstructionAdder inst_adder(mir_function, ext_func_map, func_map, var_map);
+		InstructionAdder inst_adder(mir_function, ext_func_map, func_map, var_map, unbox_int64s);
 		for (const Uptr<hir::Instruction> &hir_inst : hir_function.instructions) {
 			hir_inst->accept(inst_adder);
+			inst_adder.release_temps();
 		}
 		inst_adder.finish();
 	}
 
-	Uptr<mir::Program> make_mir_program(const hir::Program &hir_program) {
+	Uptr<mir::Program> make_mir_program(const hir::Program &hir_program, bool unbox_int64s) {
 		auto mir_program = mkuptr<mir::Program>();
 
 		Map<hir::ExternalFunction *, mir::ExternalFunction *> ext_func_map;
@@ -705,7 +790,7 @@ namespace La::hir_to_mir {
 		}
 
 		for (const auto [hir_function, mir_function] : func_map) {
-			fill_mir_function(*mir_function, *hir_function, func_map, ext_func_map);
+			fill_mir_function(*mir_function, *hir_function, func_map, ext_func_map, unbox_int64s);
 		}
 
 		return mir_program;
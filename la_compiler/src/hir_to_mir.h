@@ -6,5 +6,8 @@
 namespace La::hir_to_mir {
 	using namespace std_alias;
 
-	Uptr<mir::Program> make_mir_program(const hir::Program &hir_program);
+	// In unboxed mode, int64 local variables, parameters and return values
+	// hold plain values, and the encoding is applied only where a value goes
+	// to or comes from memory or an external function.
+	Uptr<mir::Program> make_mir_program(const hir::Program &hir_program, bool unbox_int64s);
 }
@@ -52,9 +52,9 @@ namespace mir {
 	}
 	std::string LocalVar::get_unambiguous_name() const {
 		if (this->is_user_declared) {
-			return "uservar_" + std::to_string(reinterpret_cast<uintptr_t>(this)) + "_" + this->name;
+			return "uservar" + std::to_string(this->number) + "_" + this->name;
 		} else if (this->name.size() == 0) {
-			return "var_" + std::to_string(reinterpret_cast<uintptr_t>(this));
+			return "var" + std::to_string(this->number);
 		} else {
 			return this->name;
 		}
@@ -70,6 +70,25 @@ namespace mir {
 		}
 		return result;
 	}
+	Uptr<Place> Place::clone_place() const {
+		Vec<Uptr<Operand>> indices;
+		for (const Uptr<Operand> &index : this->indices) {
+			indices.push_back(index->clone_operand());
+		}
+		return mkuptr<Place>(this->target, mv(indices));
+	}
+	void Place::collect_operands(Vec<Uptr<Operand> *> &result) {
+		for (Uptr<Operand> &index : this->indices) {
+			result.push_back(&index);
+			index->collect_operands(result);
+		}
+	}
+	void Place::collect_vars_read(Vec<LocalVar *> &result) const {
+		result.push_back(this->target);
+		for (const Uptr<Operand> &index : this->indices) {
+			index->collect_vars_read(result);
+		}
+	}
 
 	std::string Int64Constant::to_ir_syntax() const {
 		return std::to_string(this->value);
@@ -95,6 +114,19 @@ namespace mir {
 			+ mir::to_string(this->op) + " "
 			+ this->rhs->to_ir_syntax();
 	}
+	Uptr<Rvalue> BinaryOperation::clone() const {
+		return mkuptr<BinaryOperation>(this->lhs->clone_operand(), this->rhs->clone_operand(), this->op);
+	}
+	void BinaryOperation::collect_operands(Vec<Uptr<Operand> *> &result) {
+		result.push_back(&this->lhs);
+		this->lhs->collect_operands(result);
+		result.push_back(&this->rhs);
+		this->rhs->collect_operands(result);
+	}
+	void BinaryOperation::collect_vars_read(Vec<LocalVar *> &result) const {
+		this->lhs->collect_vars_read(result);
+		this->rhs->collect_vars_read(result);
+	}
 
 	std::string LengthGetter::to_ir_syntax() const {
 		std::string result = "length " + this->target->to_ir_syntax();
@@ -103,6 +135,27 @@ namespace mir {
 		}
 		return result;
 	}
+	Uptr<Rvalue> LengthGetter::clone() const {
+		Opt<Uptr<Operand>> dimension;
+		if (this->dimension.has_value()) {
+			dimension = this->dimension.value()->clone_operand();
+		}
+		return mkuptr<LengthGetter>(this->target->clone_operand(), mv(dimension));
+	}
+	void LengthGetter::collect_operands(Vec<Uptr<Operand> *> &result) {
+		result.push_back(&this->target);
+		this->target->collect_operands(result);
+		if (this->dimension.has_value()) {
+			result.push_back(&this->dimension.value());
+			this->dimension.value()->collect_operands(result);
+		}
+	}
+	void LengthGetter::collect_vars_read(Vec<LocalVar *> &result) const {
+		this->target->collect_vars_read(result);
+		if (this->dimension.has_value()) {
+			this->dimension.value()->collect_vars_read(result);
+		}
+	}
 
 	std::string Instruction::to_ir_syntax() const {
 		std::string result;
@@ -112,6 +165,31 @@ namespace mir {
 		result += this->rvalue->to_ir_syntax();
 		return result;
 	}
+	Uptr<Instruction> Instruction::clone() const {
+		Opt<Uptr<Place>> destination;
+		if (this->destination.has_value()) {
+			destination = this->destination.value()->clone_place();
+		}
+		return mkuptr<Instruction>(mv(destination), this->rvalue->clone());
+	}
+	void Instruction::collect_operands(Vec<Uptr<Operand> *> &result) {
+		if (this->destination.has_value()) {
+			this->destination.value()->collect_operands(result);
+		}
+		this->rvalue->collect_operands(result);
+	}
+	void Instruction::collect_vars_read(Vec<LocalVar *> &result) const {
+		if (this->destination.has_value() && !this->destination.value()->indices.empty()) {
+			this->destination.value()->collect_vars_read(result);
+		}
+		this->rvalue->collect_vars_read(result);
+	}
+	Opt<LocalVar *> Instruction::get_var_written() const {
+		if (this->destination.has_value() && this->destination.value()->indices.empty()) {
+			return this->destination.value()->target;
+		}
+		return {};
+	}
 
 	std::string FunctionCall::to_ir_syntax() const {
 		std::string result = "call " + this->callee->to_ir_syntax() + "(";
@@ -122,9 +200,30 @@ namespace mir {
 		result += ")";
 		return result;
 	}
+	Uptr<Rvalue> FunctionCall::clone() const {
+		Vec<Uptr<Operand>> arguments;
+		for (const Uptr<Operand> &arg : this->arguments) {
+			arguments.push_back(arg->clone_operand());
+		}
+		return mkuptr<FunctionCall>(this->callee->clone_operand(), mv(arguments));
+	}
+	void FunctionCall::collect_operands(Vec<Uptr<Operand> *> &result) {
+		result.push_back(&this->callee);
+		this->callee->collect_operands(result);
+		for (Uptr<Operand> &arg : this->arguments) {
+			result.push_back(&arg);
+			arg->collect_operands(result);
+		}
+	}
+	void FunctionCall::collect_vars_read(Vec<LocalVar *> &result) const {
+		this->callee->collect_vars_read(result);
+		for (const Uptr<Operand> &arg : this->arguments) {
+			arg->collect_vars_read(result);
+		}
+	}
 
 	std::string NewArray::to_ir_syntax() const {
-		std::string result = "new Array(";
+		std::string result = this->in_frame ? "new frame Array(" : "new Array(";
 		result += utils::format_comma_delineated_list(
 			this->dimension_lengths,
 			[](const Uptr<Operand> &arg){ return arg->to_ir_syntax(); }
@@ -132,9 +231,41 @@ namespace mir {
 		result += ")";
 		return result;
 	}
+	Uptr<Rvalue> NewArray::clone() const {
+		Vec<Uptr<Operand>> dimension_lengths;
+		for (const Uptr<Operand> &length : this->dimension_lengths) {
+			dimension_lengths.push_back(length->clone_operand());
+		}
+		Uptr<NewArray> result = mkuptr<NewArray>(mv(dimension_lengths));
+		result->in_frame = this->in_frame;
+		return result;
+	}
+	void NewArray::collect_operands(Vec<Uptr<Operand> *> &result) {
+		for (Uptr<Operand> &length : this->dimension_lengths) {
+			result.push_back(&length);
+			length->collect_operands(result);
+		}
+	}
+	void NewArray::collect_vars_read(Vec<LocalVar *> &result) const {
+		for (const Uptr<Operand> &length : this->dimension_lengths) {
+			length->collect_vars_read(result);
+		}
+	}
 
 	std::string NewTuple::to_ir_syntax() const {
-		return "new Tuple(" + this->length->to_ir_syntax() + ")";
+		return (this->in_frame ? "new frame Tuple(" : "new Tuple(") + this->length->to_ir_syntax() + ")";
+	}
+	Uptr<Rvalue> NewTuple::clone() const {
+		Uptr<NewTuple> result = mkuptr<NewTuple>(this->length->clone_operand());
+		result->in_frame = this->in_frame;
+		return result;
+	}
+	void NewTuple::collect_operands(Vec<Uptr<Operand> *> &result) {
+		result.push_back(&this->length);
+		this->length->collect_operands(result);
+	}
+	void NewTuple::collect_vars_read(Vec<LocalVar *> &result) const {
+		this->length->collect_vars_read(result);
 	}
 
 	std::string BasicBlock::to_ir_syntax(Opt<Vec<LocalVar *>> vars_to_declare) const {
@@ -171,11 +302,42 @@ namespace mir {
 	}
 	std::string BasicBlock::get_unambiguous_name() const {
 		if (this->user_labeled) {
-			return "userblock_" + std::to_string(reinterpret_cast<uintptr_t>(this)) + "_" + this->label_name;
+			return "userblock" + std::to_string(this->number) + "_" + this->label_name;
 		} else if (this->label_name.size() > 0) {
 			return this->label_name;
 		} else {
-			return "block_" + std::to_string(reinterpret_cast<uintptr_t>(this));
+			return "block" + std::to_string(this->number);
+		}
+	}
+	BasicBlock::Terminator BasicBlock::clone_terminator() const {
+		if (std::get_if<ReturnVoid>(&this->terminator)) {
+			return ReturnVoid {};
+		} else if (const ReturnVal *term = std::get_if<ReturnVal>(&this->terminator)) {
+			return ReturnVal { term->return_value->clone_operand() };
+		} else if (const Goto *term = std::get_if<Goto>(&this->terminator)) {
+			return Goto { term->successor };
+		} else if (const Branch *term = std::get_if<Branch>(&this->terminator)) {
+			return Branch { term->condition->clone_operand(), term->then_block, term->else_block };
+		} else {
+			std::cerr << "Logic error: inexhaustive match on Terminator variant\n";
+			exit(1);
+		}
+	}
+
+	void BasicBlock::collect_operands(Vec<Uptr<Operand> *> &result) {
+		if (ReturnVal *term = std::get_if<ReturnVal>(&this->terminator)) {
+			result.push_back(&term->return_value);
+			term->return_value->collect_operands(result);
+		} else if (Branch *term = std::get_if<Branch>(&this->terminator)) {
+			result.push_back(&term->condition);
+			term->condition->collect_operands(result);
+		}
+	}
+	void BasicBlock::collect_vars_read(Vec<LocalVar *> &result) const {
+		if (const ReturnVal *term = std::get_if<ReturnVal>(&this->terminator)) {
+			term->return_value->collect_vars_read(result);
+		} else if (const Branch *term = std::get_if<Branch>(&this->terminator)) {
+			term->condition->collect_vars_read(result);
 		}
 	}
 
@@ -208,6 +370,20 @@ namespace mir {
 		// the user-given name is already unambiguous
 		return this->user_given_name;
 	}
+	LocalVar *FunctionDef::add_local_var(bool is_user_declared, std::string name, Type type) {
+		Uptr<LocalVar> var = mkuptr<LocalVar>(is_user_declared, mv(name), type);
+		var->number = this->num_local_vars_made;
+		this->num_local_vars_made += 1;
+		LocalVar *result = var.get();
+		this->local_vars.push_back(mv(var));
+		return result;
+	}
+	Uptr<BasicBlock> FunctionDef::make_basic_block(bool user_labeled, std::string label_name) {
+		Uptr<BasicBlock> block = mkuptr<BasicBlock>(user_labeled, mv(label_name));
+		block->number = this->num_basic_blocks_made;
+		this->num_basic_blocks_made += 1;
+		return block;
+	}
 
 	std::string Program::to_ir_syntax() const {
 		std::string result;
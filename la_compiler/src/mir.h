@@ -32,6 +32,8 @@ namespace mir {
 		bool is_user_declared;
 		std::string name; // empty means anonymous
 		Type type;
+		bool is_encoded = false; // an int64 that always holds an encoded value
+		int64_t number = 0; // unique within the function; see FunctionDef::add_local_var
 
 		LocalVar(bool is_user_declared, std::string name, Type type) :
 			is_user_declared { is_user_declared }, name { mv(name) }, type { type }
@@ -47,9 +49,17 @@ namespace mir {
 	// closely resembles hir::Expr
 	struct Rvalue {
 		virtual std::string to_ir_syntax() const = 0;
+		virtual Uptr<Rvalue> clone() const = 0; // the copy refers to the same LocalVars
+		// the operands inside this one, including the indices of places,
+		// so that passes can replace them
+		virtual void collect_operands(Vec<Uptr<Operand> *> &result) {}
+		virtual void collect_vars_read(Vec<LocalVar *> &result) const {}
 	};
 
-	struct Operand : Rvalue {};
+	struct Operand : Rvalue {
+		Uptr<Rvalue> clone() const override { return this->clone_operand(); }
+		virtual Uptr<Operand> clone_operand() const = 0;
+	};
 
 	// a "place" in memory, which can be assigned to as the left-hand side of
 	// an InstructionAssignment.
@@ -65,6 +75,10 @@ namespace mir {
 		{}
 
 		std::string to_ir_syntax() const override;
+		Uptr<Operand> clone_operand() const override { return this->clone_place(); }
+		Uptr<Place> clone_place() const;
+		void collect_operands(Vec<Uptr<Operand> *> &result) override;
+		void collect_vars_read(Vec<LocalVar *> &result) const override;
 	};
 
 	struct Int64Constant : Operand {
@@ -73,6 +87,7 @@ namespace mir {
 		Int64Constant(int64_t value) : value { value } {}
 
 		std::string to_ir_syntax() const override;
+		Uptr<Operand> clone_operand() const override { return mkuptr<Int64Constant>(this->value); }
 	};
 
 	struct FunctionDef;
@@ -83,6 +98,7 @@ namespace mir {
 		CodeConstant(FunctionDef *value) : value { value } {}
 
 		std::string to_ir_syntax() const override;
+		Uptr<Operand> clone_operand() const override { return mkuptr<CodeConstant>(this->value); }
 	};
 
 	struct ExternalFunction;
@@ -93,6 +109,7 @@ namespace mir {
 		ExtCodeConstant(ExternalFunction *value) : value { value } {}
 
 		std::string to_ir_syntax() const override;
+		Uptr<Operand> clone_operand() const override { return mkuptr<ExtCodeConstant>(this->value); }
 	};
 
 	enum struct Operator {
@@ -120,6 +137,9 @@ namespace mir {
 		{}
 
 		std::string to_ir_syntax() const override;
+		Uptr<Rvalue> clone() const override;
+		void collect_operands(Vec<Uptr<Operand> *> &result) override;
+		void collect_vars_read(Vec<LocalVar *> &result) const override;
 	};
 
 	struct LengthGetter : Rvalue {
@@ -131,6 +151,9 @@ namespace mir {
 		{}
 
 		std::string to_ir_syntax() const override;
+		Uptr<Rvalue> clone() const override;
+		void collect_operands(Vec<Uptr<Operand> *> &result) override;
+		void collect_vars_read(Vec<LocalVar *> &result) const override;
 	};
 
 	struct FunctionCall : Rvalue {
@@ -142,22 +165,33 @@ namespace mir {
 		{}
 
 		std::string to_ir_syntax() const override;
+		Uptr<Rvalue> clone() const override;
+		void collect_operands(Vec<Uptr<Operand> *> &result) override;
+		void collect_vars_read(Vec<LocalVar *> &result) const override;
 	};
 
 	struct NewArray : Rvalue {
 		Vec<Uptr<Operand>> dimension_lengths;
+		bool in_frame = false; // see escape_analysis.h
 
 		NewArray(Vec<Uptr<Operand>> dimension_lengths) : dimension_lengths { mv(dimension_lengths) } {}
 
 		std::string to_ir_syntax() const override;
+		Uptr<Rvalue> clone() const override;
+		void collect_operands(Vec<Uptr<Operand> *> &result) override;
+		void collect_vars_read(Vec<LocalVar *> &result) const override;
 	};
 
 	struct NewTuple : Rvalue {
 		Uptr<Operand> length;
+		bool in_frame = false; // see escape_analysis.h
 
 		NewTuple(Uptr<Operand> length) : length { mv(length) } {}
 
 		std::string to_ir_syntax() const override;
+		Uptr<Rvalue> clone() const override;
+		void collect_operands(Vec<Uptr<Operand> *> &result) override;
+		void collect_vars_read(Vec<LocalVar *> &result) const override;
 	};
 
 	// mir::Instruction represents an elementary type-aware option, unlike
@@ -173,6 +207,14 @@ namespace mir {
 		{}
 
 		std::string to_ir_syntax() const;
+		Uptr<Instruction> clone() const;
+		// includes the indices of the destination, and not the rvalue
+		// itself when it is an operand. The array a store writes to counts
+		// as read.
+		void collect_operands(Vec<Uptr<Operand> *> &result);
+		void collect_vars_read(Vec<LocalVar *> &result) const;
+		// the variable the instruction assigns, if it doesn't store to memory
+		Opt<LocalVar *> get_var_written() const;
 	};
 
 	struct BasicBlock {
@@ -191,6 +233,7 @@ namespace mir {
 		std::string label_name;
 		Vec<Uptr<Instruction>> instructions;
 		Terminator terminator;
+		int64_t number = 0; // unique within the function; see FunctionDef::make_basic_block
 
 		BasicBlock(bool user_labeled, std::string label_name) :
 			user_labeled { user_labeled },
@@ -201,6 +244,10 @@ namespace mir {
 
 		std::string to_ir_syntax(Opt<Vec<LocalVar *>> vars_to_declare) const;
 		std::string get_unambiguous_name() const;
+		Terminator clone_terminator() const;
+		// the terminator's operands
+		void collect_operands(Vec<Uptr<Operand> *> &result);
+		void collect_vars_read(Vec<LocalVar *> &result) const;
 	};
 
 	struct FunctionDef {
@@ -209,6 +256,8 @@ namespace mir {
 		Vec<Uptr<LocalVar>> local_vars;
 		Vec<LocalVar *> parameter_vars;
 		Vec<Uptr<BasicBlock>> basic_blocks; // the first block is always the entry block
+		int64_t num_local_vars_made = 0;
+		int64_t num_basic_blocks_made = 0;
 
 		explicit FunctionDef(std::string user_given_name, mir::Type return_type) :
 			user_given_name { mv(user_given_name) }, return_type { return_type }
@@ -216,6 +265,12 @@ namespace mir {
 
 		std::string to_ir_syntax() const;
 		std::string get_unambiguous_name() const;
+		// Variables and blocks are named after the order the function made
+		// them in rather than their addresses, so that the emitted IR is the
+		// same from run to run. Every variable and block of the function
+		// has to come from these.
+		LocalVar *add_local_var(bool is_user_declared, std::string name, Type type);
+		Uptr<BasicBlock> make_basic_block(bool user_labeled, std::string label_name); // the caller puts it in basic_blocks
 	};
 
 	struct ExternalFunction {
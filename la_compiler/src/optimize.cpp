@@ -0,0 +1,552 @@
+#include "optimize.h"
+#include "cfg.h"
+#include "dataflow.h"
+#include "range_analysis.h"
+#include "allocation_analysis.h"
+#include "escape_analysis.h"
+#include "scalar_replacement.h"
+#include <iostream>
+#include <algorithm>
+#include <iterator>
+
+namespace La::optimize {
+	using namespace std_alias;
+
+	bool is_int64(const mir::LocalVar *var) {
+		const mir::Type::ArrayType *array_type = std::get_if<mir::Type::ArrayType>(&var->type.type);
+		return array_type && array_type->num_dimensions == 0;
+	}
+
+	mir::LocalVar *get_var(const mir::Operand &operand) {
+		const mir::Place *place = dynamic_cast<const mir::Place *>(&operand);
+		return place && place->indices.empty() ? place->target : nullptr;
+	}
+
+	// evaluates the operator the way the generated code does
+	int64_t fold_operation(mir::Operator op, int64_t lhs, int64_t rhs) {
+		uint64_t ulhs = lhs;
+		uint64_t urhs = rhs;
+		switch (op) {
+			case mir::Operator::lt: return lhs < rhs;
+			case mir::Operator::le: return lhs <= rhs;
+			case mir::Operator::eq: return lhs == rhs;
+			case mir::Operator::ge: return lhs >= rhs;
+			case mir::Operator::gt: return lhs > rhs;
+			case mir::Operator::plus: return ulhs + urhs;
+			case mir::Operator::minus: return ulhs - urhs;
+			case mir::Operator::times: return ulhs * urhs;
+			case mir::Operator::bitwise_and: return lhs & rhs;
+			case mir::Operator::lshift: return ulhs << (rhs & 63);
+			case mir::Operator::rshift: return lhs >> (rhs & 63);
+		}
+		std::cerr << "Logic error: unknown operator\n";
+		exit(1);
+	}
+
+	struct ConstantState {
+		bool reachable;
+		Map<mir::LocalVar *, int64_t> constants; // variables that aren't here aren't known
+
+		bool operator==(const ConstantState &other) const {
+			return this->reachable == other.reachable && this->constants == other.constants;
+		}
+	};
+
+	Opt<int64_t> evaluate_operand(const ConstantState &state, const mir::Operand &operand) {
+		if (const mir::Int64Constant *constant = dynamic_cast<const mir::Int64Constant *>(&operand)) {
+			return constant->value;
+		}
+		if (mir::LocalVar *var = get_var(operand)) {
+			if (auto it = state.constants.find(var); it != state.constants.end()) {
+				return it->second;
+			}
+		}
+		return {};
+	}
+
+	Opt<int64_t> evaluate_rvalue(const ConstantState &state, const mir::Rvalue &rvalue) {
+		if (const mir::Operand *operand = dynamic_cast<const mir::Operand *>(&rvalue)) {
+			return evaluate_operand(state, *operand);
+		} else if (const mir::BinaryOperation *bin_op = dynamic_cast<const mir::BinaryOperation *>(&rvalue)) {
+			Opt<int64_t> lhs = evaluate_operand(state, *bin_op->lhs);
+			Opt<int64_t> rhs = evaluate_operand(state, *bin_op->rhs);
+			if (lhs && rhs) {
+				return fold_operation(bin_op->op, *lhs, *rhs);
+			}
+		}
+		return {};
+	}
+
+	struct ConstantProblem {
+		using State = ConstantState;
+
+		State get_boundary_state() {
+			return State { true, {} };
+		}
+		State get_unreachable_state() {
+			return State { false, {} };
+		}
+		State join(const State &a, const State &b) {
+			if (!a.reachable) return b;
+			if (!b.reachable) return a;
+			State result { true, {} };
+			for (auto [var, value] : a.constants) {
+				if (auto it = b.constants.find(var); it != b.constants.end() && it->second == value) {
+					result.constants.insert({ var, value });
+				}
+			}
+			return result;
+		}
+		void transfer(State &state, const mir::Instruction &inst) {
+			Opt<mir::LocalVar *> var = inst.get_var_written();
+			if (!state.reachable || !var) return;
+			Opt<int64_t> value = evaluate_rvalue(state, *inst.rvalue);
+			state.constants.erase(*var);
+			if (value && is_int64(*var)) {
+				state.constants.insert({ *var, *value });
+			}
+		}
+		// branches are taken when the condition is 1
+		void transfer_branch(State &state, const mir::Operand &condition, bool taken) {
+			Opt<int64_t> value = evaluate_operand(state, condition);
+			if (value && (*value == 1) != taken) {
+				state = this->get_unreachable_state();
+			}
+		}
+	};
+
+	// replaces the operands that are known constants, returning how many
+	int64_t replace_constants(const ConstantState &state, Vec<Uptr<mir::Operand> *> &operands) {
+		int64_t num_replaced = 0;
+		for (Uptr<mir::Operand> *operand : operands) {
+			if (!get_var(**operand)) continue;
+			if (Opt<int64_t> value = evaluate_operand(state, **operand)) {
+				*operand = mkuptr<mir::Int64Constant>(*value);
+				num_replaced += 1;
+			}
+		}
+		return num_replaced;
+	}
+
+	int64_t propagate_constants(mir::FunctionDef &function) {
+		if (function.basic_blocks.empty()) return 0;
+		cfg::FlowGraph graph = cfg::make_flow_graph(function);
+		ConstantProblem problem;
+		Vec<ConstantState> in_states = dataflow::solve_forward(function, graph, problem);
+
+		int64_t num_replaced = 0;
+		for (int i = 0; i < function.basic_blocks.size(); ++i) {
+			if (!in_states[i].reachable) continue;
+			mir::BasicBlock &block = *function.basic_blocks[i];
+			ConstantState state = in_states[i];
+			for (Uptr<mir::Instruction> &inst : block.instructions) {
+				Vec<Uptr<mir::Operand> *> operands;
+				inst->collect_operands(operands);
+				num_replaced += replace_constants(state, operands);
+				if (mir::Operand *operand = dynamic_cast<mir::Operand *>(inst->rvalue.get()); operand && get_var(*operand)) {
+					if (Opt<int64_t> value = evaluate_operand(state, *operand)) {
+						inst->rvalue = mkuptr<mir::Int64Constant>(*value);
+						num_replaced += 1;
+					}
+				} else if (dynamic_cast<mir::BinaryOperation *>(inst->rvalue.get())) {
+					if (Opt<int64_t> value = evaluate_rvalue(state, *inst->rvalue)) {
+						inst->rvalue = mkuptr<mir::Int64Constant>(*value);
+					}
+				}
+				problem.transfer(state, *inst);
+			}
+			Vec<Uptr<mir::Operand> *> operands;
+			block.collect_operands(operands);
+			num_replaced += replace_constants(state, operands);
+			if (const mir::BasicBlock::Branch *branch = std::get_if<mir::BasicBlock::Branch>(&block.terminator)) {
+				if (Opt<int64_t> value = evaluate_operand(state, *branch->condition)) {
+					block.terminator = mir::BasicBlock::Goto { *value == 1 ? branch->then_block : branch->else_block };
+				}
+			}
+		}
+		cfg::remove_unreachable_blocks(function);
+		cfg::merge_blocks(function);
+		return num_replaced;
+	}
+
+	struct CopyState {
+		bool reachable;
+		Map<mir::LocalVar *, mir::LocalVar *> copies; // copy -> original
+
+		bool operator==(const CopyState &other) const {
+			return this->reachable == other.reachable && this->copies == other.copies;
+		}
+	};
+
+	struct CopyProblem {
+		using State = CopyState;
+
+		State get_boundary_state() {
+			return State { true, {} };
+		}
+		State get_unreachable_state() {
+			return State { false, {} };
+		}
+		State join(const State &a, const State &b) {
+			if (!a.reachable) return b;
+			if (!b.reachable) return a;
+			State result { true, {} };
+			for (auto [copy, original] : a.copies) {
+				if (auto it = b.copies.find(copy); it != b.copies.end() && it->second == original) {
+					result.copies.insert({ copy, original });
+				}
+			}
+			return result;
+		}
+		void transfer(State &state, const mir::Instruction &inst) {
+			Opt<mir::LocalVar *> var = inst.get_var_written();
+			if (!state.reachable || !var) return;
+			mir::LocalVar *original = nullptr;
+			if (const mir::Operand *operand = dynamic_cast<const mir::Operand *>(inst.rvalue.get())) {
+				original = get_var(*operand);
+				if (auto it = state.copies.find(original); original && it != state.copies.end()) {
+					original = it->second;
+				}
+			}
+			state.copies.erase(*var);
+			for (auto it = state.copies.begin(); it != state.copies.end();) {
+				it = it->second == *var ? state.copies.erase(it) : std::next(it);
+			}
+			if (original && original != *var && original->type.to_ir_syntax() == (*var)->type.to_ir_syntax()) {
+				state.copies.insert({ *var, original });
+			}
+		}
+		void transfer_branch(State &state, const mir::Operand &condition, bool taken) {}
+	};
+
+	// points the places that read copies at the originals, returning how
+	// many
+	int64_t replace_copies(const CopyState &state, Vec<mir::Place *> &places) {
+		int64_t num_replaced = 0;
+		for (mir::Place *place : places) {
+			if (auto it = state.copies.find(place->target); it != state.copies.end()) {
+				place->target = it->second;
+				num_replaced += 1;
+			}
+		}
+		return num_replaced;
+	}
+
+	void collect_places(Vec<Uptr<mir::Operand> *> &operands, Vec<mir::Place *> &places) {
+		for (Uptr<mir::Operand> *operand : operands) {
+			if (mir::Place *place = dynamic_cast<mir::Place *>(operand->get())) {
+				places.push_back(place);
+			}
+		}
+	}
+
+	int64_t propagate_copies(mir::FunctionDef &function) {
+		if (function.basic_blocks.empty()) return 0;
+		cfg::FlowGraph graph = cfg::make_flow_graph(function);
+		CopyProblem problem;
+		Vec<CopyState> in_states = dataflow::solve_forward(function, graph, problem);
+
+		int64_t num_replaced = 0;
+		for (int i = 0; i < function.basic_blocks.size(); ++i) {
+			if (!in_states[i].reachable) continue;
+			mir::BasicBlock &block = *function.basic_blocks[i];
+			CopyState state = in_states[i];
+			for (Uptr<mir::Instruction> &inst : block.instructions) {
+				Vec<Uptr<mir::Operand> *> operands;
+				inst->collect_operands(operands);
+				Vec<mir::Place *> places;
+				collect_places(operands, places);
+				if (mir::Place *place = dynamic_cast<mir::Place *>(inst->rvalue.get())) {
+					places.push_back(place);
+				}
+				if (inst->destination && !(*inst->destination)->indices.empty()) {
+					places.push_back(inst->destination->get()); // the array stored to
+				}
+				num_replaced += replace_copies(state, places);
+				problem.transfer(state, *inst);
+			}
+			Vec<Uptr<mir::Operand> *> operands;
+			block.collect_operands(operands);
+			Vec<mir::Place *> places;
+			collect_places(operands, places);
+			num_replaced += replace_copies(state, places);
+		}
+		return num_replaced;
+	}
+
+	// an array or tuple variable and the dimension of it whose length is
+	// wanted, with -1 for a tuple's length
+	using LengthKey = Pair<mir::LocalVar *, int64_t>;
+
+	Opt<LengthKey> get_length_key(const mir::LengthGetter &length_getter) {
+		mir::LocalVar *array = get_var(*length_getter.target);
+		if (!array) return {};
+		if (!length_getter.dimension) return LengthKey { array, -1 };
+		const mir::Int64Constant *dimension = dynamic_cast<const mir::Int64Constant *>(length_getter.dimension->get());
+		if (!dimension) return {};
+		return LengthKey { array, dimension->value };
+	}
+
+	// the lengths that the instruction makes known: the one it gets, or
+	// those of the object it allocates. Each comes with the operand that
+	// holds it, if the instruction doesn't get it from the header.
+	Vec<Pair<LengthKey, const mir::Operand *>> get_known_lengths(const mir::Instruction &inst) {
+		Vec<Pair<LengthKey, const mir::Operand *>> result;
+		const mir::Rvalue *rvalue = inst.rvalue.get();
+		if (const mir::LengthGetter *length_getter = dynamic_cast<const mir::LengthGetter *>(rvalue)) {
+			if (Opt<LengthKey> key = get_length_key(*length_getter)) {
+				result.push_back({ *key, nullptr });
+			}
+			return result;
+		}
+		Opt<mir::LocalVar *> var = inst.get_var_written();
+		if (!var) return result;
+		if (const mir::NewArray *new_array = dynamic_cast<const mir::NewArray *>(rvalue)) {
+			for (int64_t i = 0; i < new_array->dimension_lengths.size(); ++i) {
+				result.push_back({ { *var, i }, new_array->dimension_lengths[i].get() });
+			}
+		} else if (const mir::NewTuple *new_tuple = dynamic_cast<const mir::NewTuple *>(rvalue)) {
+			result.push_back({ { *var, -1 }, new_tuple->length.get() });
+		}
+		return result;
+	}
+
+	struct LengthState {
+		bool reachable;
+		Set<LengthKey> cached; // the lengths that their cache variables hold
+
+		bool operator==(const LengthState &other) const {
+			return this->reachable == other.reachable && this->cached == other.cached;
+		}
+	};
+
+	struct LengthProblem {
+		using State = LengthState;
+		const Map<LengthKey, mir::LocalVar *> &caches;
+
+		State get_boundary_state() {
+			return State { true, {} };
+		}
+		State get_unreachable_state() {
+			return State { false, {} };
+		}
+		State join(const State &a, const State &b) {
+			if (!a.reachable) return b;
+			if (!b.reachable) return a;
+			State result { true, {} };
+			std::set_intersection(
+				a.cached.begin(), a.cached.end(),
+				b.cached.begin(), b.cached.end(),
+				std::inserter(result.cached, result.cached.end())
+			);
+			return result;
+		}
+		void transfer(State &state, const mir::Instruction &inst) {
+			if (!state.reachable) return;
+			if (Opt<mir::LocalVar *> var = inst.get_var_written()) {
+				for (auto it = state.cached.begin(); it != state.cached.end();) {
+					it = it->first == *var ? state.cached.erase(it) : std::next(it);
+				}
+			}
+			for (auto &[key, operand] : get_known_lengths(inst)) {
+				if (this->caches.count(key)) {
+					state.cached.insert(key);
+				}
+			}
+		}
+		void transfer_branch(State &state, const mir::Operand &condition, bool taken) {}
+	};
+
+	int64_t cache_lengths(mir::FunctionDef &function) {
+		if (function.basic_blocks.empty()) return 0;
+
+		// one cache variable for each length the function gets
+		Map<LengthKey, mir::LocalVar *> caches;
+		for (const Uptr<mir::BasicBlock> &block : function.basic_blocks) {
+			for (const Uptr<mir::Instruction> &inst : block->instructions) {
+				const mir::LengthGetter *length_getter = dynamic_cast<const mir::LengthGetter *>(inst->rvalue.get());
+				Opt<LengthKey> key = length_getter ? get_length_key(*length_getter) : Opt<LengthKey> {};
+				if (!key || caches.count(*key)) continue;
+				mir::LocalVar *cache = function.add_local_var(false, "", mir::Type { mir::Type::ArrayType { 0 } });
+				cache->is_encoded = true;
+				caches.insert({ *key, cache });
+			}
+		}
+		if (caches.empty()) return 0;
+
+		cfg::FlowGraph graph = cfg::make_flow_graph(function);
+		LengthProblem problem { caches };
+		Vec<LengthState> in_states = dataflow::solve_forward(function, graph, problem);
+
+		// read the lengths that are cached from their cache variables, and
+		// fill the caches everywhere else
+		int64_t num_replaced = 0;
+		for (int i = 0; i < function.basic_blocks.size(); ++i) {
+			if (!in_states[i].reachable) continue;
+			mir::BasicBlock &block = *function.basic_blocks[i];
+			LengthState state = in_states[i];
+			Vec<Uptr<mir::Instruction>> new_insts;
+			for (Uptr<mir::Instruction> &inst : block.instructions) {
+				Vec<Pair<LengthKey, const mir::Operand *>> known_lengths = get_known_lengths(*inst);
+				LengthState next_state = state;
+				problem.transfer(next_state, *inst);
+
+				if (dynamic_cast<mir::LengthGetter *>(inst->rvalue.get()) && !known_lengths.empty()) {
+					mir::LocalVar *cache = caches.at(known_lengths[0].first);
+					if (state.cached.count(known_lengths[0].first)) {
+						num_replaced += 1;
+					} else {
+						new_insts.push_back(mkuptr<mir::Instruction>(mkuptr<mir::Place>(cache), mv(inst->rvalue)));
+					}
+					inst->rvalue = mkuptr<mir::Place>(cache);
+					new_insts.push_back(mv(inst));
+				} else {
+					new_insts.push_back(mv(inst));
+					for (auto &[key, operand] : known_lengths) {
+						if (auto it = caches.find(key); it != caches.end()) {
+							new_insts.push_back(mkuptr<mir::Instruction>(mkuptr<mir::Place>(it->second), operand->clone_operand()));
+						}
+					}
+				}
+				state = mv(next_state);
+			}
+			block.instructions = mv(new_insts);
+		}
+		return num_replaced;
+	}
+
+	bool has_side_effects(const mir::Rvalue &rvalue) {
+		return dynamic_cast<const mir::FunctionCall *>(&rvalue)
+			|| dynamic_cast<const mir::NewArray *>(&rvalue)
+			|| dynamic_cast<const mir::NewTuple *>(&rvalue);
+	}
+
+	void remove_unused_vars(mir::FunctionDef &function) {
+		Set<mir::LocalVar *> used(function.parameter_vars.begin(), function.parameter_vars.end());
+		for (const Uptr<mir::BasicBlock> &block : function.basic_blocks) {
+			Vec<mir::LocalVar *> vars;
+			for (const Uptr<mir::Instruction> &inst : block->instructions) {
+				inst->collect_vars_read(vars);
+				if (inst->destination) {
+					vars.push_back((*inst->destination)->target);
+				}
+			}
+			block->collect_vars_read(vars);
+			used.insert(vars.begin(), vars.end());
+		}
+		Vec<Uptr<mir::LocalVar>> kept_vars;
+		for (Uptr<mir::LocalVar> &var : function.local_vars) {
+			if (used.count(var.get())) {
+				kept_vars.push_back(mv(var));
+			}
+		}
+		function.local_vars = mv(kept_vars);
+	}
+
+	int64_t eliminate_dead_stores(mir::FunctionDef &function) {
+		int64_t num_removed = 0;
+		dataflow::LivenessProblem problem;
+		// deleting a store can make the ones it read from dead
+		bool changed = true;
+		while (changed) {
+			changed = false;
+			cfg::FlowGraph graph = cfg::make_flow_graph(function);
+			Vec<Set<mir::LocalVar *>> out_states = dataflow::solve_backward(function, graph, problem);
+			for (int i = 0; i < function.basic_blocks.size(); ++i) {
+				mir::BasicBlock &block = *function.basic_blocks[i];
+				Set<mir::LocalVar *> live = out_states[i];
+				problem.transfer_terminator(live, block);
+				Vec<Uptr<mir::Instruction>> kept_insts;
+				for (auto it = block.instructions.rbegin(); it != block.instructions.rend(); ++it) {
+					Opt<mir::LocalVar *> var = (*it)->get_var_written();
+					if (var && !live.count(*var) && !has_side_effects(*(*it)->rvalue)) {
+						num_removed += 1;
+						changed = true;
+						continue;
+					}
+					problem.transfer(live, **it);
+					kept_insts.push_back(mv(*it));
+				}
+				std::reverse(kept_insts.begin(), kept_insts.end());
+				block.instructions = mv(kept_insts);
+			}
+		}
+		remove_unused_vars(function);
+		return num_removed;
+	}
+
+	void propagate_constants(mir::Program &program, bool verbose) {
+		int64_t num_replaced = 0;
+		for (Uptr<mir::FunctionDef> &function : program.function_defs) {
+			num_replaced += propagate_constants(*function);
+		}
+		if (verbose) {
+			std::cerr << "constant propagation replaced " << num_replaced << " operands\n";
+		}
+	}
+
+	void propagate_copies(mir::Program &program, bool verbose) {
+		int64_t num_replaced = 0;
+		for (Uptr<mir::FunctionDef> &function : program.function_defs) {
+			num_replaced += propagate_copies(*function);
+		}
+		if (verbose) {
+			std::cerr << "copy propagation replaced " << num_replaced << " operands\n";
+		}
+	}
+
+	void cache_lengths(mir::Program &program, bool verbose) {
+		int64_t num_replaced = 0;
+		for (Uptr<mir::FunctionDef> &function : program.function_defs) {
+			num_replaced += cache_lengths(*function);
+		}
+		if (verbose) {
+			std::cerr << "length caching replaced " << num_replaced << " length loads\n";
+		}
+	}
+
+	void eliminate_dead_stores(mir::Program &program, bool verbose) {
+		int64_t num_removed = 0;
+		for (Uptr<mir::FunctionDef> &function : program.function_defs) {
+			num_removed += eliminate_dead_stores(*function);
+		}
+		if (verbose) {
+			std::cerr << "dead store elimination removed " << num_removed << " instructions\n";
+		}
+	}
+
+	Vec<Pass> get_pipeline(int32_t optimization_level) {
+		Vec<Pass> pipeline;
+		if (optimization_level >= 2) {
+			pipeline.push_back(range_analysis::eliminate_bounds_checks);
+			pipeline.push_back(allocation_analysis::eliminate_allocation_checks);
+		}
+		if (optimization_level >= 1) {
+			pipeline.push_back(propagate_constants);
+			pipeline.push_back(propagate_copies);
+			// after copy propagation has pointed copies of arrays at the
+			// originals, and before the cached lengths are propagated
+			pipeline.push_back(cache_lengths);
+			pipeline.push_back(propagate_constants);
+			pipeline.push_back(propagate_copies);
+			pipeline.push_back(eliminate_dead_stores);
+		}
+		if (optimization_level >= 2) {
+			// after constant propagation has found the constant lengths and
+			// indices; the tuples' checks become constant and need another
+			// round of cleanup
+			pipeline.push_back(scalar_replacement::replace_tuples);
+			pipeline.push_back(propagate_constants);
+			pipeline.push_back(propagate_copies);
+			pipeline.push_back(eliminate_dead_stores);
+			pipeline.push_back(escape_analysis::place_allocations_in_frames);
+		}
+		return pipeline;
+	}
+
+	void run_pipeline(mir::Program &program, const Vec<Pass> &pipeline, bool verbose) {
+		for (Pass pass : pipeline) {
+			pass(program, verbose);
+		}
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include "std_alias.h"
+#include "mir.h"
+
+// The MIR passes that clean up after the lowering, and the pass manager
+// that picks which passes run for each optimization level.
+namespace La::optimize {
+	using namespace std_alias;
+
+	// Replaces the reads of int64 variables that hold the same constant on
+	// every path with the constant, folds operations on constants, and
+	// turns branches on constants into jumps. Edges that a constant branch
+	// never takes don't contribute to the blocks they lead to. Returns the
+	// number of operands replaced.
+	int64_t propagate_constants(mir::FunctionDef &function);
+
+	// Replaces the reads of a variable that holds a copy of another (`x <- y`
+	// on every path, with neither written since) with reads of the
+	// original. Returns the number of operands replaced.
+	int64_t propagate_copies(mir::FunctionDef &function);
+
+	// Gives each length that the function gets from an array or tuple
+	// header (with a constant dimension) a cache variable. Headers never
+	// change, so the cache is filled where the object is allocated or where
+	// the length is first loaded, and the loads of the same length that it
+	// holds on every path, with the array variable not reassigned since,
+	// read the cache instead. Returns the number of loads replaced.
+	int64_t cache_lengths(mir::FunctionDef &function);
+
+	// Deletes the instructions that assign a variable nothing reads
+	// afterwards, unless they call a function or allocate, and then the
+	// variables that no instruction mentions anymore. Returns the number
+	// of instructions deleted.
+	int64_t eliminate_dead_stores(mir::FunctionDef &function);
+
+	// a pass over the whole program, which prints what it did if verbose
+	using Pass = void (*)(mir::Program &program, bool verbose);
+
+	// -O0 runs nothing; -O1 propagates constants and copies, caches array
+	// lengths, and eliminates dead stores; -O2 and up first remove the bounds and allocation checks
+	// they can prove, then clean up the same way, replace small tuples with
+	// variables and clean up again, and finally move the objects that don't
+	// escape into their functions' frames.
+	Vec<Pass> get_pipeline(int32_t optimization_level);
+
+	void run_pipeline(mir::Program &program, const Vec<Pass> &pipeline, bool verbose);
+}
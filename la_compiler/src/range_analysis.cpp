@@ -0,0 +1,1342 @@
+#include "range_analysis.h"
+#include "cfg.h"
+#include <iostream>
+#include <algorithm>
+#include <tuple>
+#include <stdint.h>
+
+namespace La::range_analysis {
+	using namespace std_alias;
+
+	// not even 2^46 eight-byte elements fit in a 48-bit address space, so no
+	// encoded length is bigger than this
+	const int64_t max_encoded_length = (static_cast<int64_t>(1) << 47) + 1;
+
+	// how many times a block's entry state may grow before its intervals are
+	// widened to make the analysis terminate
+	const int visits_before_widening = 3;
+
+	// how many instructions a loop may have for it to be copied so that the
+	// copy can go without bounds checks
+	const int64_t max_versioned_loop_size = 200;
+
+	// an unknown int64 that the analysis reasons about: the value of a local
+	// variable, or the encoded length of one of an array's dimensions. A
+	// halved atom is that value >> 1, which lets plain values be compared
+	// with decoded ones.
+	struct Atom {
+		mir::LocalVar *var;
+		Opt<int64_t> dimension; // empty for the variable itself
+		bool halved = false;
+
+		bool operator<(const Atom &other) const {
+			return std::tie(this->var, this->dimension, this->halved) < std::tie(other.var, other.dimension, other.halved);
+		}
+		bool operator==(const Atom &other) const {
+			return this->var == other.var && this->dimension == other.dimension && this->halved == other.halved;
+		}
+	};
+
+	struct Interval {
+		int64_t lo;
+		int64_t hi;
+
+		bool operator==(const Interval &other) const {
+			return this->lo == other.lo && this->hi == other.hi;
+		}
+	};
+
+	const Interval full_range { INT64_MIN, INT64_MAX };
+
+	// an int64 in terms of an atom: the atom itself or the atom decoded
+	// (>> 1), plus an offset. Without an atom, the value is the offset.
+	struct Value {
+		Opt<Atom> atom;
+		bool decoded;
+		int64_t offset;
+
+		bool operator==(const Value &other) const {
+			return this->atom == other.atom && this->decoded == other.decoded && this->offset == other.offset;
+		}
+	};
+
+	Value make_constant(int64_t value) {
+		return Value { {}, false, value };
+	}
+
+	// the same value with a halved atom in place of the decoding
+	Value as_raw(const Value &value) {
+		if (!value.atom || !value.decoded) return value;
+		return Value { Atom { value.atom->var, value.atom->dimension, true }, false, value.offset };
+	}
+
+	// how a variable holds the result of a comparison: as it is (0 or 1),
+	// shifted left, or encoded
+	enum struct BoolForm {
+		plain,
+		shifted,
+		encoded
+	};
+
+	struct Condition {
+		mir::Operator op;
+		Value lhs;
+		Value rhs;
+		BoolForm form;
+
+		bool operator==(const Condition &other) const {
+			return this->op == other.op && this->lhs == other.lhs && this->rhs == other.rhs && this->form == other.form;
+		}
+	};
+
+	// a variable that holds a value encoded (2v + 1), or only shifted (2v)
+	// so far
+	struct Encoding {
+		Value value;
+		bool complete;
+
+		bool operator==(const Encoding &other) const {
+			return this->value == other.value && this->complete == other.complete;
+		}
+	};
+
+	struct State {
+		bool reachable;
+		Map<Atom, Interval> ranges; // atoms that aren't here have their default range
+		Map<mir::LocalVar *, Value> values; // variables that aren't here are their own atom
+		Map<mir::LocalVar *, Condition> conditions;
+		Map<Pair<Atom, Atom>, int64_t> differences; // (x, y) -> c means x - y <= c
+		Map<mir::LocalVar *, Encoding> encodings;
+
+		bool operator==(const State &other) const {
+			// the facts in a state that can't be reached don't mean anything,
+			// and comparing them could keep the analysis from settling
+			if (!this->reachable || !other.reachable) return this->reachable == other.reachable;
+			return this->ranges == other.ranges
+				&& this->values == other.values
+				&& this->conditions == other.conditions
+				&& this->differences == other.differences
+				&& this->encodings == other.encodings;
+		}
+	};
+
+	State make_unreachable_state() {
+		return State { false, {}, {}, {}, {}, {} };
+	}
+
+	Opt<int64_t> checked_add(int64_t a, int64_t b) {
+		int64_t result;
+		if (__builtin_add_overflow(a, b, &result)) return {};
+		return result;
+	}
+	Opt<int64_t> checked_sub(int64_t a, int64_t b) {
+		int64_t result;
+		if (__builtin_sub_overflow(a, b, &result)) return {};
+		return result;
+	}
+	Opt<int64_t> checked_mul(int64_t a, int64_t b) {
+		int64_t result;
+		if (__builtin_mul_overflow(a, b, &result)) return {};
+		return result;
+	}
+
+	// The interval operations return nothing when the result can wrap
+	// around, because then it isn't an interval anymore.
+	Opt<Interval> add_intervals(Interval a, Interval b) {
+		Opt<int64_t> lo = checked_add(a.lo, b.lo);
+		Opt<int64_t> hi = checked_add(a.hi, b.hi);
+		if (!lo || !hi) return {};
+		return Interval { *lo, *hi };
+	}
+	Opt<Interval> sub_intervals(Interval a, Interval b) {
+		Opt<int64_t> lo = checked_sub(a.lo, b.hi);
+		Opt<int64_t> hi = checked_sub(a.hi, b.lo);
+		if (!lo || !hi) return {};
+		return Interval { *lo, *hi };
+	}
+	Opt<Interval> mul_intervals(Interval a, Interval b) {
+		Opt<int64_t> corners[] = {
+			checked_mul(a.lo, b.lo),
+			checked_mul(a.lo, b.hi),
+			checked_mul(a.hi, b.lo),
+			checked_mul(a.hi, b.hi)
+		};
+		Interval result { INT64_MAX, INT64_MIN };
+		for (Opt<int64_t> corner : corners) {
+			if (!corner) return {};
+			result.lo = std::min(result.lo, *corner);
+			result.hi = std::max(result.hi, *corner);
+		}
+		return result;
+	}
+
+	Interval hull(Interval a, Interval b) {
+		return Interval { std::min(a.lo, b.lo), std::max(a.hi, b.hi) };
+	}
+
+	bool is_comparison(mir::Operator op) {
+		return op == mir::Operator::lt
+			|| op == mir::Operator::le
+			|| op == mir::Operator::eq
+			|| op == mir::Operator::ge
+			|| op == mir::Operator::gt;
+	}
+
+	// the range of `a op b`, or nothing if it can wrap around
+	Opt<Interval> evaluate_operation(mir::Operator op, Interval a, Interval b) {
+		switch (op) {
+			case mir::Operator::plus:
+				return add_intervals(a, b);
+			case mir::Operator::minus:
+				return sub_intervals(a, b);
+			case mir::Operator::times:
+				return mul_intervals(a, b);
+			case mir::Operator::lshift:
+				if (b.lo != b.hi || b.lo < 0 || b.lo > 62) return {};
+				return mul_intervals(a, Interval { static_cast<int64_t>(1) << b.lo, static_cast<int64_t>(1) << b.lo });
+			case mir::Operator::rshift:
+				if (b.lo != b.hi || b.lo < 0 || b.lo > 63) return {};
+				return Interval { a.lo >> b.lo, a.hi >> b.lo };
+			case mir::Operator::bitwise_and:
+				if (a.lo >= 0 && b.lo >= 0) return Interval { 0, std::min(a.hi, b.hi) };
+				if (a.lo >= 0) return Interval { 0, a.hi };
+				if (b.lo >= 0) return Interval { 0, b.hi };
+				return full_range;
+			default:
+				return Interval { 0, 1 };
+		}
+	}
+
+	bool is_int64(const mir::LocalVar *var) {
+		const mir::Type::ArrayType *array_type = std::get_if<mir::Type::ArrayType>(&var->type.type);
+		return array_type && array_type->num_dimensions == 0;
+	}
+
+	// lengths are encoded, and so are the int64 variables marked as such
+	bool is_odd(const Atom &atom) {
+		if (atom.halved) return false;
+		return atom.dimension.has_value() || (atom.var->is_encoded && is_int64(atom.var));
+	}
+
+	bool mentions(const Value &value, const mir::LocalVar *var) {
+		return value.atom.has_value() && value.atom->var == var;
+	}
+	bool mentions(const Condition &condition, const mir::LocalVar *var) {
+		return mentions(condition.lhs, var) || mentions(condition.rhs, var);
+	}
+
+	Interval get_range(const State &state, const Atom &atom) {
+		if (atom.halved) {
+			Interval base = get_range(state, Atom { atom.var, atom.dimension });
+			Interval range { base.lo >> 1, base.hi >> 1 };
+			if (auto it = state.ranges.find(atom); it != state.ranges.end()) {
+				range = Interval { std::max(range.lo, it->second.lo), std::min(range.hi, it->second.hi) };
+			}
+			return range;
+		}
+		if (auto it = state.ranges.find(atom); it != state.ranges.end()) {
+			return it->second;
+		}
+		if (atom.dimension) {
+			return Interval { 1, max_encoded_length };
+		}
+		return full_range;
+	}
+
+	Interval get_range(const State &state, const Value &value) {
+		if (!value.atom) {
+			return Interval { value.offset, value.offset };
+		}
+		Interval range = get_range(state, *value.atom);
+		if (value.decoded) {
+			range = Interval { range.lo >> 1, range.hi >> 1 };
+		}
+		return add_intervals(range, Interval { value.offset, value.offset }).value_or(full_range);
+	}
+
+	Value get_var_value(const State &state, mir::LocalVar *var) {
+		if (auto it = state.values.find(var); it != state.values.end()) {
+			return it->second;
+		}
+		return Value { Atom { var, {} }, false, 0 };
+	}
+
+	// the value of an operand that the analysis can name
+	Opt<Value> get_value(const State &state, const mir::Operand &operand) {
+		if (const mir::Int64Constant *constant = dynamic_cast<const mir::Int64Constant *>(&operand)) {
+			return make_constant(constant->value);
+		} else if (const mir::Place *place = dynamic_cast<const mir::Place *>(&operand)) {
+			if (place->indices.empty()) {
+				return get_var_value(state, place->target);
+			}
+		}
+		return {};
+	}
+
+	const Condition *get_condition(const State &state, const mir::Operand &operand) {
+		const mir::Place *place = dynamic_cast<const mir::Place *>(&operand);
+		if (!place || !place->indices.empty()) return nullptr;
+		auto it = state.conditions.find(place->target);
+		return it == state.conditions.end() ? nullptr : &it->second;
+	}
+
+	// an upper bound on x - y
+	Opt<int64_t> get_difference_bound(const State &state, const Atom &x, const Atom &y) {
+		if (x == y) return 0;
+		Opt<int64_t> bound = checked_sub(get_range(state, x).hi, get_range(state, y).lo);
+		auto consider = [&](Opt<int64_t> candidate) {
+			if (candidate && (!bound || *candidate < *bound)) {
+				bound = candidate;
+			}
+		};
+		if (auto it = state.differences.find(Pair<Atom, Atom> { x, y }); it != state.differences.end()) {
+			consider(it->second);
+		}
+		// through one other atom
+		auto it = state.differences.lower_bound(Pair<Atom, Atom> { x, Atom { nullptr, {} } });
+		for (; it != state.differences.end() && it->first.first == x; ++it) {
+			auto second_it = state.differences.find(Pair<Atom, Atom> { it->first.second, y });
+			if (second_it != state.differences.end()) {
+				consider(checked_add(it->second, second_it->second));
+			}
+		}
+		return bound;
+	}
+
+	// an upper bound on a - b
+	Opt<int64_t> get_difference_bound(const State &state, const Value &a, const Value &b) {
+		if (a.atom && b.atom && a.decoded != b.decoded) {
+			return get_difference_bound(state, as_raw(a), as_raw(b));
+		}
+		Opt<int64_t> bound = checked_sub(get_range(state, a).hi, get_range(state, b).lo);
+		if (a.atom && b.atom) {
+			Opt<int64_t> atom_bound = get_difference_bound(state, *a.atom, *b.atom);
+			if (atom_bound && a.decoded) {
+				// floor(x / 2) - floor(y / 2) is at most ceil((x - y) / 2), and
+				// exactly (x - y) / 2 when both are odd
+				if (is_odd(*a.atom) && is_odd(*b.atom)) {
+					atom_bound = *atom_bound >> 1;
+				} else {
+					atom_bound = (*atom_bound >> 1) + (*atom_bound & 1);
+				}
+			}
+			Opt<int64_t> offset_difference = checked_sub(a.offset, b.offset);
+			if (atom_bound && offset_difference) {
+				Opt<int64_t> candidate = checked_add(*atom_bound, *offset_difference);
+				if (candidate && (!bound || *candidate < *bound)) {
+					bound = candidate;
+				}
+			}
+		}
+		return bound;
+	}
+
+	bool is_difference_at_most(const State &state, const Value &a, const Value &b, int64_t c) {
+		Opt<int64_t> bound = get_difference_bound(state, a, b);
+		return bound && *bound <= c;
+	}
+
+	// whether `lhs op rhs` always or never holds
+	Opt<bool> decide_comparison(const State &state, mir::Operator op, const Value &lhs, const Value &rhs) {
+		switch (op) {
+			case mir::Operator::lt:
+				if (is_difference_at_most(state, lhs, rhs, -1)) return true;
+				if (is_difference_at_most(state, rhs, lhs, 0)) return false;
+				return {};
+			case mir::Operator::le:
+				if (is_difference_at_most(state, lhs, rhs, 0)) return true;
+				if (is_difference_at_most(state, rhs, lhs, -1)) return false;
+				return {};
+			case mir::Operator::eq:
+				if (is_difference_at_most(state, lhs, rhs, 0) && is_difference_at_most(state, rhs, lhs, 0)) return true;
+				if (is_difference_at_most(state, lhs, rhs, -1) || is_difference_at_most(state, rhs, lhs, -1)) return false;
+				return {};
+			case mir::Operator::ge:
+				return decide_comparison(state, mir::Operator::le, rhs, lhs);
+			case mir::Operator::gt:
+				return decide_comparison(state, mir::Operator::lt, rhs, lhs);
+			default:
+				return {};
+		}
+	}
+
+	void narrow_range(State &state, const Atom &atom, Interval bound) {
+		Interval range = get_range(state, atom);
+		range = Interval { std::max(range.lo, bound.lo), std::min(range.hi, bound.hi) };
+		if (range.lo > range.hi) {
+			// no value satisfies everything, so this point can't be reached
+			state.reachable = false;
+			return;
+		}
+		state.ranges.insert_or_assign(atom, range);
+	}
+
+	// assumes that value <= bound
+	void assume_at_most(State &state, const Value &value, int64_t bound) {
+		if (!value.atom) {
+			if (value.offset > bound) state.reachable = false;
+			return;
+		}
+		Opt<int64_t> hi = checked_sub(bound, value.offset);
+		if (hi && value.decoded) {
+			// x >> 1 <= k exactly when x <= 2k + 1
+			Opt<int64_t> doubled = checked_mul(*hi, 2);
+			hi = doubled ? checked_add(*doubled, 1) : Opt<int64_t>();
+		}
+		if (hi) {
+			narrow_range(state, *value.atom, Interval { INT64_MIN, *hi });
+		}
+	}
+
+	// assumes that value >= bound
+	void assume_at_least(State &state, const Value &value, int64_t bound) {
+		if (!value.atom) {
+			if (value.offset < bound) state.reachable = false;
+			return;
+		}
+		Opt<int64_t> lo = checked_sub(bound, value.offset);
+		if (lo && value.decoded) {
+			// x >> 1 >= k exactly when x >= 2k
+			lo = checked_mul(*lo, 2);
+		}
+		if (lo) {
+			narrow_range(state, *value.atom, Interval { *lo, INT64_MAX });
+		}
+	}
+
+	void add_difference(State &state, const Atom &x, const Atom &y, int64_t c) {
+		if (Opt<int64_t> reverse = get_difference_bound(state, y, x); reverse && *reverse < 0 && c < -*reverse) {
+			// x - y <= c < y - x's lower bound
+			state.reachable = false;
+			return;
+		}
+		auto [it, is_new] = state.differences.insert({ Pair<Atom, Atom> { x, y }, c });
+		if (!is_new) {
+			it->second = std::min(it->second, c);
+		}
+	}
+
+	// assumes that a - b <= c
+	void assume_difference(State &state, const Value &a, const Value &b, int64_t c) {
+		// a <= b + c <= b.hi + c, and b >= a - c >= a.lo - c
+		if (Opt<int64_t> hi = checked_add(get_range(state, b).hi, c)) {
+			assume_at_most(state, a, *hi);
+		}
+		if (Opt<int64_t> lo = checked_sub(get_range(state, a).lo, c)) {
+			assume_at_least(state, b, *lo);
+		}
+		if (a.atom && b.atom && a.decoded != b.decoded) {
+			assume_difference(state, as_raw(a), as_raw(b), c);
+			return;
+		}
+		if (!a.atom || !b.atom || *a.atom == *b.atom) return;
+
+		Opt<int64_t> k = checked_sub(c, a.offset);
+		k = k ? checked_add(*k, b.offset) : k;
+		if (k && a.decoded) {
+			// x <= 2 floor(x / 2) + 1 <= 2 floor(y / 2) + 2k + 1 <= y + 2k + 1,
+			// and x - y is even when both are odd
+			Opt<int64_t> doubled = checked_mul(*k, 2);
+			bool both_odd = is_odd(*a.atom) && is_odd(*b.atom);
+			k = doubled ? checked_add(*doubled, both_odd ? 0 : 1) : Opt<int64_t>();
+		}
+		if (k) {
+			add_difference(state, *a.atom, *b.atom, *k);
+		}
+	}
+
+	// assumes that `lhs op rhs` holds, or that it doesn't
+	void assume_comparison(State &state, mir::Operator op, const Value &lhs, const Value &rhs, bool holds) {
+		switch (op) {
+			case mir::Operator::lt:
+				if (holds) {
+					assume_difference(state, lhs, rhs, -1);
+				} else {
+					assume_difference(state, rhs, lhs, 0);
+				}
+				break;
+			case mir::Operator::le:
+				if (holds) {
+					assume_difference(state, lhs, rhs, 0);
+				} else {
+					assume_difference(state, rhs, lhs, -1);
+				}
+				break;
+			case mir::Operator::eq:
+				if (holds) {
+					assume_difference(state, lhs, rhs, 0);
+					assume_difference(state, rhs, lhs, 0);
+				}
+				break;
+			case mir::Operator::ge:
+				assume_comparison(state, mir::Operator::le, rhs, lhs, holds);
+				break;
+			case mir::Operator::gt:
+				assume_comparison(state, mir::Operator::lt, rhs, lhs, holds);
+				break;
+			default:
+				break;
+		}
+	}
+
+	// forgets everything about the variable's old value
+	void kill(State &state, mir::LocalVar *var) {
+		for (auto it = state.ranges.begin(); it != state.ranges.end();) {
+			it = it->first.var == var ? state.ranges.erase(it) : std::next(it);
+		}
+		for (auto it = state.values.begin(); it != state.values.end();) {
+			it = it->first == var || mentions(it->second, var) ? state.values.erase(it) : std::next(it);
+		}
+		for (auto it = state.conditions.begin(); it != state.conditions.end();) {
+			it = it->first == var || mentions(it->second, var) ? state.conditions.erase(it) : std::next(it);
+		}
+		for (auto it = state.differences.begin(); it != state.differences.end();) {
+			bool mentions_var = it->first.first.var == var || it->first.second.var == var;
+			it = mentions_var ? state.differences.erase(it) : std::next(it);
+		}
+		for (auto it = state.encodings.begin(); it != state.encodings.end();) {
+			it = it->first == var || mentions(it->second.value, var) ? state.encodings.erase(it) : std::next(it);
+		}
+	}
+
+	// rewrites a value in terms of the old value of var in terms of its new
+	// value, which is the old one plus the offset
+	bool shift_value(Value &value, const mir::LocalVar *var, int64_t offset) {
+		if (!mentions(value, var) || value.atom->dimension) return true;
+		Opt<int64_t> new_offset;
+		if (!value.decoded && !value.atom->halved) {
+			new_offset = checked_sub(value.offset, offset);
+		} else if (offset % 2 == 0) {
+			new_offset = checked_sub(value.offset, offset / 2);
+		}
+		if (!new_offset) return false;
+		value.offset = *new_offset;
+		return true;
+	}
+
+	void shift_var(State &state, mir::LocalVar *var, int64_t offset) {
+		Atom atom { var, {} };
+		Atom halved_atom { var, {}, true };
+		state.ranges.erase(atom);
+		state.ranges.erase(halved_atom);
+		state.values.erase(var);
+		state.conditions.erase(var);
+		state.encodings.erase(var);
+		for (auto it = state.values.begin(); it != state.values.end();) {
+			it = shift_value(it->second, var, offset) ? std::next(it) : state.values.erase(it);
+		}
+		for (auto it = state.conditions.begin(); it != state.conditions.end();) {
+			bool shifted = shift_value(it->second.lhs, var, offset) && shift_value(it->second.rhs, var, offset);
+			it = shifted ? std::next(it) : state.conditions.erase(it);
+		}
+		for (auto it = state.encodings.begin(); it != state.encodings.end();) {
+			it = shift_value(it->second.value, var, offset) ? std::next(it) : state.encodings.erase(it);
+		}
+		// (x + 2k) >> 1 == (x >> 1) + k
+		Opt<int64_t> halved_offset;
+		if (offset % 2 == 0) {
+			halved_offset = offset / 2;
+		}
+		Map<Pair<Atom, Atom>, int64_t> differences;
+		for (auto [atoms, c] : state.differences) {
+			Opt<int64_t> new_c = c;
+			if (atoms.first == atom) {
+				new_c = checked_add(c, offset);
+			} else if (atoms.second == atom) {
+				new_c = checked_sub(c, offset);
+			} else if (atoms.first == halved_atom) {
+				new_c = halved_offset ? checked_add(c, *halved_offset) : halved_offset;
+			} else if (atoms.second == halved_atom) {
+				new_c = halved_offset ? checked_sub(c, *halved_offset) : halved_offset;
+			}
+			if (new_c) {
+				differences.insert({ atoms, *new_c });
+			}
+		}
+		state.differences = mv(differences);
+	}
+
+	// the value of `lhs op rhs` in terms of one of the operands' atoms
+	Opt<Value> get_symbolic_result(mir::Operator op, const Value &lhs, const Value &rhs) {
+		if (op == mir::Operator::plus && lhs.atom && !rhs.atom) {
+			Opt<int64_t> offset = checked_add(lhs.offset, rhs.offset);
+			if (offset) return Value { lhs.atom, lhs.decoded, *offset };
+		} else if (op == mir::Operator::plus && rhs.atom && !lhs.atom) {
+			Opt<int64_t> offset = checked_add(rhs.offset, lhs.offset);
+			if (offset) return Value { rhs.atom, rhs.decoded, *offset };
+		} else if (op == mir::Operator::minus && lhs.atom && !rhs.atom) {
+			Opt<int64_t> offset = checked_sub(lhs.offset, rhs.offset);
+			if (offset) return Value { lhs.atom, lhs.decoded, *offset };
+		} else if (op == mir::Operator::rshift && lhs.atom && !rhs.atom && rhs.offset == 1) {
+			// (x + 2k) >> 1 == (x >> 1) + k
+			if (!lhs.decoded && !lhs.atom->halved && lhs.offset % 2 == 0) {
+				return Value { lhs.atom, true, lhs.offset / 2 };
+			}
+		} else if (op == mir::Operator::lshift && lhs.atom && !rhs.atom && rhs.offset == 1) {
+			// ((x >> 1) + k) << 1 == x - 1 + 2k when x is odd
+			if (lhs.decoded && is_odd(*lhs.atom)) {
+				Opt<int64_t> doubled = checked_mul(lhs.offset, 2);
+				Opt<int64_t> offset = doubled ? checked_sub(*doubled, 1) : doubled;
+				if (offset) return Value { lhs.atom, false, *offset };
+			}
+		}
+		return {};
+	}
+
+	// follows a comparison's result through the encoding and decoding shifts
+	Opt<Condition> get_condition_result(const State &state, const mir::BinaryOperation &bin_op) {
+		const Condition *condition = get_condition(state, *bin_op.lhs);
+		const mir::Int64Constant *rhs = dynamic_cast<const mir::Int64Constant *>(bin_op.rhs.get());
+		if (!condition || !rhs || rhs->value != 1) return {};
+		Condition result = *condition;
+		if (bin_op.op == mir::Operator::lshift && condition->form == BoolForm::plain) {
+			result.form = BoolForm::shifted;
+		} else if (bin_op.op == mir::Operator::plus && condition->form == BoolForm::shifted) {
+			result.form = BoolForm::encoded;
+		} else if (bin_op.op == mir::Operator::rshift && condition->form != BoolForm::plain) {
+			result.form = BoolForm::plain;
+		} else {
+			return {};
+		}
+		return result;
+	}
+
+	const Encoding *get_encoding(const State &state, const mir::Operand &operand) {
+		const mir::Place *place = dynamic_cast<const mir::Place *>(&operand);
+		if (!place || !place->indices.empty()) return nullptr;
+		auto it = state.encodings.find(place->target);
+		return it == state.encodings.end() ? nullptr : &it->second;
+	}
+
+	// follows a plain value through `<< 1` and then `+ 1`
+	Opt<Encoding> get_encoding_result(const State &state, const mir::BinaryOperation &bin_op) {
+		const mir::Int64Constant *rhs = dynamic_cast<const mir::Int64Constant *>(bin_op.rhs.get());
+		if (!rhs || rhs->value != 1) return {};
+		if (bin_op.op == mir::Operator::lshift) {
+			Opt<Value> lhs = get_value(state, *bin_op.lhs);
+			if (lhs && !lhs->decoded) return Encoding { *lhs, false };
+		} else if (bin_op.op == mir::Operator::plus) {
+			const Encoding *lhs = get_encoding(state, *bin_op.lhs);
+			if (lhs && !lhs->complete) return Encoding { lhs->value, true };
+		}
+		return {};
+	}
+
+	// the plain value an operand given to an allocation encodes
+	Opt<Value> get_encoded_value(const State &state, const mir::Operand &operand) {
+		const Encoding *encoding = get_encoding(state, operand);
+		if (!encoding || !encoding->complete) return {};
+		return encoding->value;
+	}
+
+	Opt<Atom> get_length_atom(const State &state, const mir::LengthGetter &length_getter) {
+		const mir::Place *target = dynamic_cast<const mir::Place *>(length_getter.target.get());
+		if (!target || !target->indices.empty()) return {};
+		mir::LocalVar *array = target->target;
+		Value array_value = get_var_value(state, array);
+		if (array_value.atom && !array_value.atom->dimension && !array_value.decoded && array_value.offset == 0) {
+			array = array_value.atom->var; // a copy of another array variable
+		}
+		if (!length_getter.dimension) {
+			return Atom { array, 0 }; // a tuple
+		}
+		Opt<Value> dimension = get_value(state, **length_getter.dimension);
+		if (!dimension) return {};
+		Interval dimension_range = get_range(state, *dimension);
+		if (dimension_range.lo != dimension_range.hi) return {};
+		return Atom { array, dimension_range.lo };
+	}
+
+	void transfer_instruction(State &state, const mir::Instruction &inst) {
+		if (!inst.destination) return;
+		const mir::Place &destination = **inst.destination;
+		if (!destination.indices.empty()) return; // a store to memory doesn't change any variable
+		mir::LocalVar *var = destination.target;
+
+		Opt<Value> value;
+		Interval range = full_range;
+		Opt<Condition> condition;
+		Opt<Encoding> encoding;
+		Vec<Opt<Value>> dimension_lengths; // if the instruction allocates
+		Vec<Opt<Value>> decoded_dimension_lengths;
+
+		const mir::Rvalue *rvalue = inst.rvalue.get();
+		if (const mir::Operand *operand = dynamic_cast<const mir::Operand *>(rvalue)) {
+			value = get_value(state, *operand);
+			if (const Condition *source_condition = get_condition(state, *operand)) {
+				condition = *source_condition;
+			}
+			if (const Encoding *source_encoding = get_encoding(state, *operand)) {
+				encoding = *source_encoding;
+			}
+		} else if (const mir::BinaryOperation *bin_op = dynamic_cast<const mir::BinaryOperation *>(rvalue)) {
+			Opt<Value> lhs = get_value(state, *bin_op->lhs);
+			Opt<Value> rhs = get_value(state, *bin_op->rhs);
+			Interval lhs_range = lhs ? get_range(state, *lhs) : full_range;
+			Interval rhs_range = rhs ? get_range(state, *rhs) : full_range;
+			if (is_comparison(bin_op->op)) {
+				range = Interval { 0, 1 };
+				if (lhs && rhs) {
+					condition = Condition { bin_op->op, *lhs, *rhs, BoolForm::plain };
+					if (Opt<bool> result = decide_comparison(state, bin_op->op, *lhs, *rhs)) {
+						value = make_constant(*result ? 1 : 0);
+					}
+				}
+			} else {
+				Opt<Interval> result_range = evaluate_operation(bin_op->op, lhs_range, rhs_range);
+				if (result_range) {
+					range = *result_range;
+					// only if the result can't wrap around is it really an offset
+					if (lhs && rhs) value = get_symbolic_result(bin_op->op, *lhs, *rhs);
+				}
+				condition = get_condition_result(state, *bin_op);
+				encoding = get_encoding_result(state, *bin_op);
+			}
+		} else if (const mir::LengthGetter *length_getter = dynamic_cast<const mir::LengthGetter *>(rvalue)) {
+			if (Opt<Atom> atom = get_length_atom(state, *length_getter)) {
+				value = Value { atom, false, 0 };
+			} else {
+				range = Interval { 1, max_encoded_length };
+			}
+		} else if (const mir::NewArray *new_array = dynamic_cast<const mir::NewArray *>(rvalue)) {
+			for (const Uptr<mir::Operand> &length : new_array->dimension_lengths) {
+				dimension_lengths.push_back(get_value(state, *length));
+				decoded_dimension_lengths.push_back(get_encoded_value(state, *length));
+			}
+		} else if (const mir::NewTuple *new_tuple = dynamic_cast<const mir::NewTuple *>(rvalue)) {
+			dimension_lengths.push_back(get_value(state, *new_tuple->length));
+			decoded_dimension_lengths.push_back(get_encoded_value(state, *new_tuple->length));
+		}
+		if (value) {
+			Interval value_range = get_range(state, *value);
+			range = Interval { std::max(range.lo, value_range.lo), std::min(range.hi, value_range.hi) };
+		}
+		if (!value && range.lo == range.hi) {
+			value = make_constant(range.lo);
+		}
+		Vec<Pair<Interval, Opt<Value>>> dimensions;
+		for (const Opt<Value> &length : dimension_lengths) {
+			dimensions.push_back({ length ? get_range(state, *length) : full_range, length });
+		}
+
+		if (value && value->atom == Opt<Atom>(Atom { var, {} }) && !value->decoded) {
+			// like `i <- i + 1`: the facts about the old value still hold for
+			// the new value minus the offset
+			shift_var(state, var, value->offset);
+			value = {};
+		} else {
+			kill(state, var);
+		}
+		if (value && !mentions(*value, var)) {
+			state.values.insert_or_assign(var, *value);
+		} else if (!(range == full_range)) {
+			state.ranges.insert_or_assign(Atom { var, {} }, range);
+		}
+		if (condition && !mentions(*condition, var)) {
+			state.conditions.insert_or_assign(var, *condition);
+		}
+		if (encoding && !mentions(encoding->value, var)) {
+			state.encodings.insert_or_assign(var, *encoding);
+		}
+		for (int64_t dim = 0; dim < dimensions.size(); ++dim) {
+			// the allocation fails unless the length is in range
+			Atom length_atom { var, dim };
+			auto &[length_range, length] = dimensions[dim];
+			Interval default_range = get_range(state, length_atom);
+			if (length_range.hi >= default_range.lo && length_range.lo <= default_range.hi) {
+				narrow_range(state, length_atom, length_range);
+			}
+			if (length && !mentions(*length, var)) {
+				Value length_value { length_atom, false, 0 };
+				assume_difference(state, length_value, *length, 0);
+				assume_difference(state, *length, length_value, 0);
+			}
+			const Opt<Value> &decoded_length = decoded_dimension_lengths[dim];
+			if (decoded_length && !mentions(*decoded_length, var)) {
+				Value length_value { length_atom, true, 0 };
+				assume_difference(state, length_value, *decoded_length, 0);
+				assume_difference(state, *decoded_length, length_value, 0);
+			}
+		}
+	}
+
+	// whether the branch is always or never taken. A branch is taken when its
+	// condition is 1.
+	Opt<bool> decide_branch(const State &state, const mir::Operand &condition) {
+		if (const Condition *comparison = get_condition(state, condition); comparison && comparison->form == BoolForm::plain) {
+			if (Opt<bool> result = decide_comparison(state, comparison->op, comparison->lhs, comparison->rhs)) {
+				return result;
+			}
+		}
+		if (Opt<Value> value = get_value(state, condition)) {
+			Interval range = get_range(state, *value);
+			if (range.lo == 1 && range.hi == 1) return true;
+			if (range.lo > 1 || range.hi < 1) return false;
+		}
+		return {};
+	}
+
+	void assume_branch(State &state, const mir::Operand &condition, bool taken) {
+		if (const Condition *comparison = get_condition(state, condition); comparison && comparison->form == BoolForm::plain) {
+			Condition assumed = *comparison;
+			assume_comparison(state, assumed.op, assumed.lhs, assumed.rhs, taken);
+		}
+		if (Opt<Value> value = get_value(state, condition)) {
+			if (taken) {
+				assume_comparison(state, mir::Operator::eq, *value, make_constant(1), true);
+			} else {
+				Interval range = get_range(state, *value);
+				if (range.lo == 1) {
+					assume_at_least(state, *value, 2);
+				} else if (range.hi == 1) {
+					assume_at_most(state, *value, 0);
+				}
+			}
+		}
+	}
+
+	// the state on each edge out of the block
+	Vec<Pair<mir::BasicBlock *, State>> transfer_block(const State &in_state, const mir::BasicBlock &block) {
+		State state = in_state;
+		for (const Uptr<mir::Instruction> &inst : block.instructions) {
+			transfer_instruction(state, *inst);
+		}
+		if (const mir::BasicBlock::Goto *term = std::get_if<mir::BasicBlock::Goto>(&block.terminator)) {
+			return { { term->successor, mv(state) } };
+		} else if (const mir::BasicBlock::Branch *term = std::get_if<mir::BasicBlock::Branch>(&block.terminator)) {
+			State then_state = state;
+			assume_branch(then_state, *term->condition, true);
+			assume_branch(state, *term->condition, false);
+			return { { term->then_block, mv(then_state) }, { term->else_block, mv(state) } };
+		} else {
+			return {};
+		}
+	}
+
+	Set<mir::LocalVar *> get_described_vars(const State &state) {
+		Set<mir::LocalVar *> vars;
+		for (const auto &[var, value] : state.values) {
+			vars.insert(var);
+		}
+		for (const auto &[atom, range] : state.ranges) {
+			if (!atom.dimension) {
+				vars.insert(atom.var);
+			}
+		}
+		return vars;
+	}
+
+	void add_value_differences(Map<Pair<Atom, Atom>, int64_t> &differences, mir::LocalVar *var, const Value &value) {
+		Atom atom { var, {} };
+		// a decoded value is exactly its halved atom plus the offset, like
+		// `end <- (length a 0 >> 1) - 1`
+		Value raw = as_raw(value);
+		if (!raw.atom || *raw.atom == atom || raw.offset == INT64_MIN) return;
+		for (auto [atoms, c] : { Pair<Pair<Atom, Atom>, int64_t> { { atom, *raw.atom }, raw.offset }, { { *raw.atom, atom }, -raw.offset } }) {
+			auto [it, is_new] = differences.insert({ atoms, c });
+			if (!is_new) {
+				it->second = std::min(it->second, c);
+			}
+		}
+	}
+
+	State join_states(const State &a, const State &b) {
+		if (!a.reachable) return b;
+		if (!b.reachable) return a;
+		State result { true, {}, {}, {}, {}, {} };
+
+		Map<Pair<Atom, Atom>, int64_t> a_differences = a.differences;
+		Map<Pair<Atom, Atom>, int64_t> b_differences = b.differences;
+		Set<mir::LocalVar *> vars = get_described_vars(a);
+		for (mir::LocalVar *var : get_described_vars(b)) {
+			vars.insert(var);
+		}
+		for (mir::LocalVar *var : vars) {
+			Value a_value = get_var_value(a, var);
+			Value b_value = get_var_value(b, var);
+			if (a_value == b_value && !(a_value.atom == Opt<Atom>(Atom { var, {} }))) {
+				result.values.insert_or_assign(var, a_value);
+				continue;
+			}
+			// the variable becomes its own atom, but its offsets from other
+			// atoms on both sides survive as differences
+			add_value_differences(a_differences, var, a_value);
+			add_value_differences(b_differences, var, b_value);
+			Interval range = hull(get_range(a, a_value), get_range(b, b_value));
+			if (!(range == full_range)) {
+				result.ranges.insert_or_assign(Atom { var, {} }, range);
+			}
+		}
+		for (const auto &[atom, range] : a.ranges) {
+			if (!atom.dimension) continue;
+			if (auto it = b.ranges.find(atom); it != b.ranges.end()) {
+				result.ranges.insert_or_assign(atom, hull(range, it->second));
+			}
+		}
+		for (const auto &[var, condition] : a.conditions) {
+			if (auto it = b.conditions.find(var); it != b.conditions.end() && it->second == condition) {
+				result.conditions.insert_or_assign(var, condition);
+			}
+		}
+		for (const auto &[atoms, c] : a_differences) {
+			if (auto it = b_differences.find(atoms); it != b_differences.end()) {
+				result.differences.insert_or_assign(atoms, std::max(c, it->second));
+			}
+		}
+		for (const auto &[var, encoding] : a.encodings) {
+			if (auto it = b.encodings.find(var); it != b.encodings.end() && it->second == encoding) {
+				result.encodings.insert_or_assign(var, encoding);
+			}
+		}
+		return result;
+	}
+
+	// pushes every bound that grew since the old state to the end of its
+	// range, so that each bound can only grow once more
+	State widen_states(const State &old_state, const State &new_state) {
+		if (!old_state.reachable) return new_state;
+		State result = new_state;
+		for (auto &[atom, range] : result.ranges) {
+			Interval old_range = atom.dimension || atom.halved
+				? get_range(old_state, atom)
+				: get_range(old_state, get_var_value(old_state, atom.var));
+			if (range.lo < old_range.lo) range.lo = INT64_MIN;
+			if (range.hi > old_range.hi) range.hi = INT64_MAX;
+		}
+		for (auto it = result.differences.begin(); it != result.differences.end();) {
+			auto old_it = old_state.differences.find(it->first);
+			bool grew = old_it == old_state.differences.end() || it->second > old_it->second;
+			it = grew ? result.differences.erase(it) : std::next(it);
+		}
+		return result;
+	}
+
+	Vec<State> analyze(const mir::FunctionDef &function, const cfg::FlowGraph &graph) {
+		int num_blocks = graph.successors.size();
+		Vec<int> order = cfg::get_reverse_postorder(graph);
+		Vec<int> order_index(num_blocks, -1);
+		for (int i = 0; i < order.size(); ++i) {
+			order_index[order[i]] = i;
+		}
+		// every cycle goes through a block that an edge reaches from later in
+		// the order. Only these blocks accumulate and widen their entry state;
+		// every other block's is the join of its incoming edges.
+		Vec<bool> is_loop_header(num_blocks, false);
+		for (int block : order) {
+			for (int succ : graph.successors[block]) {
+				if (order_index[succ] <= order_index[block]) {
+					is_loop_header[succ] = true;
+				}
+			}
+		}
+
+		Vec<State> in_states(num_blocks, make_unreachable_state());
+		Map<Pair<int, int>, State> edge_states; // (pred, succ) -> the state along the edges between them
+		Vec<int> num_visits(num_blocks, 0);
+		in_states[0].reachable = true; // nothing is known about the parameters
+
+		Set<Pair<int, int>> worklist { { 0, 0 } }; // (position in reverse postorder, block)
+		while (!worklist.empty()) {
+			int block = worklist.begin()->second;
+			worklist.erase(worklist.begin());
+
+			Map<int, State> out_states;
+			for (auto &[succ, edge_state] : transfer_block(in_states[block], *function.basic_blocks[block])) {
+				int succ_index = graph.block_index_map.at(succ);
+				auto [it, is_new] = out_states.insert({ succ_index, edge_state });
+				if (!is_new) {
+					it->second = join_states(it->second, edge_state);
+				}
+			}
+			for (auto &[succ, out_state] : out_states) {
+				edge_states.insert_or_assign(Pair<int, int> { block, succ }, mv(out_state));
+				State new_state = make_unreachable_state();
+				new_state.reachable = succ == 0;
+				for (int pred : Set<int>(graph.predecessors[succ].begin(), graph.predecessors[succ].end())) {
+					if (auto it = edge_states.find(Pair<int, int> { pred, succ }); it != edge_states.end()) {
+						new_state = join_states(new_state, it->second);
+					}
+				}
+				if (is_loop_header[succ]) {
+					new_state = join_states(in_states[succ], new_state);
+					num_visits[succ] += 1;
+					if (num_visits[succ] > visits_before_widening) {
+						new_state = widen_states(in_states[succ], new_state);
+					}
+				}
+				if (!(new_state == in_states[succ])) {
+					in_states[succ] = mv(new_state);
+					worklist.insert({ order_index[succ], succ });
+				}
+			}
+		}
+		return in_states;
+	}
+
+	State get_state_before_terminator(const State &in_state, const mir::BasicBlock &block) {
+		State state = in_state;
+		for (const Uptr<mir::Instruction> &inst : block.instructions) {
+			transfer_instruction(state, *inst);
+		}
+		return state;
+	}
+
+	// whether the branch goes to a block that reports an out-of-range index
+	bool is_bounds_check(const mir::BasicBlock::Branch &branch) {
+		const mir::FunctionCall *report = cfg::get_error_report(*branch.then_block);
+		return report && report->arguments.size() > 1;
+	}
+
+	CheckCount eliminate_bounds_checks(mir::FunctionDef &function) {
+		CheckCount count { 0, 0 };
+		if (function.basic_blocks.empty()) return count;
+
+		cfg::FlowGraph graph = cfg::make_flow_graph(function);
+		Vec<State> in_states = analyze(function, graph);
+		for (int i = 0; i < function.basic_blocks.size(); ++i) {
+			mir::BasicBlock &block = *function.basic_blocks[i];
+			const mir::BasicBlock::Branch *branch = std::get_if<mir::BasicBlock::Branch>(&block.terminator);
+			if (!branch || !in_states[i].reachable) continue;
+			bool is_check = is_bounds_check(*branch);
+			count.total += is_check;
+
+			State state = get_state_before_terminator(in_states[i], block);
+			Opt<bool> taken = decide_branch(state, *branch->condition);
+			if (!taken) continue;
+			if (is_check && !*taken) {
+				count.removed += 1;
+			}
+			mir::BasicBlock *successor = *taken ? branch->then_block : branch->else_block;
+			block.terminator = mir::BasicBlock::Goto { successor };
+		}
+		cfg::remove_unreachable_blocks(function);
+		return count;
+	}
+
+	struct Loop {
+		int header;
+		Vec<int> body; // in the order of the function's block list
+	};
+
+	Vec<Loop> find_innermost_loops(const cfg::FlowGraph &graph) {
+		Vec<cfg::NaturalLoop> natural_loops = cfg::find_natural_loops(graph, cfg::find_immediate_dominators(graph));
+		Vec<Loop> loops;
+		for (const cfg::NaturalLoop &natural_loop : natural_loops) {
+			bool is_innermost = true;
+			for (const cfg::NaturalLoop &other : natural_loops) {
+				if (other.header != natural_loop.header && natural_loop.body.count(other.header)) {
+					is_innermost = false;
+				}
+			}
+			if (is_innermost) {
+				loops.push_back(Loop { natural_loop.header, Vec<int>(natural_loop.body.begin(), natural_loop.body.end()) });
+			}
+		}
+		return loops;
+	}
+
+	// `index op bound` with op < or <=, which holds whenever the loop's
+	// header goes around again. The bound doesn't change inside the loop.
+	struct LoopGuard {
+		mir::Operator op;
+		Value index;
+		Value bound;
+	};
+
+	Opt<LoopGuard> find_loop_guard(const State &header_state, const mir::BasicBlock &header, const Set<mir::BasicBlock *> &body, const Set<mir::LocalVar *> &vars_written) {
+		const mir::BasicBlock::Branch *branch = std::get_if<mir::BasicBlock::Branch>(&header.terminator);
+		if (!branch) return {};
+		const Condition *condition = get_condition(header_state, *branch->condition);
+		if (!condition || condition->form != BoolForm::plain) return {};
+		bool then_stays = body.count(branch->then_block), else_stays = body.count(branch->else_block);
+		if (then_stays == else_stays) return {};
+
+		LoopGuard guard { condition->op, condition->lhs, condition->rhs };
+		if (else_stays) {
+			// the loop goes around when the comparison fails
+			static const Map<mir::Operator, mir::Operator> negations {
+				{ mir::Operator::lt, mir::Operator::ge },
+				{ mir::Operator::le, mir::Operator::gt },
+				{ mir::Operator::ge, mir::Operator::lt },
+				{ mir::Operator::gt, mir::Operator::le }
+			};
+			auto it = negations.find(guard.op);
+			if (it == negations.end()) return {};
+			guard.op = it->second;
+		}
+		if (guard.op == mir::Operator::ge || guard.op == mir::Operator::gt) {
+			guard = LoopGuard { guard.op == mir::Operator::ge ? mir::Operator::le : mir::Operator::lt, guard.bound, guard.index };
+		}
+		if (guard.op != mir::Operator::lt && guard.op != mir::Operator::le) return {};
+		if (!guard.index.atom || !guard.bound.atom || guard.index.atom->dimension || guard.bound.atom->dimension) return {};
+		if (guard.index.decoded != guard.bound.decoded || guard.bound.offset > 0) return {};
+		if (!vars_written.count(guard.index.atom->var) || vars_written.count(guard.bound.atom->var)) return {};
+		return guard;
+	}
+
+	// the preconditions under which the analysis may be able to prove the
+	// loop's remaining bounds checks
+	struct LoopRequirements {
+		Set<Atom> lengths; // each at least the loop guard's bound; halved if the checks decode it
+		Opt<int64_t> index_lo; // a lower bound on the index when the loop starts
+		int64_t num_checks;
+	};
+
+	LoopRequirements get_loop_requirements(const mir::FunctionDef &function, const Vec<State> &in_states, const Loop &loop, const LoopGuard &guard, const Set<mir::LocalVar *> &vars_written) {
+		LoopRequirements requirements { {}, {}, 0 };
+		mir::LocalVar *index_var = guard.index.atom->var;
+		for (int i : loop.body) {
+			const mir::BasicBlock &block = *function.basic_blocks[i];
+			const mir::BasicBlock::Branch *branch = std::get_if<mir::BasicBlock::Branch>(&block.terminator);
+			if (!branch || !in_states[i].reachable || !is_bounds_check(*branch)) continue;
+			State state = get_state_before_terminator(in_states[i], block);
+			if (decide_branch(state, *branch->condition)) continue;
+			requirements.num_checks += 1;
+
+			const Condition *condition = get_condition(state, *branch->condition);
+			if (!condition || condition->form != BoolForm::plain) continue;
+			const Value &lhs = condition->lhs, &rhs = condition->rhs;
+			if (!lhs.atom || lhs.atom->var != index_var || lhs.decoded) continue;
+			if (condition->op == mir::Operator::ge && rhs.atom && rhs.atom->dimension && !vars_written.count(rhs.atom->var)) {
+				// the index against the length, which the guard compares
+				// with the bound in the same form
+				Atom length = *as_raw(rhs).atom;
+				if (length.halved != guard.bound.decoded) {
+					requirements.lengths.insert(length);
+				}
+			} else if (condition->op == mir::Operator::lt && !rhs.atom) {
+				// the index against the lowest index
+				if (Opt<int64_t> lo = checked_sub(rhs.offset, lhs.offset)) {
+					requirements.index_lo = std::max(requirements.index_lo.value_or(INT64_MIN), *lo);
+				}
+			}
+		}
+		return requirements;
+	}
+
+	int64_t count_undecided_checks(const mir::FunctionDef &function, const Vec<State> &in_states, const Vec<int> &blocks) {
+		int64_t count = 0;
+		for (int i : blocks) {
+			const mir::BasicBlock &block = *function.basic_blocks[i];
+			const mir::BasicBlock::Branch *branch = std::get_if<mir::BasicBlock::Branch>(&block.terminator);
+			if (!branch || !in_states[i].reachable || !is_bounds_check(*branch)) continue;
+			if (!decide_branch(get_state_before_terminator(in_states[i], block), *branch->condition)) {
+				count += 1;
+			}
+		}
+		return count;
+	}
+
+	int64_t get_code_size(const mir::FunctionDef &function, const Vec<int> &blocks) {
+		int64_t size = 0;
+		for (int i : blocks) {
+			size += function.basic_blocks[i]->instructions.size() + 1;
+		}
+		return size;
+	}
+
+	mir::LocalVar *make_temp(mir::FunctionDef &function) {
+		return function.add_local_var(false, "", mir::Type { mir::Type::ArrayType { 0 } });
+	}
+
+	// an anonymous block that computes `lhs op rhs` and branches on it
+	Uptr<mir::BasicBlock> make_guard_block(mir::FunctionDef &function, Uptr<mir::Operand> lhs, mir::Operator op, Uptr<mir::Operand> rhs, mir::BasicBlock *then_block, mir::BasicBlock *else_block) {
+		Uptr<mir::BasicBlock> block = function.make_basic_block(false, "");
+		mir::LocalVar *condition = make_temp(function);
+		block->instructions.push_back(mkuptr<mir::Instruction>(
+			mkuptr<mir::Place>(condition),
+			mkuptr<mir::BinaryOperation>(mv(lhs), mv(rhs), op)
+		));
+		block->terminator = mir::BasicBlock::Branch { mkuptr<mir::Place>(condition), then_block, else_block };
+		return block;
+	}
+
+	struct VersionedLoop {
+		mir::BasicBlock *first_guard;
+		mir::BasicBlock *copy_header;
+		Vec<mir::BasicBlock *> copy;
+	};
+
+	// Copies the loop and sends the loop's entries to guard blocks that
+	// check the requirements, going to the copy if all of them hold and to
+	// the original loop if not.
+	VersionedLoop version_loop(mir::FunctionDef &function, const Loop &loop, const LoopGuard &guard, const LoopRequirements &requirements) {
+		Vec<Uptr<mir::BasicBlock>> &blocks = function.basic_blocks;
+		mir::BasicBlock *header = blocks[loop.header].get();
+		Set<mir::BasicBlock *> body;
+		for (int i : loop.body) {
+			body.insert(blocks[i].get());
+		}
+
+		// the copy shares the original's variables
+		Map<mir::BasicBlock *, mir::BasicBlock *> copies;
+		Vec<Uptr<mir::BasicBlock>> copy_blocks;
+		for (int i : loop.body) {
+			const mir::BasicBlock &original = *blocks[i];
+			Uptr<mir::BasicBlock> copy = function.make_basic_block(original.user_labeled, original.user_labeled ? original.label_name : "");
+			for (const Uptr<mir::Instruction> &inst : original.instructions) {
+				copy->instructions.push_back(inst->clone());
+			}
+			copy->terminator = original.clone_terminator();
+			copies.insert({ blocks[i].get(), copy.get() });
+			copy_blocks.push_back(mv(copy));
+		}
+		for (Uptr<mir::BasicBlock> &copy : copy_blocks) {
+			for (mir::BasicBlock *succ : cfg::get_successors(*copy)) {
+				if (auto it = copies.find(succ); it != copies.end()) {
+					cfg::redirect_edge(*copy, succ, it->second);
+				}
+			}
+		}
+
+		// built from the last check to the first
+		Vec<Uptr<mir::BasicBlock>> guard_blocks;
+		mir::BasicBlock *next = copies.at(header);
+		mir::LocalVar *bound_var = guard.bound.atom->var;
+		for (auto it = requirements.lengths.rbegin(); it != requirements.lengths.rend(); ++it) {
+			mir::LocalVar *array = it->var;
+			Opt<Uptr<mir::Operand>> dimension;
+			if (!std::holds_alternative<mir::Type::TupleType>(array->type.type)) {
+				dimension = mkuptr<mir::Int64Constant>(*it->dimension);
+			}
+			mir::LocalVar *length = make_temp(function);
+			// index op bound <= length, so index op length
+			guard_blocks.push_back(make_guard_block(
+				function,
+				mkuptr<mir::Place>(bound_var),
+				guard.op == mir::Operator::lt ? mir::Operator::le : mir::Operator::lt,
+				mkuptr<mir::Place>(length),
+				next,
+				header
+			));
+			Vec<Uptr<mir::Instruction>> &guard_insts = guard_blocks.back()->instructions;
+			guard_insts.insert(
+				guard_insts.begin(),
+				mkuptr<mir::Instruction>(mkuptr<mir::Place>(length), mkuptr<mir::LengthGetter>(mkuptr<mir::Place>(array), mv(dimension)))
+			);
+			if (it->halved) {
+				guard_insts.insert(
+					guard_insts.begin() + 1,
+					mkuptr<mir::Instruction>(
+						mkuptr<mir::Place>(length),
+						mkuptr<mir::BinaryOperation>(mkuptr<mir::Place>(length), mkuptr<mir::Int64Constant>(1), mir::Operator::rshift)
+					)
+				);
+			}
+			next = guard_blocks.back().get();
+			// the original loop reports an unallocated array
+			guard_blocks.push_back(make_guard_block(
+				function,
+				mkuptr<mir::Place>(array),
+				mir::Operator::eq,
+				mkuptr<mir::Int64Constant>(0),
+				header,
+				next
+			));
+			next = guard_blocks.back().get();
+		}
+		if (requirements.index_lo) {
+			guard_blocks.push_back(make_guard_block(
+				function,
+				mkuptr<mir::Int64Constant>(*requirements.index_lo),
+				mir::Operator::le,
+				mkuptr<mir::Place>(guard.index.atom->var),
+				next,
+				header
+			));
+			next = guard_blocks.back().get();
+		}
+		std::reverse(guard_blocks.begin(), guard_blocks.end());
+
+		for (Uptr<mir::BasicBlock> &block : blocks) {
+			if (!body.count(block.get())) {
+				cfg::redirect_edge(*block, header, next);
+			}
+		}
+
+		VersionedLoop result { next, copies.at(header), {} };
+		for (Uptr<mir::BasicBlock> &block : copy_blocks) {
+			result.copy.push_back(block.get());
+		}
+		blocks.insert(blocks.begin() + loop.header, std::make_move_iterator(guard_blocks.begin()), std::make_move_iterator(guard_blocks.end()));
+		int after_loop = 0;
+		for (int i = 0; i < blocks.size(); ++i) {
+			if (body.count(blocks[i].get())) {
+				after_loop = i + 1;
+			}
+		}
+		blocks.insert(blocks.begin() + after_loop, std::make_move_iterator(copy_blocks.begin()), std::make_move_iterator(copy_blocks.end()));
+		return result;
+	}
+
+	void version_loops(mir::FunctionDef &function) {
+		if (function.basic_blocks.empty()) return;
+		Set<mir::BasicBlock *> visited_headers;
+		bool changed = true;
+		while (changed) {
+			changed = false;
+			cfg::FlowGraph graph = cfg::make_flow_graph(function);
+			Vec<State> in_states = analyze(function, graph);
+			for (const Loop &loop : find_innermost_loops(graph)) {
+				mir::BasicBlock *header = function.basic_blocks[loop.header].get();
+				// the guards need a place in front of the header
+				if (loop.header == 0) continue;
+				if (visited_headers.count(header) || get_code_size(function, loop.body) > max_versioned_loop_size) continue;
+				visited_headers.insert(header);
+
+				Set<mir::BasicBlock *> body;
+				Set<mir::LocalVar *> vars_written;
+				for (int i : loop.body) {
+					body.insert(function.basic_blocks[i].get());
+					for (const Uptr<mir::Instruction> &inst : function.basic_blocks[i]->instructions) {
+						if (inst->destination && (*inst->destination)->indices.empty()) {
+							vars_written.insert((*inst->destination)->target);
+						}
+					}
+				}
+				State header_state = get_state_before_terminator(in_states[loop.header], *header);
+				Opt<LoopGuard> guard = find_loop_guard(header_state, *header, body, vars_written);
+				if (!guard) continue;
+				LoopRequirements requirements = get_loop_requirements(function, in_states, loop, *guard, vars_written);
+				if (requirements.lengths.empty() && !requirements.index_lo) continue;
+
+				int num_local_vars = function.local_vars.size();
+				int64_t num_local_vars_made = function.num_local_vars_made;
+				int64_t num_basic_blocks_made = function.num_basic_blocks_made;
+				VersionedLoop versioned = version_loop(function, loop, *guard, requirements);
+				cfg::FlowGraph new_graph = cfg::make_flow_graph(function);
+				Vec<int> copy;
+				for (mir::BasicBlock *block : versioned.copy) {
+					copy.push_back(new_graph.block_index_map.at(block));
+				}
+				if (count_undecided_checks(function, analyze(function, new_graph), copy) < requirements.num_checks) {
+					visited_headers.insert(versioned.copy_header);
+				} else {
+					// the guards don't help, so the loop's entries go back to it
+					for (Uptr<mir::BasicBlock> &block : function.basic_blocks) {
+						cfg::redirect_edge(*block, versioned.first_guard, header);
+					}
+					cfg::remove_unreachable_blocks(function);
+					function.local_vars.resize(num_local_vars);
+					function.num_local_vars_made = num_local_vars_made;
+					function.num_basic_blocks_made = num_basic_blocks_made;
+				}
+				changed = true;
+				break; // the blocks have changed
+			}
+		}
+	}
+
+	void eliminate_bounds_checks(mir::Program &program, bool verbose) {
+		CheckCount count { 0, 0 };
+		for (Uptr<mir::FunctionDef> &function : program.function_defs) {
+			version_loops(*function);
+			CheckCount function_count = eliminate_bounds_checks(*function);
+			count.removed += function_count.removed;
+			count.total += function_count.total;
+		}
+		if (verbose) {
+			std::cerr << "range analysis removed " << count.removed << " of " << count.total << " bounds checks\n";
+		}
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include "std_alias.h"
+#include "mir.h"
+
+// Bounds-check elimination driven by a value-range analysis.
+//
+// The lowering guards every array access with two comparisons of the
+// index: against the lowest index and against the length of the dimension
+// (see hir_to_mir.cpp). Both are encoded, or both are plain when int64s are
+// unboxed. Each comparison feeds a branch to a block
+// that reports the error. A forward dataflow analysis over the MIR proves
+// some of these comparisons. Branches it decides become jumps, and the
+// error blocks that can no longer be reached are deleted.
+//
+// At each point the analysis knows
+// - an interval for each variable and each array dimension's length,
+// - upper bounds on the difference of two of them (`i - length a 0 <= -3`),
+//   which come from the comparisons that branches test (loop guards) and
+//   from the lengths given to `new Array`,
+// - which variables are copies, offsets or decodings of other values, so
+//   facts about the user's variables carry over to the compiler's
+//   temporaries and back.
+// Induction variables are widened to an open interval after a few trips
+// around their loop, and the loop guard bounds them again on the way into
+// the body.
+//
+// An innermost loop whose guard is `i < n` but whose checks on `a[i]` can't
+// be proven is versioned: guards in front of the loop test `a != 0`,
+// `n <= length a d` and the lowest index once, and lead to a copy of the
+// loop where the analysis can then remove the checks. When a guard fails,
+// the original loop runs with all of its checks, so the errors it reports
+// are unchanged.
+namespace La::range_analysis {
+	using namespace std_alias;
+
+	struct CheckCount {
+		int64_t removed;
+		int64_t total;
+	};
+
+	CheckCount eliminate_bounds_checks(mir::FunctionDef &function);
+
+	void eliminate_bounds_checks(mir::Program &program, bool verbose);
+}
@@ -0,0 +1,269 @@
+#include "scalar_replacement.h"
+#include "cfg.h"
+#include <iostream>
+#include <algorithm>
+
+namespace La::scalar_replacement {
+	using namespace std_alias;
+
+	// the most fields a tuple can have to be replaced
+	const int64_t MAX_FIELDS = 16;
+
+	mir::LocalVar *get_var(const mir::Operand &operand) {
+		const mir::Place *place = dynamic_cast<const mir::Place *>(&operand);
+		return place && place->indices.empty() ? place->target : nullptr;
+	}
+
+	bool is_zero(const mir::Operand &operand) {
+		const mir::Int64Constant *constant = dynamic_cast<const mir::Int64Constant *>(&operand);
+		return constant && constant->value == 0;
+	}
+
+	bool have_same_type(const mir::Type &a, const mir::Type &b) {
+		if (a.type.index() != b.type.index()) return false;
+		const mir::Type::ArrayType *a_array = std::get_if<mir::Type::ArrayType>(&a.type);
+		const mir::Type::ArrayType *b_array = std::get_if<mir::Type::ArrayType>(&b.type);
+		return !a_array || a_array->num_dimensions == b_array->num_dimensions;
+	}
+
+	// the type of the value that the operand stores into a field, if we can
+	// tell
+	Opt<mir::Type> get_stored_type(const mir::Operand &operand) {
+		if (mir::LocalVar *var = get_var(operand)) {
+			return var->type;
+		} else if (dynamic_cast<const mir::Int64Constant *>(&operand)) {
+			return mir::Type { mir::Type::ArrayType { 0 } };
+		} else if (dynamic_cast<const mir::CodeConstant *>(&operand) || dynamic_cast<const mir::ExtCodeConstant *>(&operand)) {
+			return mir::Type { mir::Type::CodeType {} };
+		}
+		return {};
+	}
+
+	// where an instruction is: (block index, index in the block)
+	using Position = Pair<int, int>;
+
+	// how one instruction uses a candidate tuple
+	enum struct UseKind {
+		store, // TUPLE[k] <- VALUE
+		load, // VAR <- TUPLE[k]
+		length, // VAR <- length TUPLE
+		null_test // VAR <- TUPLE = 0
+	};
+	struct Use {
+		mir::Instruction *inst;
+		UseKind kind;
+		int64_t field; // for loads and stores
+	};
+
+	struct Candidate {
+		Position definition;
+		int64_t num_fields;
+		Vec<Use> uses;
+		Vec<Opt<mir::Type>> field_types;
+		bool qualifies = true;
+	};
+
+	// the field that a tuple access's indices name, if it is a constant
+	// inside the tuple
+	Opt<int64_t> get_field(const Vec<Uptr<mir::Operand>> &indices, int64_t num_fields) {
+		if (indices.size() != 1) return {};
+		const mir::Int64Constant *constant = dynamic_cast<const mir::Int64Constant *>(indices[0].get());
+		if (!constant || constant->value < 0 || constant->value >= num_fields) return {};
+		return constant->value;
+	}
+
+	// how the instruction uses the tuple, if it is one of the uses we can
+	// replace
+	Opt<Use> classify_use(mir::Instruction &inst, mir::LocalVar *tuple, int64_t num_fields) {
+		const mir::Rvalue *rvalue = inst.rvalue.get();
+		if (inst.destination && (*inst.destination)->target == tuple) {
+			const mir::Operand *value = dynamic_cast<const mir::Operand *>(rvalue);
+			Opt<int64_t> field = get_field((*inst.destination)->indices, num_fields);
+			Vec<mir::LocalVar *> vars_read;
+			if (value) {
+				value->collect_vars_read(vars_read);
+			}
+			if (!value || !field || std::find(vars_read.begin(), vars_read.end(), tuple) != vars_read.end()) return {};
+			return Use { &inst, UseKind::store, *field };
+		}
+		if (!inst.destination || !(*inst.destination)->indices.empty()) return {};
+		if (const mir::Place *place = dynamic_cast<const mir::Place *>(rvalue); place && place->target == tuple) {
+			Opt<int64_t> field = get_field(place->indices, num_fields);
+			if (!field) return {};
+			return Use { &inst, UseKind::load, *field };
+		} else if (const mir::LengthGetter *length = dynamic_cast<const mir::LengthGetter *>(rvalue)) {
+			if (get_var(*length->target) != tuple || length->dimension) return {};
+			return Use { &inst, UseKind::length, 0 };
+		} else if (const mir::BinaryOperation *bin_op = dynamic_cast<const mir::BinaryOperation *>(rvalue)) {
+			bool is_null_test = bin_op->op == mir::Operator::eq
+				&& ((get_var(*bin_op->lhs) == tuple && is_zero(*bin_op->rhs))
+					|| (is_zero(*bin_op->lhs) && get_var(*bin_op->rhs) == tuple));
+			if (!is_null_test) return {};
+			return Use { &inst, UseKind::null_test, 0 };
+		}
+		return {};
+	}
+
+	// the variables assigned a new tuple of constant length in exactly one
+	// place and nowhere else
+	Map<mir::LocalVar *, Candidate> find_candidates(const mir::FunctionDef &function) {
+		Map<mir::LocalVar *, Vec<Position>> definitions;
+		for (int i = 0; i < function.basic_blocks.size(); ++i) {
+			const mir::BasicBlock &block = *function.basic_blocks[i];
+			for (int j = 0; j < block.instructions.size(); ++j) {
+				if (Opt<mir::LocalVar *> var = block.instructions[j]->get_var_written()) {
+					definitions[*var].push_back({ i, j });
+				}
+			}
+		}
+		Set<mir::LocalVar *> parameters(function.parameter_vars.begin(), function.parameter_vars.end());
+
+		Map<mir::LocalVar *, Candidate> candidates;
+		for (auto &[var, positions] : definitions) {
+			if (positions.size() != 1 || parameters.count(var)) continue;
+			auto [i, j] = positions[0];
+			const mir::NewTuple *new_tuple = dynamic_cast<const mir::NewTuple *>(
+				function.basic_blocks[i]->instructions[j]->rvalue.get()
+			);
+			if (!new_tuple) continue;
+			const mir::Int64Constant *length = dynamic_cast<const mir::Int64Constant *>(new_tuple->length.get());
+			if (!length || length->value % 2 == 0) continue;
+			int64_t num_fields = length->value >> 1;
+			if (num_fields < 0 || num_fields > MAX_FIELDS) continue;
+			Candidate candidate { positions[0], num_fields };
+			candidate.field_types.resize(num_fields);
+			candidates.insert({ var, mv(candidate) });
+		}
+		return candidates;
+	}
+
+	int64_t replace_tuples(mir::FunctionDef &function) {
+		cfg::remove_unreachable_blocks(function);
+		Map<mir::LocalVar *, Candidate> candidates = find_candidates(function);
+		if (candidates.empty()) return 0;
+
+		// find every use of each candidate, and rule out the ones that are
+		// used in other ways or where the new tuple might not reach
+		cfg::FlowGraph graph = cfg::make_flow_graph(function);
+		Vec<int> idoms = cfg::find_immediate_dominators(graph);
+		auto is_reached = [&](const Candidate &candidate, Position use) {
+			auto [def_block, def_index] = candidate.definition;
+			if (use.first == def_block) return use.second > def_index;
+			return cfg::dominates(idoms, def_block, use.first);
+		};
+		for (int i = 0; i < function.basic_blocks.size(); ++i) {
+			mir::BasicBlock &block = *function.basic_blocks[i];
+			for (int j = 0; j < block.instructions.size(); ++j) {
+				mir::Instruction &inst = *block.instructions[j];
+				Vec<mir::LocalVar *> vars;
+				inst.collect_vars_read(vars);
+				if (inst.destination) {
+					vars.push_back((*inst.destination)->target);
+				}
+				for (mir::LocalVar *var : Set<mir::LocalVar *>(vars.begin(), vars.end())) {
+					auto it = candidates.find(var);
+					if (it == candidates.end()) continue;
+					Candidate &candidate = it->second;
+					if (candidate.definition == Position { i, j }) continue;
+
+					Opt<Use> use = classify_use(inst, var, candidate.num_fields);
+					if (!use || !is_reached(candidate, { i, j })) {
+						candidate.qualifies = false;
+						continue;
+					}
+					Opt<mir::Type> type;
+					if (use->kind == UseKind::store) {
+						type = get_stored_type(*dynamic_cast<const mir::Operand *>(inst.rvalue.get()));
+						if (!type) {
+							candidate.qualifies = false;
+						}
+					} else if (use->kind == UseKind::load) {
+						type = (*inst.destination)->target->type;
+					}
+					if (type) {
+						Opt<mir::Type> &field_type = candidate.field_types[use->field];
+						if (field_type && !have_same_type(*field_type, *type)) {
+							candidate.qualifies = false;
+						}
+						field_type = type;
+					}
+					candidate.uses.push_back(*use);
+				}
+			}
+			Vec<mir::LocalVar *> vars;
+			block.collect_vars_read(vars);
+			for (mir::LocalVar *var : vars) {
+				if (auto it = candidates.find(var); it != candidates.end()) {
+					it->second.qualifies = false;
+				}
+			}
+		}
+
+		// give each field that is used a variable, start them at encoded 0
+		// where the tuple was made, and point the uses at them
+		int64_t num_replaced = 0;
+		Map<mir::Instruction *, Vec<Uptr<mir::Instruction>>> initializations;
+		for (auto &[tuple, candidate] : candidates) {
+			if (!candidate.qualifies) continue;
+			num_replaced += 1;
+
+			Vec<mir::LocalVar *> field_vars(candidate.num_fields, nullptr);
+			Vec<Uptr<mir::Instruction>> field_inits;
+			for (int64_t k = 0; k < candidate.num_fields; ++k) {
+				if (!candidate.field_types[k]) continue;
+				mir::LocalVar *field_var = function.add_local_var(false, "", *candidate.field_types[k]);
+				field_var->is_encoded = std::holds_alternative<mir::Type::ArrayType>(field_var->type.type)
+					&& std::get<mir::Type::ArrayType>(field_var->type.type).num_dimensions == 0;
+				field_vars[k] = field_var;
+				field_inits.push_back(mkuptr<mir::Instruction>(
+					mkuptr<mir::Place>(field_vars[k]),
+					mkuptr<mir::Int64Constant>(1)
+				));
+			}
+			auto [def_block, def_index] = candidate.definition;
+			initializations.insert({ function.basic_blocks[def_block]->instructions[def_index].get(), mv(field_inits) });
+
+			for (const Use &use : candidate.uses) {
+				switch (use.kind) {
+					case UseKind::store:
+						use.inst->destination = mkuptr<mir::Place>(field_vars[use.field]);
+						break;
+					case UseKind::load:
+						use.inst->rvalue = mkuptr<mir::Place>(field_vars[use.field]);
+						break;
+					case UseKind::length:
+						use.inst->rvalue = mkuptr<mir::Int64Constant>((candidate.num_fields << 1) + 1);
+						break;
+					case UseKind::null_test:
+						use.inst->rvalue = mkuptr<mir::Int64Constant>(0);
+						break;
+				}
+			}
+		}
+		for (Uptr<mir::BasicBlock> &block : function.basic_blocks) {
+			Vec<Uptr<mir::Instruction>> new_insts;
+			for (Uptr<mir::Instruction> &inst : block->instructions) {
+				auto it = initializations.find(inst.get());
+				if (it == initializations.end()) {
+					new_insts.push_back(mv(inst));
+					continue;
+				}
+				for (Uptr<mir::Instruction> &init : it->second) {
+					new_insts.push_back(mv(init));
+				}
+			}
+			block->instructions = mv(new_insts);
+		}
+		return num_replaced;
+	}
+
+	void replace_tuples(mir::Program &program, bool verbose) {
+		int64_t num_replaced = 0;
+		for (Uptr<mir::FunctionDef> &function : program.function_defs) {
+			num_replaced += replace_tuples(*function);
+		}
+		if (verbose) {
+			std::cerr << "scalar replacement replaced " << num_replaced << " tuples\n";
+		}
+	}
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include "std_alias.h"
+#include "mir.h"
+
+// Replaces the small tuples that never leave their function with one local
+// variable per field, so that their fields don't go through memory.
+//
+// A tuple qualifies when its variable is assigned only once, by a
+// `new Tuple(...)` with a constant length that reaches every other use of
+// the variable, and each of those uses either reads or writes a field at a
+// constant index within the tuple, gets the tuple's length, or compares the
+// tuple to 0. The length and the comparisons become constants, so the
+// checks on the tuple fold away once constants are propagated again.
+namespace La::scalar_replacement {
+	using namespace std_alias;
+
+	// returns the number of tuples replaced
+	int64_t replace_tuples(mir::FunctionDef &function);
+
+	void replace_tuples(mir::Program &program, bool verbose);
+}
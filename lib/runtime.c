@@ -0,0 +1,415 @@
+/*
+ * Runtime library linked into every compiled program.
+ *
+ * Values follow the pipeline's tagged representation: an integer v is
+ * encoded as (v << 1) + 1, and anything with a low bit of 0 is a pointer to
+ * a heap object. A heap object is one header word holding its (decoded)
+ * number of elements, followed by that many 8-byte elements.
+ *
+ * The generated code enters through `go`, and calls into this file through
+ * print, input, allocate, tuple_error, and the tensor_error_* family (L1 picks
+ * the tensor_error variant based on the number of arguments).
+ *
+ * Performance notes:
+ *  - allocate bumps a pointer through large arena chunks and never frees;
+ *    the programs we compile are short-lived, so the OS reclaims everything
+ *    at exit. Generated code usually does the bump itself (see heap_state).
+ *  - print formats into one large output buffer that is only written out when
+ *    it fills up and at exit.
+ *  - input parses numbers straight out of a large read buffer.
+ *
+ * Programs compiled with IRc -finstrument also count how often each function
+ * and basic block runs; see the profiling section below.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+extern void go(void);
+
+/*
+ * Buffered output.
+ */
+
+#define OUTPUT_BUFFER_SIZE (1 << 20)
+#define PRINT_MAX_DEPTH 4
+
+static char output_buffer[OUTPUT_BUFFER_SIZE];
+static size_t output_length = 0;
+
+static void flush_output(void) {
+	size_t written = 0;
+	while (written < output_length) {
+		ssize_t result = write(STDOUT_FILENO, output_buffer + written, output_length - written);
+		if (result <= 0) {
+			break;
+		}
+		written += (size_t) result;
+	}
+	output_length = 0;
+}
+
+// makes sure there are at least `size` free bytes in the output buffer
+static inline void reserve_output(size_t size) {
+	if (output_length + size > OUTPUT_BUFFER_SIZE) {
+		flush_output();
+	}
+}
+
+static inline void output_char(char c) {
+	reserve_output(1);
+	output_buffer[output_length++] = c;
+}
+
+static void output_string(const char *s) {
+	size_t length = strlen(s);
+	reserve_output(length);
+	memcpy(output_buffer + output_length, s, length);
+	output_length += length;
+}
+
+static void output_int(int64_t value) {
+	char digits[24];
+	int num_digits = 0;
+
+	// work with the magnitude as unsigned so INT64_MIN doesn't overflow
+	uint64_t magnitude = value < 0 ? (uint64_t) 0 - (uint64_t) value : (uint64_t) value;
+	do {
+		digits[num_digits++] = (char) ('0' + magnitude % 10);
+		magnitude /= 10;
+	} while (magnitude > 0);
+
+	reserve_output(num_digits + 1);
+	if (value < 0) {
+		output_buffer[output_length++] = '-';
+	}
+	while (num_digits > 0) {
+		output_buffer[output_length++] = digits[--num_digits];
+	}
+}
+
+static void print_content(int64_t value, int depth) {
+	if (depth >= PRINT_MAX_DEPTH) {
+		output_string("...");
+		return;
+	}
+	if (value & 1) {
+		output_int(value >> 1);
+		return;
+	}
+	if (value == 0) {
+		// a null array or tuple
+		output_int(0);
+		return;
+	}
+
+	const int64_t *object = (const int64_t *) value;
+	int64_t length = object[0];
+	output_string("{s:");
+	output_int(length);
+	for (int64_t i = 1; i <= length; ++i) {
+		output_string(", ");
+		print_content(object[i], depth + 1);
+	}
+	output_char('}');
+}
+
+void print(int64_t value) {
+	print_content(value, 0);
+	output_char('\n');
+}
+
+// reports a fatal runtime error and exits; the output printed so far is
+// flushed first so it stays in order with the error message
+static void fatal_error(void) {
+	output_char('\n');
+	flush_output();
+	exit(-1);
+}
+
+/*
+ * Buffered input.
+ */
+
+#define INPUT_BUFFER_SIZE (1 << 16)
+
+static char input_buffer[INPUT_BUFFER_SIZE];
+static size_t input_position = 0;
+static size_t input_length = 0;
+
+// returns the next input byte without consuming it, or -1 at end of input
+static inline int peek_input(void) {
+	if (input_position == input_length) {
+		ssize_t result = read(STDIN_FILENO, input_buffer, INPUT_BUFFER_SIZE);
+		if (result <= 0) {
+			return -1;
+		}
+		input_position = 0;
+		input_length = (size_t) result;
+	}
+	return (unsigned char) input_buffer[input_position];
+}
+
+int64_t input(void) {
+	int c = peek_input();
+	while (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+		input_position++;
+		c = peek_input();
+	}
+
+	int is_negative = 0;
+	if (c == '-' || c == '+') {
+		is_negative = c == '-';
+		input_position++;
+		c = peek_input();
+	}
+
+	// end of input and malformed input both read as 0
+	uint64_t magnitude = 0;
+	while (c >= '0' && c <= '9') {
+		magnitude = magnitude * 10 + (uint64_t) (c - '0');
+		input_position++;
+		c = peek_input();
+	}
+
+	int64_t value = is_negative ? (int64_t) ((uint64_t) 0 - magnitude) : (int64_t) magnitude;
+	return (int64_t) (((uint64_t) value << 1) + 1);
+}
+
+/*
+ * Arena allocation.
+ */
+
+#define ARENA_CHUNK_SIZE ((size_t) 64 << 20)
+
+// The IR compiler inlines the common case of allocate: it bumps
+// heap_state->pointer itself and only calls allocate when the object
+// doesn't fit below heap_state->limit. The state therefore lives at a fixed
+// address that has to match HEAP_STATE_ADDRESS in ir_compiler/src/program.cpp.
+#define HEAP_STATE_ADDRESS 0x200000
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0x100000
+#endif
+
+// Objects that the compiler proves don't outlive a call live in the
+// caller's frame on a separate stack: a function claims its frame by bumping
+// frame_pointer on entry (if it stays below frame_limit) and gives it back
+// by restoring it before it returns. See generate_frame_entry in
+// ir_compiler/src/program.cpp.
+#define FRAME_STACK_SIZE ((size_t) 8 << 20)
+
+struct heap_state {
+	int64_t *pointer;
+	int64_t *limit;
+	int64_t *frame_pointer;
+	int64_t *frame_limit;
+};
+
+static struct heap_state *heap_state = NULL;
+
+static void *map_memory(size_t size) {
+	void *memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (memory == MAP_FAILED) {
+		output_string("allocate: out of memory");
+		fatal_error();
+	}
+	return memory;
+}
+
+// maps the heap state page and the frame stack; the heap starts out empty so
+// the first inline allocation falls back to allocate, which maps the first
+// chunk
+static void initialize_heap_state(void) {
+	void *memory = mmap((void *) HEAP_STATE_ADDRESS, (size_t) getpagesize(), PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+	if (memory != (void *) HEAP_STATE_ADDRESS) {
+		output_string("couldn't map the heap state");
+		fatal_error();
+	}
+	heap_state = (struct heap_state *) memory;
+	heap_state->pointer = NULL;
+	heap_state->limit = NULL;
+	heap_state->frame_pointer = (int64_t *) map_memory(FRAME_STACK_SIZE);
+	heap_state->frame_limit = heap_state->frame_pointer + FRAME_STACK_SIZE / sizeof(int64_t);
+}
+
+// returns uninitialized space for `num_words` words
+static int64_t *arena_allocate(size_t num_words) {
+	if ((size_t) (heap_state->limit - heap_state->pointer) < num_words) {
+		size_t size = num_words * sizeof(int64_t);
+		if (size > ARENA_CHUNK_SIZE / 4) {
+			// big objects get their own mapping so they don't waste the
+			// rest of the current chunk
+			return (int64_t *) map_memory(size);
+		}
+		heap_state->pointer = (int64_t *) map_memory(ARENA_CHUNK_SIZE);
+		heap_state->limit = heap_state->pointer + ARENA_CHUNK_SIZE / sizeof(int64_t);
+	}
+	int64_t *result = heap_state->pointer;
+	heap_state->pointer += num_words;
+	return result;
+}
+
+// fills `count` words starting at `destination` with `value`
+static void fill_words(int64_t *destination, int64_t value, size_t count) {
+	size_t i = 0;
+#if defined(__AVX2__)
+	__m256i vector = _mm256_set1_epi64x(value);
+	for (; i + 4 <= count; i += 4) {
+		_mm256_storeu_si256((__m256i *) (destination + i), vector);
+	}
+#elif defined(__SSE2__)
+	__m128i vector = _mm_set1_epi64x(value);
+	for (; i + 2 <= count; i += 2) {
+		_mm_storeu_si128((__m128i *) (destination + i), vector);
+	}
+#endif
+	for (; i < count; ++i) {
+		destination[i] = value;
+	}
+}
+
+int64_t *allocate(int64_t encoded_length, int64_t initial_value) {
+	int64_t length = encoded_length >> 1;
+	if (length < 0) {
+		output_string("attempted to allocate a negative number of elements: ");
+		output_int(length);
+		fatal_error();
+	}
+
+	// past this, the object's size in bytes doesn't fit in a size_t, and no
+	// address space could hold it anyway
+	if ((uint64_t) length > SIZE_MAX / sizeof(int64_t) - 1) {
+		output_string("allocate: out of memory");
+		fatal_error();
+	}
+
+	int64_t *object = arena_allocate((size_t) length + 1);
+	object[0] = length;
+	fill_words(object + 1, initial_value, (size_t) length);
+	return object;
+}
+
+/*
+ * Errors. Every argument is an encoded integer.
+ */
+
+void tuple_error(int64_t line_number, int64_t length, int64_t index) {
+	output_string("attempted to use position ");
+	output_int(index >> 1);
+	output_string(" of a tuple that only has ");
+	output_int(length >> 1);
+	output_string(" positions (line ");
+	output_int(line_number >> 1);
+	output_char(')');
+	fatal_error();
+}
+
+void tensor_error_null(int64_t line_number) {
+	output_string("attempted to use a non-allocated tensor (line ");
+	output_int(line_number >> 1);
+	output_char(')');
+	fatal_error();
+}
+
+void tensor_error_one_dim(int64_t line_number, int64_t length, int64_t index) {
+	output_string("attempted to use position ");
+	output_int(index >> 1);
+	output_string(" of an array that only has ");
+	output_int(length >> 1);
+	output_string(" positions (line ");
+	output_int(line_number >> 1);
+	output_char(')');
+	fatal_error();
+}
+
+void tensor_error_multi_dim(int64_t line_number, int64_t dimension, int64_t length, int64_t index) {
+	output_string("attempted to use position ");
+	output_int(index >> 1);
+	output_string(" of dimension ");
+	output_int(dimension >> 1);
+	output_string(" of an array that only has ");
+	output_int(length >> 1);
+	output_string(" positions in that dimension (line ");
+	output_int(line_number >> 1);
+	output_char(')');
+	fatal_error();
+}
+
+/*
+ * Profiling.
+ */
+
+// Instrumented code stores the number of counters at COUNTER_TABLE_ADDRESS
+// when main starts, and bumps counter i at COUNTER_TABLE_ADDRESS + 8 * (i + 1).
+// At exit, line i of COUNTER_NAMES_FILE (written by IRc) is copied to
+// PROFILE_FILE followed by a space and counter i. These must match
+// ir_compiler/src/profile.h.
+#define COUNTER_TABLE_ADDRESS 0x300000
+#define MAX_COUNTERS (1 << 17)
+#define COUNTER_NAMES_FILE "prog.counters"
+#define PROFILE_FILE "prog.profile"
+
+static int64_t *counter_table = NULL;
+
+static void initialize_counter_table(void) {
+	// pages that are never touched cost nothing, and an uninstrumented
+	// program only reads the first word, so it doesn't pay for this
+	void *memory = mmap((void *) COUNTER_TABLE_ADDRESS, MAX_COUNTERS * sizeof(int64_t), PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED_NOREPLACE, -1, 0);
+	if (memory != (void *) COUNTER_TABLE_ADDRESS) {
+		output_string("couldn't map the profile counters");
+		fatal_error();
+	}
+	counter_table = (int64_t *) memory;
+}
+
+static void dump_profile(void) {
+	int64_t num_counters = counter_table[0];
+	if (num_counters <= 0 || num_counters >= MAX_COUNTERS) {
+		// not an instrumented program
+		return;
+	}
+	int64_t *counters = counter_table + 1;
+
+	FILE *names = fopen(COUNTER_NAMES_FILE, "r");
+	FILE *profile = fopen(PROFILE_FILE, "w");
+	if (!profile) {
+		if (names) {
+			fclose(names);
+		}
+		return;
+	}
+	// every counter is written, including the ones that stayed 0
+	char name[4096];
+	for (int64_t i = 0; i < num_counters; ++i) {
+		if (names && fgets(name, sizeof(name), names)) {
+			name[strcspn(name, "\n")] = '\0';
+			fprintf(profile, "%s %ld\n", name, (long) counters[i]);
+		} else {
+			// the names file is missing or stale; fall back to the index
+			fprintf(profile, "%ld %ld\n", (long) i, (long) counters[i]);
+		}
+	}
+	if (names) {
+		fclose(names);
+	}
+	fclose(profile);
+}
+
+int main(void) {
+	atexit(flush_output);
+	initialize_heap_state();
+	initialize_counter_table();
+	atexit(dump_profile);
+	go();
+	return 0;
+}